@@ -45,6 +45,7 @@
 #include <arpa/inet.h>
 #endif
 
+#include <ctype.h>
 #include <dirent.h>
 #include <errno.h>
 #include <fcntl.h>
@@ -80,6 +81,155 @@ static int quit_command = 0;
 
 GSList *commands = NULL;
 
+/*
+ * case-insensitive trie of command names, rebuilt from commands list
+ * on first lookup after command_add()/command_remove()
+ */
+typedef struct command_trie {
+	struct command_trie *next;	/* sibling, sorted by ch */
+	struct command_trie *children;
+	command_t *command;		/* command named exactly like path to this node */
+	unsigned int count;		/* number of commands with names starting with this path */
+	unsigned char ch;
+} command_trie_t;
+
+static command_trie_t *commands_trie = NULL;
+static int commands_trie_dirty = 1;
+
+static void command_trie_free(command_trie_t *n) {
+	while (n) {
+		command_trie_t *next = n->next;
+
+		command_trie_free(n->children);
+		xfree(n);
+		n = next;
+	}
+}
+
+static void command_trie_insert(command_t *c) {
+	command_trie_t *n = commands_trie;
+	const char *p;
+
+	n->count++;
+	for (p = c->name; *p; p++) {
+		unsigned char ch = tolower((unsigned char) *p);
+		command_trie_t **pn = &n->children;
+
+		while (*pn && (*pn)->ch < ch)
+			pn = &(*pn)->next;
+
+		if (!*pn || (*pn)->ch != ch) {
+			command_trie_t *tmp = xmalloc(sizeof(command_trie_t));
+
+			tmp->ch		= ch;
+			tmp->next	= *pn;
+			*pn		= tmp;
+		}
+		n = *pn;
+		n->count++;
+	}
+
+	/* the same name registered twice? first one wins, like in sorted list */
+	if (!n->command)
+		n->command = c;
+}
+
+static command_trie_t *command_trie_get(void) {
+	GSList *cl;
+
+	if (!commands_trie_dirty)
+		return commands_trie;
+
+	command_trie_free(commands_trie);
+	commands_trie = xmalloc(sizeof(command_trie_t));
+
+	for (cl = commands; cl; cl = cl->next)
+		command_trie_insert(cl->data);
+
+	commands_trie_dirty = 0;
+	return commands_trie;
+}
+
+static command_trie_t *command_trie_walk(command_trie_t *n, const char *s, size_t len) {
+	for (; n && len && *s; s++, len--) {
+		unsigned char ch = tolower((unsigned char) *s);
+
+		for (n = n->children; n && n->ch < ch; n = n->next)
+			;
+		if (n && n->ch != ch)
+			return NULL;
+	}
+	return n;
+}
+
+static void command_trie_foreach(command_trie_t *n, void (*func)(command_t *c, void *data), void *data) {
+	if (n->command)
+		func(n->command, data);
+
+	for (n = n->children; n; n = n->next)
+		command_trie_foreach(n, func, data);
+}
+
+/**
+ * command_lookup()
+ *
+ * Look for commands which names start with @a prefix (first @a plen chars) followed by
+ * first @a len chars of @a name. Comparison is case-insensitive.
+ *
+ * @param exact - if not NULL, command named exactly like that is stored here (or NULL)
+ * @param first - if not NULL, first (in sorted order) matching command is stored here.
+ *		  If return value is 1, it's the only one.
+ *
+ * @return number of matching commands
+ */
+
+int command_lookup(const char *prefix, size_t plen, const char *name, size_t len, command_t **exact, command_t **first) {
+	command_trie_t *n = command_trie_get();
+
+	if (exact)
+		*exact = NULL;
+	if (first)
+		*first = NULL;
+
+	if (prefix)
+		n = command_trie_walk(n, prefix, plen);
+	if (n)
+		n = command_trie_walk(n, name, len);
+	if (!n || !n->count)
+		return 0;
+
+	if (exact)
+		*exact = n->command;
+
+	if (first) {
+		command_trie_t *tmp = n;
+
+		while (!tmp->command)
+			tmp = tmp->children;
+		*first = tmp->command;
+	}
+
+	return n->count;
+}
+
+/**
+ * command_foreach()
+ *
+ * Call @a func for each command which name starts with @a prefix and @a name,
+ * like command_lookup() matches them, in sorted order.
+ */
+
+void command_foreach(const char *prefix, size_t plen, const char *name, size_t len, void (*func)(command_t *c, void *data), void *data) {
+	command_trie_t *n = command_trie_get();
+
+	if (prefix)
+		n = command_trie_walk(n, prefix, plen);
+	if (n)
+		n = command_trie_walk(n, name, len);
+	if (n)
+		command_trie_foreach(n, func, data);
+}
+
 static gint command_compare(gconstpointer a, gconstpointer b) {
 	const command_t *data1 = (const command_t *) a;
 	const command_t *data2 = (const command_t *) b;
@@ -95,15 +245,22 @@ static void list_command_free(void *_data) {
 
 static void commands_add(command_t *c) {
 	commands = g_slist_insert_sorted(commands, c, command_compare);
+	commands_trie_dirty = 1;
 }
 
 void commands_remove(command_t *c) {
 	commands = g_slist_remove(commands, c);
+	commands_trie_dirty = 1;
 	list_command_free(c);
 }
 
 void commands_destroy() {
 	g_slist_free_full(commands, list_command_free);
+	commands = NULL;
+
+	command_trie_free(commands_trie);
+	commands_trie = NULL;
+	commands_trie_dirty = 1;
 }
 
 /*
@@ -332,6 +489,7 @@ COMMAND(cmd_add) {
 	if (u) {
 		xfree(u->nickname);
 		u->nickname = xstrdup(params[1]);
+		userlist_replace(session, u);
 	}
 
 	if (u || userlist_add(session, params[0], params[1])) {
@@ -1193,7 +1351,7 @@ static COMMAND(cmd_ignore)
 				userlist_t *u = ul;
 				int level;
 
-				if (!(level = ignored_check(session, u->uid)))
+				if (!(level = ignored_check_u(u)))
 					continue;
 
 				i = 1;
@@ -1944,24 +2102,113 @@ static COMMAND(cmd_debug_watches)
 	return 0;
 }
 
+/*
+ * cmd_debug_queries_dump()
+ *
+ * zapisuje statystyki zapytan do pliku, jedna linia na handler:
+ * name plugin count total_us max_us hist[0] ... hist[QUERY_TIME_HIST-1]
+ * rozdzielone tabami.
+ */
+static int cmd_debug_queries_dump(const char *fname) {
+	query_t **kk, *g;
+	FILE *f;
+
+	if (!(f = fopen(fname, "w")))
+		return -1;
+
+	fprintf(f, "# name\tplugin\tcount\ttotal_us\tmax_us\thist (< 2^i us)\n");
+
+	for (kk = queries; kk < &queries[QUERIES_BUCKETS]; ++kk) {
+		for (g = *kk; g; g = g->next) {
+			int i;
+
+			fprintf(f, "%s\t%s\t%d\t%" G_GUINT64_FORMAT "\t%" G_GUINT64_FORMAT,
+				g->name, (g->plugin) ? g->plugin->name : "-", g->count, g->time_total, g->time_max);
+			for (i = 0; i < QUERY_TIME_HIST; i++)
+				fprintf(f, "\t%u", g->time_hist[i]);
+			fprintf(f, "\n");
+		}
+	}
+
+	fclose(f);
+	return 0;
+}
+
 static COMMAND(cmd_debug_queries)
 {
         query_t **kk, *g;
-	
-	printq("generic", ("name			     | plugin	   | count"));
-	printq("generic", ("---------------------------------|-------------|------"));
+	query_def_t *gd;
+	GSList *pl;
+	char buf[256];
+
+	if (match_arg(params[0], 'r', ("reset"), 2)) {
+		query_time_reset();
+		return 0;
+	}
+
+	if (match_arg(params[0], 'd', ("dump"), 2)) {
+		const char *fname = params[1] ? prepare_path_user(params[1]) : prepare_path("ekg2-dump.queries", 1);
+
+		if (!fname || cmd_debug_queries_dump(fname)) {
+			printq("generic_error", strerror(errno));
+			return -1;
+		}
+		printq("generic", fname);
+		return 0;
+	}
+
+	printq("generic", ("name			     | plugin	   | count  | total ms | max us   | avg us"));
+	printq("generic", ("---------------------------------|-------------|--------|----------|----------|-------"));
 	
         for (kk = queries; kk < &queries[QUERIES_BUCKETS]; ++kk) {
                 for (g = *kk; g; g = g->next) {
-                        char buf[256];
 			const char *plugin = (g->plugin) ? g->plugin->name : ("-");
 
-			snprintf(buf, sizeof(buf), "%-32s | %-11s | %d", __(g->name), plugin, g->count);
+			snprintf(buf, sizeof(buf), "%-32s | %-11s | %-6d | %-8" G_GUINT64_FORMAT " | %-8" G_GUINT64_FORMAT " | %" G_GUINT64_FORMAT,
+				__(g->name), plugin, g->count, g->time_total / 1000, g->time_max,
+				(g->count) ? g->time_total / g->count : 0);
 			printq("generic", buf);
 
                 }
         }
 
+	for (gd = registered_queries; gd; gd = gd->next) {
+		if (!(gd->flags & QUERY_DEFERRABLE))
+			continue;
+		snprintf(buf, sizeof(buf), "%s: %u emissions merged", gd->name, query_deferred_merged(query_id(gd->name)));
+		printq("generic", buf);
+	}
+
+	if (!config_debug_queries)
+		return 0;
+
+	/* totals for plugins, core handlers are shown as '-' */
+	printq("generic", ("plugin	    | count    | total ms"));
+	printq("generic", ("-------------|----------|---------"));
+
+	for (pl = plugins; ; pl = pl->next) {
+		plugin_t *p = pl ? pl->data : NULL;
+		guint64 total = 0;
+		int count = 0;
+
+                for (kk = queries; kk < &queries[QUERIES_BUCKETS]; ++kk) {
+			for (g = *kk; g; g = g->next) {
+				if (g->plugin != p)
+					continue;
+				count += g->count;
+				total += g->time_total;
+			}
+		}
+
+		if (count) {
+			snprintf(buf, sizeof(buf), "%-12s | %-8d | %" G_GUINT64_FORMAT, p ? p->name : "-", count, total / 1000);
+			printq("generic", buf);
+		}
+
+		if (!pl)
+			break;
+	}
+
 	return 0;
 }
 
@@ -2444,7 +2691,7 @@ int command_exec(const char *target, session_t *session, const char *xline, int
 
 	int exact = 0;
 
-	GSList *cl;
+	command_t *c;
 
 	if (!xline)
 		return 0;
@@ -2455,18 +2702,13 @@ int command_exec(const char *target, session_t *session, const char *xline, int
 	
 		/* detection of commands entered by mistake */
 		if (config_query_commands) {
-			for (cl = commands; cl; cl = cl->next) {
-				command_t *c = cl->data;
-				size_t l = xstrlen(c->name);
+			size_t l;
 
-				if (l < 3 || xstrncasecmp(xline, c->name, l))
-					continue;
-				
-				if (!xline[l] || xisspace(xline[l])) {
-					correct_command = 1;
-					break;
-				}
-			}		
+			for (l = 0; xline[l] && !xisspace(xline[l]); l++)
+				;
+
+			if (l >= 3 && command_lookup(NULL, 0, xline, l, &c, NULL) && c)
+				correct_command = 1;
 		}
 
 		if (!correct_command)
@@ -2497,13 +2739,10 @@ int command_exec(const char *target, session_t *session, const char *xline, int
 
 	/* Check if this is a special one-character command. These are special
 	 * because they do not require whitespace to separate them from their arguments. */
-	for (cl = commands; cl; cl = cl->next) {
-		command_t *c = cl->data;
-		if (!isalpha_pl_PL(c->name[0]) && xstrlen(c->name) == 1 && line[0] == c->name[0]) {
-			short_cmd[0] = c->name[0];
-			cmd = short_cmd;
-			p = line + 1;
-		}
+	if (line[0] && command_lookup(NULL, 0, line, 1, &c, NULL) && c && !isalpha_pl_PL(c->name[0])) {
+		short_cmd[0] = c->name[0];
+		cmd = short_cmd;
+		p = line + 1;
 	}
 	/* Separate command from arguments if not. */
 	if (!cmd) {
@@ -2524,51 +2763,31 @@ int command_exec(const char *target, session_t *session, const char *xline, int
 		session = session_current;
 	if (session && session->uid) {
 		int prefix_len = (int)(xstrchr(session->uid, ':') - session->uid) + 1;
-		
-		for (cl = commands; cl; cl = cl->next) {
-			command_t *c = cl->data;
-			/* Consider commands prefixed with current session's prefix. */
-			if (xstrncasecmp(c->name, session->uid, prefix_len))
-				continue;
-			/* Look for fully spelled out command. */
-			if (!xstrcasecmp(c->name + prefix_len, cmd)) {
-				last_command = c;
-				abbrs = 1;
-				exact = 1;
-				break;
-			}
-			/* Fall back to the first matching prefix. */
-			if (!xstrncasecmp(c->name + prefix_len, cmd, cmdlen)) {
-				last_command_plugin = c;
-				abbrs_plugins++;
-			} else {
-				/* TODO: document what this does */
-				if (last_command_plugin && abbrs_plugins == 1)
-					break;
-			} 
-		}
+		/* Consider commands prefixed with current session's prefix. */
+		int count = command_lookup(session->uid, prefix_len, cmd, cmdlen, &c, &last_command_plugin);
+
+		/* Look for fully spelled out command. */
+		if (c) {
+			last_command = c;
+			abbrs = 1;
+			exact = 1;
+			last_command_plugin = NULL;
+		} else	/* Fall back to the only matching prefix. */
+			abbrs_plugins = count;
 	}
 	/* If needed, fall back to non-session-specific commands. */
 	if (!exact) {
-		for (cl = commands; cl; cl = cl->next) {
-			command_t *c = cl->data;
-			if (!xstrcasecmp(c->name, cmd)) {
-				last_command = c;
-				abbrs = 1;
-				exact = 1;
-				/* if this is exact_match we should zero those below, they won't be used */
-				abbrs_plugins = 0; 
-				last_command_plugin = NULL;
-				break;
-			}
-			if (!xstrncasecmp(c->name, cmd, cmdlen)) {
-				last_command = c;
-				abbrs++;
-			} else {
-				if (last_command && abbrs == 1)
-					break;
-			}
-		} 
+		int count = command_lookup(NULL, 0, cmd, cmdlen, &c, &last_command);
+
+		if (c) {
+			last_command = c;
+			abbrs = 1;
+			exact = 1;
+			/* if this is exact_match we should zero those below, they won't be used */
+			abbrs_plugins = 0; 
+			last_command_plugin = NULL;
+		} else
+			abbrs = count;
 	}
 /*	debug("%x %x\n", last_command, last_command_plugin);	*/
 
@@ -3671,7 +3890,7 @@ void command_init()
 
 	command_add(NULL, ("_plugins"), NULL, cmd_debug_plugins, 0, NULL);
 
-	command_add(NULL, ("_queries"), NULL, cmd_debug_queries, 0, NULL);
+	command_add(NULL, ("_queries"), "p ?", cmd_debug_queries, 0, "-d --dump -r --reset");
 
 	command_add(NULL, ("_query"), "? ? ? ? ? ? ? ? ? ?", cmd_debug_query, 0,NULL); 
 
@@ -78,6 +78,8 @@ extern GSList *commands;
 command_t *command_add(plugin_t *plugin, const char *name, char *params, command_func_t function, command_flags_t flags, char *possibilities);
 int command_remove(plugin_t *plugin, const char *name);
 command_t *command_find (const char *name);
+int command_lookup(const char *prefix, size_t plen, const char *name, size_t len, command_t **exact, command_t **first);
+void command_foreach(const char *prefix, size_t plen, const char *name, size_t len, void (*func)(command_t *c, void *data), void *data);
 void command_init();
 void commands_remove(command_t *c);
 void commands_destroy();
@@ -38,10 +38,82 @@ int continue_complete_count = 0;
 command_t *actual_completed_command;
 session_t *session_in_line;
 
+static GHashTable *completions_seen = NULL;	/* copies of strings in completions, for deduplication */
+static int completions_count = 0, completions_alloc = 0;
+
+static void completions_free(void) {
+	g_strfreev(completions);
+	completions = NULL;
+	completions_count = completions_alloc = 0;
+
+	if (completions_seen)
+		g_hash_table_remove_all(completions_seen);
+}
+
+static int completion_contains(const char *str) {
+	return (completions && completions_seen && g_hash_table_lookup_extended(completions_seen, str, NULL, NULL));
+}
+
+/*
+ * completion_add()
+ *
+ * like array_add_check(&completions, str, 1), but in O(1).
+ * unlike array_add_check() only exact duplicates are dropped, not
+ * strings which are substrings of already added ones.
+ * str is taken over (or freed if it's already there).
+ */
+static void completion_add(char *str) {
+	if (!completions_seen)
+		completions_seen = g_hash_table_new_full(g_str_hash, g_str_equal, xfree, NULL);
+
+	if (!completions) {
+		completions_count = completions_alloc = 0;
+		g_hash_table_remove_all(completions_seen);
+	}
+
+	if (g_hash_table_lookup_extended(completions_seen, str, NULL, NULL)) {
+		xfree(str);
+		return;
+	}
+
+	if (completions_count + 1 >= completions_alloc) {
+		completions_alloc = completions_alloc ? completions_alloc * 2 : 16;
+		completions = xrealloc(completions, completions_alloc * sizeof(char *));
+	}
+	completions[completions_count++] = str;
+	completions[completions_count] = NULL;
+
+	g_hash_table_insert(completions_seen, xstrdup(str), NULL);
+}
+
+struct command_generator_data {
+	const char *slash, *dash;
+	const char *text;
+	int len;
+	int plen;	/* length of session prefix, with ':' */
+};
+
+static void command_generator_add(command_t *c, void *data) {
+	struct command_generator_data *d = data;
+
+	completion_add(saprintf(("%s%s%s"), d->slash, d->dash, c->name));
+}
+
+static void command_generator_add_session(command_t *c, void *data) {
+	struct command_generator_data *d = data;
+	const char *without_sess_id = c->name + d->plen;
+
+	/* full name was already matched by command_generator_add() */
+	if (!xstrncasecmp(d->text, c->name, d->len))
+		return;
+
+	completion_add(saprintf(("%s%s%s"), d->slash, d->dash, without_sess_id));
+}
+
 static void command_generator(const char *text, int len)
 {
 	const char *slash = (""), *dash = ("");
-	GSList *cl;
+	struct command_generator_data d;
 	session_t *session = session_current;
 	if (*text == ('/')) {
 		slash = ("/");
@@ -58,24 +130,17 @@ static void command_generator(const char *text, int len)
 	if (window_current->target)
 		slash = ("/");
 
-	for (cl = commands; cl; cl = cl->next) {
-		command_t *c = cl->data;
-		char *without_sess_id = NULL;
-		int plen = 0;
-		if (session && session->uid)
-			plen = (int)(xstrchr(session->uid, ':') - session->uid) + 1;
-
-		if (session && !xstrncasecmp(c->name, session->uid, plen))
-			without_sess_id = xstrchr(c->name, ':');
-
-		if (!xstrncasecmp(text, c->name, len) && !array_item_contains(completions, c->name, 1))
-			array_add_check(&completions, 
-					saprintf(("%s%s%s"), slash, dash, c->name),
-					1);
-		else if (without_sess_id && !array_item_contains(completions, without_sess_id + 1, 1) && !xstrncasecmp(text, without_sess_id + 1, len))
-			array_add_check(&completions, 
-					saprintf(("%s%s%s"), slash, dash, without_sess_id + 1),
-					1);
+	d.slash	= slash;
+	d.dash	= dash;
+	d.text	= text;
+	d.len	= len;
+	d.plen	= 0;
+
+	command_foreach(NULL, 0, text, len, command_generator_add, &d);
+
+	if (session && session->uid) {
+		d.plen = (int)(xstrchr(session->uid, ':') - session->uid) + 1;
+		command_foreach(session->uid, d.plen, text, len, command_generator_add_session, &d);
 	}
 }
 
@@ -84,7 +149,7 @@ static void events_generator(const char *text, int len)
 	int i;
 	for (i = 0; events_all && events_all[i]; i++)
 		if (!xstrncasecmp(text, events_all[i], len))
-			array_add_check(&completions, xstrdup(events_all[i]), 1);
+			completion_add(xstrdup(events_all[i]));
 }
 
 static void ignorelevels_generator(const char *text, int len)
@@ -107,7 +172,7 @@ static void ignorelevels_generator(const char *text, int len)
 
 	for (i = 0; ignore_labels[i].name; i++)
 		if (!xstrncasecmp(tmp, ignore_labels[i].name, len))
-			array_add_check(&completions, ((tmp == text) ? xstrdup(ignore_labels[i].name) : saprintf("%s%s", pre, ignore_labels[i].name)), 1);
+			completion_add(((tmp == text) ? xstrdup(ignore_labels[i].name) : saprintf("%s%s", pre, ignore_labels[i].name)));
 	xfree(pre);
 }
 
@@ -117,15 +182,27 @@ static void unknown_uin_generator(const char *text, int len)
 	
 	for (i = 0; i < send_nicks_count; i++) {
 		if (send_nicks[i] && xstrchr(send_nicks[i], ':') && xisdigit(xstrchr(send_nicks[i], ':')[1]) && !xstrncasecmp(text, send_nicks[i], len)) {
-			array_add_check(&completions, xstrdup(send_nicks[i]), 1);
+			completion_add(xstrdup(send_nicks[i]));
 		}
 	}
 }
 
+static void known_uin_add_nickname(userlist_t *u, void *data) {
+	const char *session_name = data;
+
+	completion_add(session_name ? saprintf(("%s/%s"), session_name, u->nickname) : xstrdup(u->nickname));
+}
+
+static void known_uin_add_uid(userlist_t *u, void *data) {
+	const char *session_name = data;
+
+	completion_add(session_name ? saprintf(("%s/%s"), session_name, u->uid) : xstrdup(u->uid));
+}
+
 static void known_uin_generator(const char *text, int len)
 {
 	int done = 0;
-	userlist_t *ul;
+	userlist_t **ul;
 	session_t *s;
 	char *tmp = NULL, *session_name = NULL;
 	int tmp_len = 0;
@@ -145,46 +222,24 @@ static void known_uin_generator(const char *text, int len)
 			s = session_find(session_name);
 	}
 
-	for (ul = s->userlist; ul; ul = ul->next) {
-		userlist_t *u = ul;
-		if (u->nickname && !xstrncasecmp(text, u->nickname, len)) {
-			array_add_check(&completions, xstrdup(u->nickname), 1);
-			done = 1;
-		}
-		
-		if (u->nickname && tmp && !xstrncasecmp(tmp, u->nickname, tmp_len)) { 
-			array_add_check(&completions, saprintf(("%s/%s"), session_name, u->nickname), 1);
-			done = 1;
-		}
-	}
+	done += userlist_find_prefix(&(s->userlist), text, len, 1, known_uin_add_nickname, NULL);
+	if (tmp)
+		done += userlist_find_prefix(&(s->userlist), tmp, tmp_len, 1, known_uin_add_nickname, session_name);
 
-	for (ul = s->userlist; ul; ul = ul->next) {
-		userlist_t *u = ul;
-
-		if (!done && !xstrncasecmp(text, u->uid, len)) {
-			array_add_check(&completions, xstrdup(u->uid), 1);
-		}
-		if (!done && tmp && !xstrncasecmp(tmp, u->uid, tmp_len)) 
-		       array_add_check(&completions, saprintf(("%s/%s"), session_name, u->uid), 1);
+	if (!done) {
+		userlist_find_prefix(&(s->userlist), text, len, 0, known_uin_add_uid, NULL);
+		if (tmp)
+			userlist_find_prefix(&(s->userlist), tmp, tmp_len, 0, known_uin_add_uid, session_name);
 	}
 
 	if (!window_current) 
 		goto end;
 
-	if ((c = newconference_find(window_current->session, window_current->target)))	ul = c->participants;
-	else										ul = window_current->userlist;
+	if ((c = newconference_find(window_current->session, window_current->target)))	ul = &(c->participants);
+	else										ul = &(window_current->userlist);
 
-	for (; ul; ul = ul->next) {
-		userlist_t *u = ul;
-
-		if (u->uid && !xstrncasecmp(text, u->uid, len)) {
-			array_add_check(&completions, xstrdup(u->uid), 1);
-		}
-
-		if (u->nickname && !xstrncasecmp(text, u->nickname, len)) {
-			array_add_check(&completions, xstrdup(u->nickname), 1);
-		}
-	} 
+	userlist_find_prefix(ul, text, len, 0, known_uin_add_uid, NULL);
+	userlist_find_prefix(ul, text, len, 1, known_uin_add_nickname, NULL);
 
 end:
 	if (session_name)
@@ -197,7 +252,7 @@ static void conference_generator(const char *text, int len)
 
 	for (c = newconferences; c; c = c->next) {
 		if (!xstrncasecmp(text, c->name, len))
-			array_add_check(&completions, xstrdup(c->name), 1);
+			completion_add(xstrdup(c->name));
 	}
 }
 
@@ -208,11 +263,11 @@ static void plugin_generator(const char *text, int len)
 	for (pl = plugins; pl; pl = pl->next) {
 		const plugin_t *p = pl->data;
 		if (!xstrncasecmp(text, p->name, len)) {
-			array_add_check(&completions, xstrdup(p->name), 1);
+			completion_add(xstrdup(p->name));
 		}
 		if ((text[0] == '+' || text[0] == '-') && !xstrncasecmp(text + 1, p->name, len - 1)) {
 			char *tmp = saprintf(("%c%s"), text[0], p->name);
-			array_add_check(&completions, tmp, 1);
+			completion_add(tmp);
 		}
 	}
 }
@@ -227,12 +282,10 @@ static void variable_generator(const char *text, int len)
 			continue;
 		if (*text == '-') {
 			if (!xstrncasecmp(text + 1, v->name, len - 1))
-				array_add_check(&completions, 
-				saprintf("-%s", v->name),
-				1);
+				completion_add(saprintf("-%s", v->name));
 		} else {
 			if (!xstrncasecmp(text, v->name, len)) {
-				array_add_check(&completions, xstrdup(v->name), 1);
+				completion_add(xstrdup(v->name));
 			}
 		}
 	}
@@ -251,15 +304,15 @@ static void ignored_uin_generator(const char *text, int len)
 	for (ul = s->userlist; ul; ul = ul->next) {
 		userlist_t *u = ul;
 
-		if (!ignored_check(s, u->uid))
+		if (!ignored_check_u(u))
 			continue;
 
 		if (!u->nickname) {
 			if (!xstrncasecmp(text, u->uid, len))
-				array_add_check(&completions, xstrdup(u->uid), 1);
+				completion_add(xstrdup(u->uid));
 		} else {
 			if (u->nickname && !xstrncasecmp(text, u->nickname, len))
-				array_add_check(&completions, xstrdup(u->nickname), 1);
+				completion_add(xstrdup(u->nickname));
 		}
 	}
 }
@@ -282,10 +335,10 @@ static void blocked_uin_generator(const char *text, int len)
 
 		if (!u->nickname) {
 			if (!xstrncasecmp(text, u->uid, len))
-				array_add_check(&completions, xstrdup(u->uid), 1);
+				completion_add(xstrdup(u->uid));
 		} else {
 			if (u->nickname && !xstrncasecmp(text, u->nickname, len))
-				array_add_check(&completions, xstrdup(u->nickname), 1);
+				completion_add(xstrdup(u->nickname));
 		}
 	}
 }
@@ -372,7 +425,7 @@ static void dir_generator(const char *text, int len)
 
 		if (!strncmp(name, fname, xstrlen(fname))) {
 			name = saprintf("%s%s%s", (dname) ? dname : "", name, "/");
-			array_add_check(&completions, name, 1);
+			completion_add(name);
 		}
 
 		xfree(namelist[i]);
@@ -458,7 +511,7 @@ again:
 
 		if (!strncmp(name, fname, xstrlen(fname))) {
 			name = saprintf("%s%s%s", (dname) ? dname : "", name, (isdir) ? "/" : "");
-			array_add_check(&completions, name, 1);
+			completion_add(name);
 		}
 
 		xfree(namelist[i]);
@@ -473,8 +526,7 @@ again:
 		fname = "";
 		xfree(namelist);
 		namelist = NULL;
-		g_strfreev(completions);
-		completions = NULL;
+		completions_free();
 
 		goto again;
 	}
@@ -523,7 +575,7 @@ static void theme_generator_adding(const char *text, int len, const char *dname,
 		tmp2 = xstrndup(name, xstrlen(name) - xstrlen(xstrstr(name, ".theme")));
 		
 		if (!xstrncmp(text, name, len) || (!xstrncmp(text, tmp2, len) && !themes_only) )
-			array_add_check(&completions, tmp2, 1);
+			completion_add(tmp2);
 		else	xfree(tmp2);
 
 		xfree(namelist[i]);
@@ -551,7 +603,7 @@ static void possibilities_generator(const char *text, int len)
 
 	for (i = 0; c && c->possibilities && c->possibilities[i]; i++)
 		if (!xstrncmp(text, c->possibilities[i], len)) {
-			array_add_check(&completions, xstrdup(c->possibilities[i]), 1);
+			completion_add(xstrdup(c->possibilities[i]));
 		}
 }
 
@@ -563,7 +615,8 @@ static void window_generator(const char *text, int len)
 		if (!w->target || xstrncmp(text, w->target, len))
 			continue;
 
-		array_add_check(&completions, xstrdup(w->target), 0);
+		if (!completion_contains(w->target))
+			completion_add(xstrdup(w->target));
 	}
 }
 
@@ -574,14 +627,14 @@ static void sessions_generator(const char *text, int len)
 	for (v = sessions; v; v = v->next) {
 		if (*text == '-') {
 			if (!xstrncasecmp(text + 1, v->uid, len - 1))
-				array_add_check(&completions, saprintf("-%s", v->uid), 1);
+				completion_add(saprintf("-%s", v->uid));
 			if (!xstrncasecmp(text + 1, v->alias, len - 1))
-				array_add_check(&completions, saprintf("-%s", v->alias), 1);
+				completion_add(saprintf("-%s", v->alias));
 		} else {
 			if (!xstrncasecmp(text, v->uid, len))
-				array_add_check(&completions, xstrdup(v->uid), 1);
+				completion_add(xstrdup(v->uid));
 			if (!xstrncasecmp(text, v->alias, len))
-				array_add_check(&completions, xstrdup(v->alias), 1);
+				completion_add(xstrdup(v->alias));
 		}
 	}
 }
@@ -592,7 +645,7 @@ static void metacontacts_generator(const char *text, int len)
 
 	for (m = metacontacts; m; m = m->next) {
 		if (!xstrncasecmp(text, m->name, len)) 
-			array_add_check(&completions, xstrdup(m->name), 1);
+			completion_add(xstrdup(m->name));
 	}
 }
 
@@ -615,10 +668,10 @@ static void sessions_var_generator(const char *text, int len)
 	for (i = 0; (p->params[i].key /* && p->params[i].id != -1 */); i++) {
 		if(*text == '-') {
 			if (!xstrncasecmp(text + 1, p->params[i].key, len - 1))
-				array_add_check(&completions, saprintf(("-%s"), p->params[i].key), 1);
+				completion_add(saprintf(("-%s"), p->params[i].key));
 		} else {
 			if (!xstrncasecmp(text, p->params[i].key, len)) {
-				array_add_check(&completions, xstrdup(p->params[i].key), 1);
+				completion_add(xstrdup(p->params[i].key));
 			}
 		}
 	}
@@ -629,7 +682,7 @@ static void reason_generator(const char *text, int len)
 	char *descr = session_current ? session_current->descr : NULL;
 	if (descr && !xstrncasecmp(text, descr, len)) {
 		/* not to good solution to avoid descr changing by complete */
-		array_add_check(&completions, saprintf(("\001%s"), session_current->descr), 1);
+		completion_add(saprintf(("\001%s"), session_current->descr));
 	}
 }
 
@@ -892,7 +945,7 @@ int ekg2_complete(int *line_start, int *line_index, char *line, int line_maxlen)
 		*line_start = 0;
 		*line_index = xstrlen(line);
 
-		g_strfreev(completions);
+		completions_free();
 		g_strfreev(words);
 		xfree(start);
 		xfree(separators);
@@ -940,7 +993,7 @@ int ekg2_complete(int *line_start, int *line_index, char *line, int line_maxlen)
 	} else {
 		char **params = NULL;
 		int i;
-		GSList *cl;
+		command_t *c;
 		char *cmd = (line[0] == '/') ? line + 1 : line;
 		int len;
 
@@ -951,28 +1004,18 @@ int ekg2_complete(int *line_start, int *line_index, char *line, int line_maxlen)
 			session_t *session = session_current;
 			int plen = (int)(xstrchr(session->uid, ':') - session->uid) + 1;
 
-			for (cl = commands; cl; cl = cl->next) {
-				command_t *c = cl->data;
-				if (xstrncasecmp(c->name, session->uid, plen))
-					continue;
-
-				if (!xstrncasecmp(c->name + plen, cmd, len)) {
-					params = c->params;
-					actual_completed_command = c;
-					goto exact_match;
-				}
-			}
-		}
-
-		for (cl = commands; cl; cl = cl->next) {
-			command_t *c = cl->data;
-			if (!xstrncasecmp(c->name, cmd, len)) {
+			if (command_lookup(session->uid, plen, cmd, len, NULL, &c)) {
 				params = c->params;
 				actual_completed_command = c;
-				break;
+				goto exact_match;
 			}
 		}
 
+		if (command_lookup(NULL, 0, cmd, len, NULL, &c)) {
+			params = c->params;
+			actual_completed_command = c;
+		}
+
 exact_match: 
 		/* for /set maybe we want to complete the file path */
 		if (!xstrncmp(cmd, "set", 3) && words[1] && words[2] && word_current == 3) {
@@ -1064,8 +1107,7 @@ exact_match:
 			else if (line[xstrlen(line) - 1] != ' ')
 				xstrncat(line, separators + i, 1);
 		}
-		g_strfreev(completions);
-		completions = NULL;
+		completions_free();
 	} else 
 
 	/*
@@ -1171,8 +1213,7 @@ cleanup:
 
 void ekg2_complete_clear()
 {
-	g_strfreev(completions);
-	completions = NULL;
+	completions_free();
 	ekg2_completions = NULL;
 	continue_complete = 0;
 	continue_complete_count = 0;
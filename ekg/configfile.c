@@ -110,37 +110,28 @@ static GPtrArray *config_openfiles = NULL;
 static GCancellable *config_cancellable = NULL;
 
 /**
- * ekg_fprintf()
+ * ekg_fwrite()
  *
- * Output formatted string to a GOutputStream.
+ * Output @a len bytes of @a buf to a GOutputStream. If the write fails,
+ * the config file it belongs to won't be committed.
  *
  * @param f - writable GOutputStream.
- * @param format - the format string.
- * 
- * @return TRUE on success, FALSE otherwise.
+ * @param buf - data to write.
+ * @param len - length of data.
  *
- * @note The channel must be open for writing in blocking mode.
+ * @return TRUE on success, FALSE otherwise.
  */
-gboolean ekg_fprintf(GOutputStream *f, const gchar *format, ...) {
-	static GString *buf = NULL;
-	va_list args;
+gboolean ekg_fwrite(GOutputStream *f, const gchar *buf, gsize len) {
 	gsize out;
 	GError *err = NULL;
 
-	if (!buf)
-		buf = g_string_sized_new(120);
-
-	va_start(args, format);
-	g_string_vprintf(buf, format, args);
-	va_end(args);
-	
-	out = g_output_stream_write(f, buf->str, buf->len, NULL, &err);
+	out = g_output_stream_write(f, buf, len, NULL, &err);
 
-	if (out < buf->len) {
+	if (out < len) {
 		gpointer *p;
 
-		debug_error("ekg_fprintf() failed (wrote %d out of %d): %s\n",
-				out, buf->len, err ? err->message : "(no error?!)");
+		debug_error("ekg_fwrite() failed (wrote %d out of %d): %s\n",
+				out, len, err ? err->message : "(no error?!)");
 		g_error_free(err);
 
 		if (config_openfiles) {
@@ -158,6 +149,32 @@ gboolean ekg_fprintf(GOutputStream *f, const gchar *format, ...) {
 	return TRUE;
 }
 
+/**
+ * ekg_fprintf()
+ *
+ * Output formatted string to a GOutputStream.
+ *
+ * @param f - writable GOutputStream.
+ * @param format - the format string.
+ * 
+ * @return TRUE on success, FALSE otherwise.
+ *
+ * @note The channel must be open for writing in blocking mode.
+ */
+gboolean ekg_fprintf(GOutputStream *f, const gchar *format, ...) {
+	static GString *buf = NULL;
+	va_list args;
+
+	if (!buf)
+		buf = g_string_sized_new(120);
+
+	va_start(args, format);
+	g_string_vprintf(buf, format, args);
+	va_end(args);
+	
+	return ekg_fwrite(f, buf->str, buf->len);
+}
+
 static GObject *config_open_real(const gchar *path, const gchar *mode) {
 	GFile *f;
 	GObject *instream, *stream;
@@ -835,6 +852,10 @@ pass:
 	return 0;
 }
 
+static void debug_write_crash_line(guint32 seq, int level, time_t ts, const char *line, void *data) {
+	ekg_fprintf(G_OUTPUT_STREAM(data), "%s\n", line);
+}
+
 /*
  * debug_write_crash()
  *
@@ -843,15 +864,13 @@ pass:
 void debug_write_crash()
 {
 	GOutputStream *f;
-	struct buffer *b;
 
 	g_chdir(config_dir);
 
 	if (!(f = G_OUTPUT_STREAM(config_open("crash-%d-debug", "w", (int) getpid()))))
 		return;
 
-	for (b = buffer_debug.data; b; b = b->next)
-		ekg_fprintf(f, "%s\n", b->line);
+	debug_ring_foreach(0, debug_write_crash_line, f);
 }
 
 /*
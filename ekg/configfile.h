@@ -33,6 +33,7 @@ extern "C" {
 #endif
 
 void config_postread();
+gboolean ekg_fwrite(GOutputStream *f, const gchar *buf, gsize len);
 gboolean ekg_fprintf(GOutputStream *f, const gchar *format, ...)
 	G_GNUC_PRINTF(2, 3);
 GObject *config_open(const gchar *path_format, const gchar *mode, ...)
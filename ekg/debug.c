@@ -0,0 +1,176 @@
+/*
+ *  This program is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License Version 2 as
+ *  published by the Free Software Foundation.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program; if not, write to the Free Software
+ *  Foundation, Inc., 675 Mass Ave, Cambridge, MA 02139, USA.
+ */
+
+#include "ekg2.h"
+
+#include <string.h>
+
+#define DEBUG_RECORD_MORE	0x01	/* line continues in the next record */
+#define DEBUG_RECORD_CONT	0x02	/* this is not the first record of the line */
+
+typedef struct {
+	guint32		seq;		/* line number, the same in every record of the line */
+	guint8		level;
+	guint8		flags;
+	guint16		len;
+	gint64		ts;
+	char		text[DEBUG_RECORD_TEXT];
+} debug_record_t;
+
+int config_debug_levels = DEBUG_LEVELS_ALL;
+
+static debug_record_t debug_ring[DEBUG_RING_RECORDS];
+static guint debug_ring_head;		/* next record to write */
+static guint debug_ring_used;
+static guint32 debug_line_seq;		/* seq of last added line */
+static guint32 debug_window_seq;	/* seq of last line printed in window_debug */
+
+/**
+ * debug_ring_add()
+ *
+ * Store @a line in the ring, overwriting the oldest records.
+ */
+
+void debug_ring_add(int level, const char *line) {
+	gsize len = xstrlen(line);
+	guint32 seq = ++debug_line_seq;
+	gint64 ts = time(NULL);
+	int flags = 0, i;
+
+	for (i = 0; i < DEBUG_LINE_RECORDS; i++) {
+		debug_record_t *r = &debug_ring[debug_ring_head];
+		gsize n = MIN(len, DEBUG_RECORD_TEXT);
+
+		r->seq		= seq;
+		r->level	= level;
+		r->len		= n;
+		r->ts		= ts;
+		memcpy(r->text, line, n);
+
+		line += n;
+		len -= n;
+		r->flags = flags | ((len && i + 1 < DEBUG_LINE_RECORDS) ? DEBUG_RECORD_MORE : 0);
+		flags = DEBUG_RECORD_CONT;
+
+		debug_ring_head = (debug_ring_head + 1) % DEBUG_RING_RECORDS;
+		if (debug_ring_used < DEBUG_RING_RECORDS)
+			debug_ring_used++;
+
+		if (!(r->flags & DEBUG_RECORD_MORE))
+			break;
+	}
+}
+
+/**
+ * debug_ring_foreach()
+ *
+ * Call @a func for each complete line in the ring newer than @a after, oldest first.
+ * Lines whose first records were already overwritten are skipped.
+ */
+
+void debug_ring_foreach(guint32 after, debug_ring_func_t func, void *data) {
+	static GString *line = NULL;
+	guint count = debug_ring_used;
+	guint idx = (debug_ring_head + DEBUG_RING_RECORDS - count) % DEBUG_RING_RECORDS;
+	guint32 cur = 0;
+	guint i;
+
+	if (!line)
+		line = g_string_sized_new(DEBUG_RECORD_TEXT * 4);
+
+	for (i = 0; i < count; i++, idx = (idx + 1) % DEBUG_RING_RECORDS) {
+		const debug_record_t *r = &debug_ring[idx];
+
+		if ((gint32) (r->seq - after) <= 0)
+			continue;
+
+		if (r->flags & DEBUG_RECORD_CONT) {
+			if (!cur || r->seq != cur)
+				continue;
+		} else {
+			g_string_truncate(line, 0);
+			cur = r->seq;
+		}
+
+		g_string_append_len(line, r->text, r->len);
+
+		if (!(r->flags & DEBUG_RECORD_MORE)) {
+			func(r->seq, r->level, (time_t) r->ts, line->str, data);
+			cur = 0;
+		}
+	}
+}
+
+guint32 debug_ring_seq(void) {
+	return debug_line_seq;
+}
+
+void debug_ring_clear(void) {
+	debug_ring_head = 0;
+	debug_ring_used = 0;
+	debug_window_seq = debug_line_seq;
+}
+
+const char *debug_level_format(int level) {
+	switch (level) {
+		case DEBUG_IO:		return "iodebug";
+		case DEBUG_IORECV:	return "iorecvdebug";
+		case DEBUG_FUNCTION:	return "fdebug";
+		case DEBUG_ERROR:	return "edebug";
+		case DEBUG_WHITE:	return "wdebug";
+		case DEBUG_WARN:	return "warndebug";
+		case DEBUG_OK:		return "okdebug";
+		default:		return "debug";
+	}
+}
+
+static void debug_window_print(guint32 seq, int level, time_t ts, const char *line, void *data) {
+	debug_window_seq = seq;
+	print_window_w(window_debug, EKG_WINACT_NONE, debug_level_format(level), line);
+}
+
+/**
+ * debug_window_sync()
+ *
+ * Print lines which aren't in window_debug yet. Called for every new line
+ * while window_debug is the current one, and when switching to it.
+ */
+
+void debug_window_sync(void) {
+	static int in_sync = 0;
+	int round;
+
+	if (!window_debug || in_sync)
+		return;
+
+	in_sync = 1;
+	/* printing may debug() by itself, those lines go in the next round */
+	for (round = 0; round < 2 && debug_window_seq != debug_line_seq; round++) {
+		guint32 last = debug_line_seq;
+
+		debug_ring_foreach(debug_window_seq, debug_window_print, NULL);
+		debug_window_seq = last;
+	}
+	in_sync = 0;
+}
+
+/*
+ * Local Variables:
+ * mode: c
+ * c-file-style: "k&r"
+ * c-basic-offset: 8
+ * indent-tabs-mode: t
+ * End:
+ */
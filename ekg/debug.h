@@ -3,6 +3,9 @@
 #ifndef __EKG_DEBUG_H
 #define __EKG_DEBUG_H
 
+#include <glib.h>
+#include <time.h>
+
 #ifdef __cplusplus
 extern "C" {
 #endif
@@ -18,6 +21,31 @@ typedef enum {
 	DEBUG_OK
 } debug_level_t;
 
+#define DEBUG_LEVEL_BIT(level)	(1 << (level))	/* bit of config_debug_levels */
+#define DEBUG_LEVELS_ALL	0x1FF
+
+/*
+ * debug ring
+ *
+ * Debug lines are kept in a preallocated ring of fixed-size records,
+ * a line longer than one record takes a few consecutive ones. The debug
+ * window is printed from the ring only when it's visible.
+ */
+#define DEBUG_RECORD_TEXT	240	/* text in one record, with header it's 256 bytes */
+#define DEBUG_RING_RECORDS	1024
+#define DEBUG_LINE_RECORDS	64	/* longer lines are truncated */
+
+typedef void (*debug_ring_func_t)(guint32 seq, int level, time_t ts, const char *line, void *data);
+
+void debug_ring_add(int level, const char *line);
+void debug_ring_foreach(guint32 after, debug_ring_func_t func, void *data);
+guint32 debug_ring_seq(void);
+void debug_ring_clear(void);
+const char *debug_level_format(int level);
+void debug_window_sync(void);
+
+extern int config_debug_levels;
+
 #ifndef DISABLE_DEBUG
 void debug(const char *format, ...);
 void debug_ext(debug_level_t level, const char *format, ...);
@@ -99,12 +99,18 @@ int no_mouse = 0;
  * executed each second.
  */
 static TIMER(ekg_autoaway_timer) {
+	static session_slot_t slot_auto_away = 0, slot_auto_xa = 0;
 	session_t *sl;
 	time_t t;
 
 	if (type)
 		return 0;
 
+	if (!slot_auto_away) {
+		slot_auto_away	= session_slot("auto_away");
+		slot_auto_xa	= session_slot("auto_xa");
+	}
+
 	t = time(NULL);
 
 	/* sprawd autoawaye rnych sesji */
@@ -117,7 +123,7 @@ static TIMER(ekg_autoaway_timer) {
 			continue;
 
 		do {
-			if ((s->status == EKG_STATUS_AWAY) || (tmp = session_int_get(s, "auto_away")) < 1 || !s->activity)
+			if ((s->status == EKG_STATUS_AWAY) || (tmp = session_slot_int_get(s, slot_auto_away)) < 1 || !s->activity)
 				break;
 
 			if (t - s->activity > tmp)
@@ -125,7 +131,7 @@ static TIMER(ekg_autoaway_timer) {
 		} while (0);
 
 		do {
-			if ((tmp = session_int_get(s, "auto_xa")) < 1 || !s->activity)
+			if ((tmp = session_slot_int_get(s, slot_auto_xa)) < 1 || !s->activity)
 				break;
 
 			if (t - s->activity > tmp)
@@ -344,10 +350,9 @@ void ekg_debug_handler(int level, const char *format, va_list ap) {
 	static GString *line = NULL;
 	char *tmp = NULL;
 
-	char *theme_format;
 	int is_UI = 0;
 
-	if (!config_debug)
+	if (!config_debug || !(config_debug_levels & DEBUG_LEVEL_BIT(level)))
 		return;
 
 	if (line) {
@@ -373,25 +378,15 @@ void ekg_debug_handler(int level, const char *format, va_list ap) {
 		tmp[tmplen - 1] = 0;			/* remove '\n' */
 	}
 
-	switch(level) {
-		case 0:				theme_format = "debug";		break;
-		case DEBUG_IO:			theme_format = "iodebug";	break;
-		case DEBUG_IORECV:		theme_format = "iorecvdebug";	break;
-		case DEBUG_FUNCTION:		theme_format = "fdebug";	break;
-		case DEBUG_ERROR:		theme_format = "edebug";	break;
-		case DEBUG_WHITE:		theme_format = "wdebug";	break;
-		case DEBUG_WARN:		theme_format = "warndebug";	break;
-		case DEBUG_OK:			theme_format = "okdebug";	break;
-		default:			theme_format = "debug";		break;
-	}
-
 	ekg_fix_utf8(tmp); /* debug message can contain random data */
-	buffer_add(&buffer_debug, theme_format, tmp);
+	debug_ring_add(level, tmp);
 
 	query_emit(NULL, "ui-is-initialized", &is_UI);
 
 	if (is_UI && window_debug) {
-		print_window_w(window_debug, EKG_WINACT_NONE, theme_format, tmp);
+		/* nobody looks at it, it'll be printed by window_switch() */
+		if (window_current == window_debug)
+			debug_window_sync();
 	}
 #ifdef STDERR_DEBUG	/* STDERR debug */
 	else
@@ -400,6 +395,10 @@ void ekg_debug_handler(int level, const char *format, va_list ap) {
 	xfree(tmp);
 }
 
+static void debug_stderr_print(guint32 seq, int level, time_t ts, const char *line, void *data) {
+	fprintf(stderr, "%s\n", line);
+}
+
 static void glib_debug_handler(const gchar *log_domain, GLogLevelFlags log_level, const gchar *message, gpointer user_data) {
 	static int recurse = 0;
 
@@ -673,15 +672,9 @@ int main(int argc, char **argv)
 	}
 
 	if (!have_plugin_of_class(PLUGIN_UI)) {
-		struct buffer *b;
-		for (b = buffer_debug.data; b; b = b->next)
-			fprintf(stderr, "%s\n", b->line);
+		debug_ring_foreach(0, debug_stderr_print, NULL);
 		fprintf(stderr, "\n\nNo UI-PLUGIN!\n");
 		return 1;
-	} else {
-		struct buffer *b;
-		for (b = buffer_debug.data; b; b = b->next)
-			print_window_w(window_debug, EKG_WINACT_NONE, b->target, b->line);
 	}
 
 	if (!have_plugin_of_class(PLUGIN_PROTOCOL)) {
@@ -952,7 +945,7 @@ void ekg_exit()
 	binding_free();
 	lasts_destroy();
 
-	buffer_free(&buffer_debug);	buffer_free(&buffer_speech);
+	buffer_free(&buffer_speech);
 	event_free();
 	ekg_tls_deinit();
 
@@ -25,6 +25,7 @@
 
 #include <sys/types.h>
 #include <stdio.h>
+#include <string.h>
 
 typedef struct emoticon {
 	struct emoticon *next;
@@ -33,17 +34,94 @@ typedef struct emoticon {
 	char *value;
 } emoticon_t;
 
+/*
+ * drzewo (trie) nazw emoticonow, budowane w emoticon_read(),
+ * kazdy wezel to jeden znak nazwy, dzieci trzymane sa na liscie.
+ */
+typedef struct emoticon_node {
+	struct emoticon_node *next;	/* next sibling */
+	struct emoticon_node *child;	/* first child */
+
+	unsigned char ch;
+	emoticon_t *e;			/* emoticon, which name ends here */
+	int prio;			/* position of e in emoticons list, lower wins */
+} emoticon_node_t;
+
 emoticon_t *emoticons = NULL;
+static emoticon_node_t *emoticons_trie = NULL;
 
 static LIST_FREE_ITEM(list_emoticon_free, emoticon_t *) { xfree(data->name); xfree(data->value); }
 
 DYNSTUFF_LIST_DECLARE(emoticons, emoticon_t, list_emoticon_free,
 	static __DYNSTUFF_LIST_ADD,		/* emoticons_add() */
 	__DYNSTUFF_NOREMOVE,
-	__DYNSTUFF_LIST_DESTROY)		/* emoticons_destroy() */
+	__DYNSTUFF_NODESTROY)			/* emoticons_destroy() */
 
 int config_emoticons = 1;
 
+static void emoticon_trie_free(emoticon_node_t *node) {
+	while (node) {
+		emoticon_node_t *next = node->next;
+
+		emoticon_trie_free(node->child);
+		xfree(node);
+		node = next;
+	}
+}
+
+/*
+ * emoticon_trie_build()
+ *
+ * buduje od nowa drzewo z listy emoticons.
+ */
+static void emoticon_trie_build(void) {
+	emoticon_t *e;
+	int prio = 0;
+
+	emoticon_trie_free(emoticons_trie);
+	emoticons_trie = NULL;
+
+	for (e = emoticons; e; e = e->next, prio++) {
+		emoticon_node_t **nodes = &emoticons_trie;
+		emoticon_node_t *node = NULL;
+		const unsigned char *p;
+
+		if (!e->name || !*e->name)
+			continue;
+
+		for (p = (const unsigned char *) e->name; *p; p++) {
+			for (node = *nodes; node && node->ch != *p; node = node->next)
+				;
+
+			if (!node) {
+				node = xmalloc(sizeof(emoticon_node_t));
+				node->ch = *p;
+				node->next = *nodes;
+				*nodes = node;
+			}
+			nodes = &node->child;
+		}
+
+		if (!node->e) {
+			node->e = e;
+			node->prio = prio;
+		}
+	}
+}
+
+/*
+ * emoticons_destroy()
+ *
+ * zwalnia liste emoticonow i drzewo.
+ */
+void emoticons_destroy(void) {
+	emoticon_trie_free(emoticons_trie);
+	emoticons_trie = NULL;
+
+	LIST_DESTROY2(emoticons, list_emoticon_free);
+	emoticons = NULL;
+}
+
 /*
  * emoticon_add()
  *
@@ -107,6 +185,8 @@ int emoticon_read() {
 	}
 	
 	g_object_unref(f);
+
+	emoticon_trie_build();
 	
 	return 0;
 }
@@ -121,61 +201,45 @@ int emoticon_read() {
  * zwraca zaalokowany, rozwinity string.
  */
 char *emoticon_expand(const char *s) {
-	emoticon_t *el = NULL;
+	GString *ms;
 	const char *ss;
-	char *ms;
-	size_t n = 0;
 
 	if (!s)
 		return NULL;
 
-	for (ss = s; *ss; ss++) {
-		emoticon_t *e = NULL;
-		size_t ns = xstrlen(ss);
-		int ret = 1;
-
-		for (el = emoticons; el && ret; el = (ret ? el->next : el)) {
-			size_t nn;
+	ms = g_string_sized_new(strlen(s));
 
-			e = el;
-			nn = xstrlen(e->name);
-			if (ns >= nn)
-				ret = xstrncmp(ss, e->name, nn);
-		}
-
-		if (el) {
-			e = el;
-			n += xstrlen(e->value);
-			ss += xstrlen(e->name) - 1;
-		} else
-			n++;
-	}
+	for (ss = s; *ss; ) {
+		const emoticon_node_t *nodes = emoticons_trie;
+		const emoticon_node_t *best = NULL;
+		const unsigned char *p;
+		size_t bestlen = 0;
 
-	ms = xcalloc(1, n + 1);
+		/* sposrod pasujacych w tym miejscu wybieramy pierwszy z listy */
+		for (p = (const unsigned char *) ss; *p && nodes; p++) {
+			const emoticon_node_t *node;
 
-	for (ss = s; *ss; ss++) {
-		emoticon_t *e = NULL;
-		size_t ns = xstrlen(ss);
-		int ret = 1;
+			for (node = nodes; node && node->ch != *p; node = node->next)
+				;
 
-		for (el = emoticons; el && ret; el = (ret ? el->next : el)) {
-			size_t n;
+			if (!node)
+				break;
 
-			e = el;
-			n = xstrlen(e->name);
-			if (ns >= n)
-				ret = xstrncmp(ss, e->name, n);
+			if (node->e && (!best || node->prio < best->prio)) {
+				best = node;
+				bestlen = p - (const unsigned char *) ss + 1;
+			}
+			nodes = node->child;
 		}
 
-		if (el) {
-			e = el;
-			xstrcat(ms, e->value);
-			ss += xstrlen(e->name) - 1;
+		if (best) {
+			g_string_append(ms, best->e->value);
+			ss += bestlen;
 		} else
-			ms[xstrlen(ms)] = *ss;
+			g_string_append_c(ms, *ss++);
 	}
 
-	return ms;
+	return g_string_free(ms, FALSE);
 }
 
 /*
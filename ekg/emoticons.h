@@ -30,7 +30,7 @@ extern "C" {
 
 int emoticon_read();
 char *emoticon_expand(const char *s);
-void emoticons_destroy();
+void emoticons_destroy(void);
 
 #ifdef __cplusplus
 }
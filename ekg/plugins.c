@@ -65,6 +65,108 @@ DYNSTUFF_LIST_DECLARE(queries_list, query_t, query_free_data,
 	static __DYNSTUFF_REMOVE_SAFE,
 	__DYNSTUFF_DESTROY)
 
+/*
+ * query_vector_t - handlers of one query name, in the same order as in
+ * queries[] bucket, so query_emit_id() doesn't need to search buckets.
+ */
+typedef struct {
+	char *name;
+	int name_hash;
+	GPtrArray *handlers;	/* query_t *, NULL for handlers freed during emit */
+	int dirty;		/* handlers must be rebuilt before next emit */
+	int busy;		/* number of query_emit_id() in progress */
+	GSList *stale;		/* old handlers arrays, freed when !busy */
+
+	int deferrable;		/* QUERY_DEFERRABLE */
+	int pending;		/* emissions waiting for query_deferred_flush() */
+	guint merged;		/* emissions which were merged with another one */
+} query_vector_t;
+
+static GPtrArray *query_vectors = NULL;		/* query_id_t -> query_vector_t */
+static GHashTable *query_ids = NULL;		/* name -> query_id_t + 1 */
+static ekg_idle_t query_deferred_idle = NULL;
+
+static query_vector_t *query_vector(query_id_t id) {
+	if (!query_vectors || id < 0 || id >= (query_id_t) query_vectors->len)
+		return NULL;
+
+	return g_ptr_array_index(query_vectors, id);
+}
+
+static void query_vector_rebuild(query_vector_t *v, query_id_t id) {
+	GPtrArray *handlers = g_ptr_array_new();
+	query_t *g;
+
+	for (g = queries[v->name_hash & (QUERIES_BUCKETS - 1)]; g; g = g->next) {
+		if (g->id == id)
+			g_ptr_array_add(handlers, g);
+	}
+
+	if (v->handlers) {
+		if (v->busy)
+			v->stale = g_slist_prepend(v->stale, v->handlers);
+		else
+			g_ptr_array_free(v->handlers, TRUE);
+	}
+
+	v->handlers = handlers;
+	v->dirty = 0;
+}
+
+static void query_vector_unset(GPtrArray *handlers, query_t *q) {
+	guint i;
+
+	for (i = 0; i < handlers->len; i++) {
+		if (g_ptr_array_index(handlers, i) == q)
+			handlers->pdata[i] = NULL;
+	}
+}
+
+/*
+ * query_vector_forget()
+ *
+ * must be called before @a q is removed from queries[] bucket.
+ */
+static void query_vector_forget(query_t *q) {
+	query_vector_t *v = query_vector(q->id);
+	GSList *l;
+
+	if (!v)
+		return;
+
+	if (v->handlers)
+		query_vector_unset(v->handlers, q);
+	for (l = v->stale; l; l = l->next)
+		query_vector_unset(l->data, q);
+
+	v->dirty = 1;
+}
+
+static void query_vectors_free(void) {
+	guint i;
+
+	if (!query_vectors)
+		return;
+
+	for (i = 0; i < query_vectors->len; i++) {
+		query_vector_t *v = g_ptr_array_index(query_vectors, i);
+		GSList *l;
+
+		for (l = v->stale; l; l = l->next)
+			g_ptr_array_free(l->data, TRUE);
+		g_slist_free(v->stale);
+		if (v->handlers)
+			g_ptr_array_free(v->handlers, TRUE);
+		xfree(v->name);
+		xfree(v);
+	}
+
+	g_ptr_array_free(query_vectors, TRUE);
+	g_hash_table_destroy(query_ids);
+	query_vectors = NULL;
+	query_ids = NULL;
+}
+
 void ekg2_dlinit(const gchar *argv0) {
 #ifdef SHARED_LIBS
 	if (g_module_supported()) {
@@ -518,8 +620,10 @@ int plugin_unregister(plugin_t *p)
 
 		for (g = *kk; g; ) {
 			query_t *next = g->next;
-			if (g->plugin == p)
+			if (g->plugin == p) {
+				query_vector_forget(g);
 				queries_list_remove(kk, g);
+			}
 			g = next;
 		}
 	}
@@ -540,6 +644,11 @@ int plugin_unregister(plugin_t *p)
 			commands_remove(c);
 	}
 
+	if (p->session_slots) {
+		g_array_free(p->session_slots, TRUE);
+		p->session_slots = NULL;
+	}
+
 	plugins_unlink(p);
 
 	return 0;
@@ -577,6 +686,8 @@ static LIST_FREE_ITEM(registered_query_free_data, query_def_t *) {
 }
 
 void registered_queries_free() {
+	query_vectors_free();
+
 	if (!registered_queries)
 	    return;
 
@@ -645,6 +756,14 @@ int query_register_const(const query_def_t *def) {
 	    return -1;
 	}
 	memcpy(gd->params, def->params, sizeof(def->params));
+	gd->flags = def->flags;
+
+	if ((def->flags & QUERY_DEFERRABLE)) {
+		if (def->params[0] != QUERY_ARG_END)
+			debug_error("query_register_const() %s: only queries without params can be deferred\n", def->name);
+		else
+			query_vector(query_id(def->name))->deferrable = 1;
+	}
 
 	return 0;
 }
@@ -652,6 +771,7 @@ int query_register_const(const query_def_t *def) {
 
 int query_free(query_t* g) {
 
+    query_vector_forget(g);
     queries_list_remove(&queries[g->name_hash & (QUERIES_BUCKETS - 1)], g);
 
     return 0;
@@ -668,6 +788,7 @@ query_t *query_connect(plugin_t *plugin, const char *name, query_handler_func_t
 	q->plugin	= plugin;
 	q->handler	= handler;
 	q->data		= data;
+	q->id		= query_id(name);
 
 	for (gd = registered_queries; gd; gd = gd->next) {
 		if (q->name_hash == gd->name_hash && !xstrcmp(gd->name, name)) {
@@ -688,10 +809,48 @@ query_t *query_connect(plugin_t *plugin, const char *name, query_handler_func_t
 	}
 
 	queries_list_add(&queries[q->name_hash & (QUERIES_BUCKETS - 1)], q);
+	query_vector(q->id)->dirty = 1;
 
 	return q;
 }
 
+/**
+ * query_id()
+ *
+ * Intern query name. Returned id is valid until ekg2 exits, and can be
+ * passed to query_emit_id() instead of name, e.g. from hot paths.
+ *
+ * @param name - name of query
+ *
+ * @return id of query or QUERY_ID_INVALID if @a name is NULL
+ */
+
+query_id_t query_id(const char *name) {
+	query_vector_t *v;
+	gpointer id;
+
+	if (!name)
+		return QUERY_ID_INVALID;
+
+	if (!query_ids) {
+		query_ids	= g_hash_table_new(g_str_hash, g_str_equal);
+		query_vectors	= g_ptr_array_new();
+	}
+
+	if ((id = g_hash_table_lookup(query_ids, name)))
+		return GPOINTER_TO_INT(id) - 1;
+
+	v		= xmalloc(sizeof(query_vector_t));
+	v->name		= xstrdup(name);
+	v->name_hash	= ekg_hash(name);
+	v->dirty	= 1;
+
+	g_ptr_array_add(query_vectors, v);
+	g_hash_table_insert(query_ids, v->name, GINT_TO_POINTER(query_vectors->len));
+
+	return query_vectors->len - 1;
+}
+
 static int query_emit_inner(query_t *g, va_list ap) {
 	static int nested = 0;
 	int (*handler)(void *data, va_list ap) = g->handler;
@@ -716,28 +875,204 @@ static int query_emit_inner(query_t *g, va_list ap) {
 	return result != -1 ? 0 : -1;
 }
 
-int query_emit(plugin_t *plugin, const char* name, ...) {
+/*
+ * query_time_add()
+ *
+ * adds handler time to query_t statistics.
+ */
+static void query_time_add(query_t *g, gint64 us) {
+	int bucket = 0;
+
+	if (us < 0)
+		us = 0;
+
+	g->time_total += us;
+	if (us > g->time_max)
+		g->time_max = us;
+
+	while (us && bucket < QUERY_TIME_HIST - 1) {
+		us >>= 1;
+		bucket++;
+	}
+	g->time_hist[bucket]++;
+}
+
+/**
+ * query_time_reset()
+ *
+ * Reset time statistics of all query handlers, also query_t->count
+ */
+
+void query_time_reset(void) {
+	query_t **kk, *g;
+
+	for (kk = queries; kk < &queries[QUERIES_BUCKETS]; ++kk) {
+		for (g = *kk; g; g = g->next) {
+			g->count = 0;
+			g->time_total = g->time_max = 0;
+			memset(g->time_hist, 0, sizeof(g->time_hist));
+		}
+	}
+
+	if (query_vectors) {
+		guint i;
+
+		for (i = 0; i < query_vectors->len; i++)
+			((query_vector_t *) g_ptr_array_index(query_vectors, i))->merged = 0;
+	}
+}
+
+static int query_emit_handlers(plugin_t *plugin, query_vector_t *v, query_id_t id, va_list ap) {
 	int result = -2;
+	GPtrArray *handlers;
+	guint i;
+
+	if (v->dirty)
+		query_vector_rebuild(v, id);
+
+	handlers = v->handlers;
+	v->busy++;
+
+	for (i = 0; i < handlers->len; i++) {
+		query_t *g = g_ptr_array_index(handlers, i);
+
+		if (!g || (plugin && plugin != g->plugin))
+			continue;
+
+		if (config_debug_queries) {
+			gint64 start = g_get_monotonic_time();
+
+			result = query_emit_inner(g, ap);
+
+			/* handler could have freed itself */
+			if (g_ptr_array_index(handlers, i) == g)
+				query_time_add(g, g_get_monotonic_time() - start);
+		} else
+			result = query_emit_inner(g, ap);
+
+		if (result == -1)
+			break;
+	}
+
+	if (!--v->busy && v->stale) {
+		GSList *l;
+
+		for (l = v->stale; l; l = l->next)
+			g_ptr_array_free(l->data, TRUE);
+		g_slist_free(v->stale);
+		v->stale = NULL;
+	}
+
+	return result;
+}
+
+static int query_emit_now(query_vector_t *v, query_id_t id, ...) {
+	int result;
 	va_list ap;
-	query_t* g;
-	int name_hash, bucket_id;
 
-	name_hash = ekg_hash(name);
-	bucket_id = name_hash & (QUERIES_BUCKETS - 1);
+	va_start(ap, id);
+	result = query_emit_handlers(NULL, v, id, ap);
+	va_end(ap);
 
-	va_start(ap, name);
+	return result;
+}
+
+/**
+ * query_deferred_flush()
+ *
+ * Emit all pending QUERY_DEFERRABLE queries, each one only once.
+ * Called from main loop, but can be also called directly if someone
+ * needs results of them right now.
+ */
 
-	for (g = queries[bucket_id]; g; g = g->next) {
-	    if (name_hash == g->name_hash && (!plugin || (plugin == g->plugin)) && !xstrcmp(name, g->name)) {
+void query_deferred_flush(void) {
+	guint i;
 
-		result = query_emit_inner(g, ap);
+	if (query_deferred_idle)
+		ekg_source_remove(query_deferred_idle);
 
-		if (result == -1) {
-		    break;
-		}
-	    }
+	if (!query_vectors)
+		return;
+
+	for (i = 0; i < query_vectors->len; i++) {
+		query_vector_t *v = g_ptr_array_index(query_vectors, i);
+
+		if (!v->pending)
+			continue;
+
+		v->merged += v->pending - 1;
+		v->pending = 0;
+		query_emit_now(v, i);
 	}
+}
+
+static gboolean query_deferred_handler(gpointer data) {
+	/* we're returning FALSE, glib will remove source itself */
+	query_deferred_idle = NULL;
+	query_deferred_flush();
+	return FALSE;
+}
 
+static void query_deferred_destroy(gpointer data) {
+	query_deferred_idle = NULL;
+}
+
+/**
+ * query_deferred_merged()
+ *
+ * @return how many emissions of query @a id were merged with another one.
+ */
+
+guint query_deferred_merged(query_id_t id) {
+	query_vector_t *v = query_vector(id);
+
+	return v ? v->merged : 0;
+}
+
+static int query_emit_va(plugin_t *plugin, query_id_t id, va_list ap) {
+	query_vector_t *v;
+
+	if (!(v = query_vector(id)))
+		return -2;
+
+	/* emission directed to one plugin can't be merged with others */
+	if (v->deferrable && !plugin) {
+		if (!v->pending++ && !query_deferred_idle)
+			query_deferred_idle = ekg_idle_add(NULL, "query-deferred", query_deferred_handler, NULL, query_deferred_destroy);
+		return 0;
+	}
+
+	return query_emit_handlers(plugin, v, id, ap);
+}
+
+/**
+ * query_emit_id()
+ *
+ * Like query_emit(), but takes id returned by query_id() instead of name.
+ */
+
+int query_emit_id(plugin_t *plugin, query_id_t id, ...) {
+	int result;
+	va_list ap;
+
+	va_start(ap, id);
+	result = query_emit_va(plugin, id, ap);
+	va_end(ap);
+
+	return result;
+}
+
+int query_emit(plugin_t *plugin, const char* name, ...) {
+	int result = -2;
+	va_list ap;
+	gpointer id;
+
+	/* name which was never interned has got no handlers */
+	if (!name || !query_ids || !(id = g_hash_table_lookup(query_ids, name)))
+		return result;
+
+	va_start(ap, name);
+	result = query_emit_va(plugin, GPOINTER_TO_INT(id) - 1, ap);
 	va_end(ap);
 
 	return result;
@@ -762,6 +1097,12 @@ void queries_reconnect() {
 	for (i = 0; i < QUERIES_BUCKETS; ++i) {
 		LIST_RESORT2(&(queries[i]), query_compare);
 	}
+
+	/* handlers order changed, rebuild vectors on next emit */
+	if (query_vectors) {
+		for (i = 0; i < query_vectors->len; i++)
+			((query_vector_t *) g_ptr_array_index(query_vectors, i))->dirty = 1;
+	}
 }
 
 /**
@@ -83,6 +83,8 @@ typedef struct plugin {
 	plugin_theme_init_func_t theme_init;
 
 	const void *priv;
+
+	GArray *session_slots;		/* slot -> params id+1, see session_slot() */
 } plugin_t;
 
 /* Note about plugin_t.statuses:
@@ -137,6 +139,13 @@ typedef QUERY(query_handler_func_t);
 /* must be power of 2 ;p */
 #define QUERIES_BUCKETS 64
 
+/* interned query name, see query_id() */
+typedef int query_id_t;
+#define QUERY_ID_INVALID (-1)
+
+/* number of buckets in query_t->time_hist, last one takes everything above */
+#define QUERY_TIME_HIST 24
+
 typedef struct query_node {
         struct query_node* next;
         char *name;
@@ -145,12 +154,23 @@ typedef struct query_node {
         void *data;
         query_handler_func_t *handler;
         int count;
+        query_id_t id;
+
+        /* filled only when config_debug_queries is set, in microseconds */
+        guint64 time_total;
+        guint64 time_max;
+        guint time_hist[QUERY_TIME_HIST];	/* [i] - handler calls which took < 2^i us */
 } query_t;
 
 int query_register(const char *name, ...);
 query_t *query_connect(plugin_t *plugin, const char *name, query_handler_func_t *handler, void *data);
 int query_emit(plugin_t *, const char *, ...);
+query_id_t query_id(const char *name);
+int query_emit_id(plugin_t *, query_id_t, ...);
 int query_free(query_t* g);
+void query_time_reset(void);
+void query_deferred_flush(void);
+guint query_deferred_merged(query_id_t id);
 
 void queries_reconnect();
 
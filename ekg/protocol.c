@@ -322,11 +322,14 @@ static QUERY(protocol_status)
 	int ignore_level;
 	int ignore_status, ignore_status_descr, ignore_events, ignore_notify;
 	int sess_notify;
+	static session_slot_t slot_display_notify = 0;
 
 	if (!(s = session_find(session)))
 		return 0;
-	
-	sess_notify = session_int_get(s, "display_notify");
+
+	if (!slot_display_notify)
+		slot_display_notify = session_slot("display_notify");
+	sess_notify = session_slot_int_get(s, slot_display_notify);
 	/* we are checking who user we know */
 	if (!(u = userlist_find(s, uid))) {
 		if (config_auto_user_add && xstrncmp(uid, session, xstrlen(session)) ) {
@@ -346,7 +349,7 @@ static QUERY(protocol_status)
 			return 0;
 		}
 	}
-	ignore_level = ignored_check(s, uid);
+	ignore_level = ignored_check_u(u);
 
 	ignore_status = ignore_level & IGNORE_STATUS;
 	ignore_status_descr = ignore_level & IGNORE_STATUS_DESCR;
@@ -490,10 +493,16 @@ notify_plugins:
 }
 
 int protocol_status_emit(const session_t *s, const char *uid, int status, char *descr, time_t when) {
+	static query_id_t protocol_status_id = QUERY_ID_INVALID;
 	char *session  = xstrdup(s->uid);
 	char *uid_ro   = xstrdup(uid);
 	char *descr_ro = xstrdup(descr);
-	int result     = query_emit(NULL, "protocol-status", &session, &uid_ro, &status, &descr_ro, &when);
+	int result;
+
+	if (protocol_status_id == QUERY_ID_INVALID)
+		protocol_status_id = query_id("protocol-status");
+
+	result = query_emit_id(NULL, protocol_status_id, &session, &uid_ro, &status, &descr_ro, &when);
 
 	xfree(session);
 	xfree(uid_ro);
@@ -759,7 +768,7 @@ static QUERY(protocol_message)
 	int empty_theme = 0;
 	int our_msg;
 
-	if (ignored_check(session_class, uid) & IGNORE_MSG)
+	if (ignored_check_u(userlist) & IGNORE_MSG)
 		return -1;
 
 	/* display blinking */
@@ -348,7 +348,7 @@ static const query_def_t core_query_list[] = {
 		QUERY_ARG_END } },
 
 	{ NULL, "userlist-refresh", 0, {
-		QUERY_ARG_END } },
+		QUERY_ARG_END }, QUERY_DEFERRABLE },
 
 	{ NULL, "event-offline", 0, {
 		QUERY_ARG_CHARP,		/* session uid */
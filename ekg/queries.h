@@ -31,11 +31,15 @@ enum query_arg_type {
 	QUERY_ARG_TYPES = ~QUERY_ARG_FLAGS
 };
 
+/* query_def_t->flags */
+#define QUERY_DEFERRABLE	0x01	/* emissions are merged into one, done from main loop (only for queries without params) */
+
 typedef struct query_def_node {
         struct query_def_node* next;
         char *name;
         int name_hash;
         enum query_arg_type params[QUERY_ARGS_MAX];
+        int flags;
 } query_def_t;
 
 int queries_init();
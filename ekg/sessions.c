@@ -47,6 +47,10 @@ static __DYNSTUFF_DESTROY(session_vars, session_param_t, session_param_free_item
 
 session_t *session_current = NULL;
 
+static GPtrArray *session_slot_names = NULL;	/* slot-1 -> interned variable name */
+
+static int session_int_value(const char *value) { return value ? strtol(value, NULL, 0) : -1; }
+
 /**
  * session_find_ptr()
  *
@@ -156,6 +160,7 @@ session_t *session_add(const char *uid) {
 
 		for (count=0; (pl->params[count].key /* && p->params[count].id != -1 */); count++);	/* count how many _global_ params should have this sessioni */
 		s->values		= (char **) xcalloc(count+1, sizeof(char *));			/* alloc memory for it, +1 just in case. */
+		s->int_values		= (int *) xcalloc(count+1, sizeof(int));
 		s->global_vars_count	= count;							/* save it for future, little helper... */
 
 		/* set variables */
@@ -164,6 +169,7 @@ session_t *session_add(const char *uid) {
 			const char *value = pl->params[i].value;
 
 			s->values[i] = xstrdup(value);
+			s->int_values[i] = session_int_value(value);
 
 				/* sorry, but to simplify plugin writing we've to assure handler
 				 * is never called with nonconnected session */
@@ -194,6 +200,7 @@ session_t *session_add(const char *uid) {
 static LIST_FREE_ITEM(session_free_item, session_t *) {
 /* free _global_ session variables */
 	array_free_count(data->values, data->global_vars_count);
+	xfree(data->int_values);
 
 /* free _local_ session variables */
 	session_vars_destroy(&(data->local_vars));
@@ -760,6 +767,7 @@ int session_set(session_t *s, const char *key, const char *value) {
 /*		debug("session_set() CHECK [%s, %d] value: %s\n", pa->key, paid-1, value);  */
 
 		xfree(s->values[paid-1]);	s->values[paid-1] = xstrdup(value);
+		s->int_values[paid-1] = session_int_value(value);
 		goto notify;
 	}
 
@@ -793,6 +801,111 @@ int session_int_set(session_t *s, const char *key, int value)
 	return session_set(s, key, ekg_itoa(value));
 }
 
+/**
+ * session_slot()
+ *
+ * Resolve session variable name to slot, which can be passed later to session_slot_get()
+ * and session_slot_int_get(). Slots are plugin-independent, so the same slot works
+ * for sessions of any protocol; each plugin maps it to its params[] index on first use.<br>
+ * Call it once (e.g. in plugin init) and keep the result in static variable.
+ *
+ * @param key - variable name
+ *
+ * @return slot (always > 0)
+ */
+
+session_slot_t session_slot(const char *key) {
+	guint i;
+
+	if (!session_slot_names)
+		session_slot_names = g_ptr_array_new();
+
+	for (i = 0; i < session_slot_names->len; i++) {
+		if (!xstrcasecmp(g_ptr_array_index(session_slot_names, i), key))
+			return i+1;
+	}
+
+	g_ptr_array_add(session_slot_names, g_strdup(key));
+	return session_slot_names->len;
+}
+
+/*
+ * session_slot_paid()
+ *
+ * returns params id+1 of slot variable in plugin @a pl, or 0 if it isn't
+ * plain plugin variable [builtin ones like alias, descr, password or local vars]
+ */
+static int session_slot_paid(plugin_t *pl, session_slot_t slot) {
+	const char *key;
+	int paid;
+
+	if (!pl || slot < 1 || !session_slot_names || slot > (int) session_slot_names->len)
+		return 0;
+
+	if (!pl->session_slots)
+		pl->session_slots = g_array_new(FALSE, TRUE, sizeof(int));
+	if (pl->session_slots->len < (guint) slot)
+		g_array_set_size(pl->session_slots, slot);
+
+	if ((paid = g_array_index(pl->session_slots, int, slot-1)))
+		return (paid > 0) ? paid : 0;
+
+	key = g_ptr_array_index(session_slot_names, slot-1);
+
+	/* the same names as session_get() handles before plugin variables */
+	if (!xstrcasecmp(key, "uid") || !xstrcasecmp(key, "alias") || !xstrcasecmp(key, "descr") ||
+		!xstrcasecmp(key, "status") || !xstrcasecmp(key, "statusdescr") || !xstrcasecmp(key, "password"))
+		paid = -1;
+	else if (!(paid = plugin_var_find(pl, key)))
+		paid = -1;
+
+	g_array_index(pl->session_slots, int, slot-1) = paid;
+	return (paid > 0) ? paid : 0;
+}
+
+/**
+ * session_slot_get()
+ *
+ * Like session_get(), but takes slot from session_slot() instead of name.
+ */
+
+const char *session_slot_get(session_t *s, session_slot_t slot) {
+	int paid;
+
+	if (!s)
+		return NULL;
+
+	if ((paid = session_slot_paid(s->plugin, slot)))
+		return s->values[paid-1];
+
+	if (slot < 1 || !session_slot_names || slot > (int) session_slot_names->len)
+		return NULL;
+
+	return session_get(s, g_ptr_array_index(session_slot_names, slot-1));
+}
+
+/**
+ * session_slot_int_get()
+ *
+ * Like session_int_get(), but takes slot from session_slot() instead of name.<br>
+ * For plugin variables value is parsed only when session_set() changes it.
+ */
+
+int session_slot_int_get(session_t *s, session_slot_t slot) {
+	int paid;
+
+	if (!s)
+		return -1;
+
+	if ((paid = session_slot_paid(s->plugin, slot)))
+		return s->int_values[paid-1];
+
+	if (slot < 1 || !session_slot_names || slot > (int) session_slot_names->len)
+		return -1;
+
+	return session_int_get(s, g_ptr_array_index(session_slot_names, slot-1));
+}
+
 /*
  * session_read()
  *
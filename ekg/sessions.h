@@ -148,6 +148,7 @@ typedef struct ekg_session {
 
 	int		global_vars_count;
 	char		**values;
+	int		*int_values;		/**< values[] parsed by strtol(), -1 if unset */
 	session_param_t	*local_vars;
 	
 /* new auto-away */
@@ -195,6 +196,13 @@ int session_int_get(session_t *s, const char *key);
 int session_set(session_t *s, const char *key, const char *value);
 int session_int_set(session_t *s, const char *key, int value);
 
+/* slot is resolved once by name and then reads s->values[] without lookups */
+typedef int session_slot_t;
+
+session_slot_t session_slot(const char *key);
+const char *session_slot_get(session_t *s, session_slot_t slot);
+int session_slot_int_get(session_t *s, session_slot_t slot);
+
 const char *session_format(session_t *s);
 #define session_format_n(a) session_format(session_find(a))
 
@@ -25,6 +25,10 @@
 /* watch stuff, XXX YYY */
 #include <unistd.h>
 #include <errno.h>
+#include <limits.h>
+#ifndef NO_POSIX_SYSTEM
+#include <sys/uio.h>
+#endif
 
 /* WEXITSTATUS for FreeBSD */
 #include <sys/wait.h>
@@ -34,6 +38,7 @@
  */
 
 static GSList *children = NULL;
+static GSList *idles = NULL;
 static GSList *timers = NULL;
 
 struct ekg_source {
@@ -45,6 +50,7 @@ struct ekg_source {
 	union {
 		GChildWatchFunc as_child;
 		GSourceFunc as_timer;
+		GSourceFunc as_idle;
 		int (*as_old_timer)(int, void*);
 		gpointer as_void;
 	} handler;
@@ -160,6 +166,8 @@ gboolean ekg_source_remove_by_handler(gpointer handler, const gchar *name) {
 	g_slist_foreach(timers, source_remove_by_h, &args);
 	if (G_UNLIKELY(!ret))
 		g_slist_foreach(children, source_remove_by_h, &args);
+	if (G_UNLIKELY(!ret))
+		g_slist_foreach(idles, source_remove_by_h, &args);
 	return ret;
 }
 
@@ -196,6 +204,7 @@ gboolean ekg_source_remove_by_data(gpointer priv_data, const gchar *name) {
 	struct source_remove_data args = { priv_data, name, &ret };
 
 	g_slist_foreach(children, source_remove_by_d, &args);
+	g_slist_foreach(idles, source_remove_by_d, &args);
 	g_slist_foreach(timers, source_remove_by_d, &args);
 	return ret;
 }
@@ -229,6 +238,7 @@ gboolean ekg_source_remove_by_plugin(plugin_t *plugin, const gchar *name) {
 	struct source_remove_data args = { plugin, name, &ret };
 
 	g_slist_foreach(children, source_remove_by_p, &args);
+	g_slist_foreach(idles, source_remove_by_p, &args);
 	g_slist_foreach(timers, source_remove_by_p, &args);
 	return ret;
 }
@@ -240,6 +250,7 @@ static void source_remove(gpointer data, gpointer user_data) {
 
 void sources_destroy(void) {
 	g_slist_foreach(children, source_remove, NULL);
+	g_slist_foreach(idles, source_remove, NULL);
 	g_slist_foreach(timers, source_remove, NULL);
 }
 
@@ -313,6 +324,63 @@ ekg_child_t ekg_child_add(plugin_t *plugin, const gchar *name_format, GPid pid,
 	return c;
 }
 
+/*
+ * Idle handlers
+ */
+
+static void idle_destroy_notify(gpointer data) {
+	struct ekg_source *i = data;
+	idles = g_slist_remove(idles, data);
+
+	if (G_UNLIKELY(i->destr))
+		i->destr(i->priv_data);
+
+	source_free(i);
+}
+
+static gboolean idle_wrapper(gpointer data) {
+	struct ekg_source *i = data;
+
+	return i->handler.as_idle(i->priv_data);
+}
+
+/**
+ * ekg_idle_add()
+ *
+ * Add a handler called once the main loop has dispatched the events
+ * which are pending now. Useful to merge many requests (e.g. redraws)
+ * made while handling a single burst of data into one call.
+ *
+ * @param plugin - plugin which contains handler funcs or NULL if in core.
+ * @param name_format - format string for handler name. Can be NULL, or
+ *	simple string if the name is guaranteed not to contain '%'.
+ * @param handler - the handler func. It will be passed the private
+ *	data, and should return TRUE if it wants to be called again
+ *	in the next loop iteration, FALSE otherwise.
+ * @param data - the private data passed to the handler.
+ * @param destr - destructor for the private data. It will be called
+ *	even if the handler is not. Can be NULL.
+ * @param ... - arguments to name_format format string.
+ *
+ * @return An unique ekg_idle_t.
+ */
+ekg_idle_t ekg_idle_add(plugin_t *plugin, const gchar *name_format, GSourceFunc handler, gpointer data, GDestroyNotify destr, ...) {
+	va_list args;
+	struct ekg_source *i;
+
+	va_start(args, destr);
+	i = source_new(plugin, name_format, data, destr, args);
+	va_end(args);
+
+	g_assert(handler);
+	i->handler.as_idle = handler;
+	idles = g_slist_prepend(idles, i);
+	/* G_PRIORITY_DEFAULT, not G_PRIORITY_DEFAULT_IDLE, so it isn't starved by busy watches */
+	source_set_id(i, g_idle_add_full(G_PRIORITY_DEFAULT, idle_wrapper, i, idle_destroy_notify));
+
+	return i;
+}
+
 /*
  * Timers
  */
@@ -1198,7 +1266,177 @@ watch_t *watch_find(plugin_t *plugin, int fd, watch_type_t type) {
 	return NULL;
 }
 
+/*
+ * Output queue of WATCH_WRITE_LINE watches.
+ *
+ * Data is kept in NUL-terminated chunks, written from w->wqueue head (starting at
+ * w->whead_off) by one writev() of up to WATCH_IOV_MAX chunks. Small writes are
+ * appended to the tail chunk while it has got room and nobody else holds it.
+ * Chunks are refcounted, so one watch_chunk_new() can be queued on many watches.
+ */
+
+#define WATCH_CHUNK_SIZE 4096	/* capacity of pooled chunks */
+#define WATCH_CHUNK_POOL 32	/* max number of free chunks kept in pool */
+
+#ifdef IOV_MAX
+#define WATCH_IOV_MAX IOV_MAX
+#else
+#define WATCH_IOV_MAX 16
+#endif
+
+struct watch_chunk {
+	gint ref;
+	gsize len;		/* bytes used */
+	gsize size;		/* bytes allocated for data, without NUL */
+	char data[1];
+};
+
+static watch_chunk_t *watch_chunk_pool[WATCH_CHUNK_POOL];
+static int watch_chunk_pooled = 0;
+
+static watch_chunk_t *watch_chunk_alloc(gsize size) {
+	watch_chunk_t *c;
+
+	if (size <= WATCH_CHUNK_SIZE && watch_chunk_pooled)
+		c = watch_chunk_pool[--watch_chunk_pooled];
+	else {
+		if (size < WATCH_CHUNK_SIZE)
+			size = WATCH_CHUNK_SIZE;
+		c = g_malloc(sizeof(watch_chunk_t) + size);
+		c->size = size;
+	}
+
+	c->ref = 1;
+	c->len = 0;
+	c->data[0] = '\0';
+	return c;
+}
+
+/**
+ * watch_chunk_new()
+ *
+ * Create chunk with copy of @a len bytes of @a buf, ready to be queued by watch_write_chunk().
+ * Caller holds one reference, release it with watch_chunk_unref().
+ */
+
+watch_chunk_t *watch_chunk_new(const char *buf, gsize len) {
+	watch_chunk_t *c = watch_chunk_alloc(len);
+
+	memcpy(c->data, buf, len);
+	c->data[len] = '\0';
+	c->len = len;
+	return c;
+}
+
+watch_chunk_t *watch_chunk_ref(watch_chunk_t *c) {
+	g_atomic_int_inc(&c->ref);
+	return c;
+}
+
+void watch_chunk_unref(watch_chunk_t *c) {
+	if (!c || !g_atomic_int_dec_and_test(&c->ref))
+		return;
+
+	if (c->size == WATCH_CHUNK_SIZE && watch_chunk_pooled < WATCH_CHUNK_POOL)
+		watch_chunk_pool[watch_chunk_pooled++] = c;
+	else
+		g_free(c);
+}
+
+gsize watch_chunk_len(watch_chunk_t *c) {
+	return c->len;
+}
+
+static void watch_chunk_unref_cb(gpointer data, gpointer user_data) {
+	watch_chunk_unref(data);
+}
+
+/* remove @a len written bytes from front of output queue */
+static void watch_queue_consume(watch_t *w, gsize len) {
+	w->wqueued -= len;
+
+	while (len) {
+		watch_chunk_t *c = g_queue_peek_head(w->wqueue);
+		gsize left = c->len - w->whead_off;
+
+		if (len < left) {
+			w->whead_off += len;
+			break;
+		}
+
+		len -= left;
+		w->whead_off = 0;
+		watch_chunk_unref(g_queue_pop_head(w->wqueue));
+	}
+
+	if (w->wthrottled && w->wqueued <= w->wlow)
+		w->wthrottled = 0;
+}
+
+static void watch_queue_append(watch_t *w, const char *buf, gsize len) {
+	watch_chunk_t *c = g_queue_peek_tail(w->wqueue);
+
+	w->wqueued += len;
+
+	if (c && c->ref == 1 && c->size - c->len >= len) {
+		memcpy(c->data + c->len, buf, len);
+		c->len += len;
+		c->data[c->len] = '\0';
+		return;
+	}
+
+	g_queue_push_tail(w->wqueue, watch_chunk_new(buf, len));
+}
+
+/**
+ * watch_queued()
+ *
+ * @return Number of bytes waiting in output queue of WATCH_WRITE_LINE watch @a w.
+ */
+
+gsize watch_queued(watch_t *w) {
+	return (w && w->wqueue) ? w->wqueued : 0;
+}
+
+/**
+ * watch_set_watermarks()
+ *
+ * Set output queue watermarks of WATCH_WRITE_LINE watch @a w. When more than @a high
+ * bytes are queued, watch_writable() returns 0 until queue drains to @a low bytes.
+ * @a high equal 0 (default) means no limit.
+ */
+
+void watch_set_watermarks(watch_t *w, gsize low, gsize high) {
+	if (!w || !w->wqueue)
+		return;
+
+	w->wlow		= MIN(low, high);
+	w->whigh	= high;
+	w->wthrottled	= (high && w->wqueued > high);
+}
+
+/**
+ * watch_writable()
+ *
+ * Producers writing much data to @a w (file transfers, remote clients, etc.) should
+ * check it, and hold off (e.g. until next watch handler call) while it returns 0.
+ *
+ * @return 1 if queue of @a w is below its watermarks, 0 if it's full, -1 if it isn't WATCH_WRITE_LINE watch.
+ */
+
+int watch_writable(watch_t *w) {
+	if (!w || !w->wqueue)
+		return -1;
+
+	return !w->wthrottled;
+}
+
 static LIST_FREE_ITEM(watch_free_data, watch_t *) {
+	if (data->wqueue) {
+		g_queue_foreach(data->wqueue, watch_chunk_unref_cb, NULL);
+		g_queue_free(data->wqueue);
+	}
+
 	if (data->buf) {
 		int (*handler)(int, int, const char *, void *) = data->handler;
 		string_free(data->buf, 1);
@@ -1214,59 +1452,77 @@ static LIST_FREE_ITEM(watch_free_data, watch_t *) {
 	g_io_channel_unref(data->f);
 }
 
+#define WATCH_LINE_READ 8192	/* bytes read at once by watch_handle_line() */
+
 /*
  * watch_handle_line()
  *
  * obsługa deskryptorów przegl±danych WATCH_READ_LINE.
+ *
+ * lines aren't copied, nor removed from front of w->buf: handler gets pointer
+ * into w->buf (with '\n' replaced by NUL), valid only until it returns, and
+ * w->line_start is moved after it. Rest of buffer is moved to the beginning
+ * only when handled lines take at least half of it.
  */
 static int watch_handle_line(watch_t *w)
 {
-	char buf[1024], *tmp;
 	int ret, res = 0;
 	int (*handler)(int, int, const char *, void *) = w->handler;
+	string_t buf;
+	gsize len;
+	char *nl;
 
 	g_assert(w);
+	buf = w->buf;
+
+	if (w->line_start && w->line_start * 2 >= buf->len) {
+		memmove(buf->str, buf->str + w->line_start, buf->len - w->line_start);
+		g_string_truncate(buf, buf->len - w->line_start);
+		w->line_scan -= w->line_start;
+		w->line_start = 0;
+	}
+
+	/* make room for data, real length is set after read() */
+	len = buf->len;
+	g_string_set_size(buf, len + WATCH_LINE_READ);
 
 #ifndef NO_POSIX_SYSTEM
-	ret = read(w->fd, buf, sizeof(buf) - 1);
+	ret = read(w->fd, buf->str + len, WATCH_LINE_READ);
 #else
-	ret = recv(w->fd, buf, sizeof(buf) - 1, 0);
+	ret = recv(w->fd, buf->str + len, WATCH_LINE_READ, 0);
 	if (ret == -1 && WSAGetLastError() == WSAENOTSOCK) {
 		printf("recv() failed Error: %d, using ReadFile()", WSAGetLastError());
-		res = ReadFile(w->fd, &buf, sizeof(buf)-1, &ret, NULL);
+		res = ReadFile(w->fd, buf->str + len, WATCH_LINE_READ, &ret, NULL);
 		printf(" res=%d ret=%d\n", res, ret);
 	}
 	res = 0;
 #endif
 
-	if (ret > 0) {
-		buf[ret] = 0;
-		string_append(w->buf, buf);
-#ifdef NO_POSIX_SYSTEM
-		printf("RECV: %s\n", buf);
-#endif
-	}
+	g_string_truncate(buf, len + (ret > 0 ? ret : 0));
 
 	if (ret == 0 || (ret == -1 && errno != EAGAIN))
-		string_append_c(w->buf, '\n');
+		g_string_append_c(buf, '\n');
 
-	while ((tmp = xstrchr(w->buf->str, '\n'))) {
-		size_t strlen = tmp - w->buf->str;		/* get len of str from begining to \n char */
-		char *line = xstrndup(w->buf->str, strlen);	/* strndup() str with len == strlen */
+	/* search only data which wasn't searched before */
+	while ((nl = memchr(buf->str + w->line_scan, '\n', buf->len - w->line_scan))) {
+		char *line = buf->str + w->line_start;
+		gsize linelen = nl - line;
 
-		/* we strndup() str with len == strlen, so we don't need to call xstrlen() */
-		if (strlen > 1 && line[strlen - 1] == '\r')
-			line[strlen - 1] = 0;
+		*nl = 0;
+		if (linelen > 1 && line[linelen - 1] == '\r')
+			line[linelen - 1] = 0;
 
-		if ((res = handler(0, w->fd, line, w->data)) == -1) {
-			xfree(line);
-			break;
-		}
+		w->line_start = w->line_scan = (nl - buf->str) + 1;
 
-		string_remove(w->buf, strlen + 1);
+		if ((res = handler(0, w->fd, line, w->data)) == -1)
+			break;
+	}
 
-		xfree(line);
+	if (w->line_start == buf->len) {
+		g_string_truncate(buf, 0);
+		w->line_start = 0;
 	}
+	w->line_scan = buf->len;
 
 	/* je¶li koniec strumienia, lub nie jest to ci±głe przegl±danie,
 	 * zwolnij pamięć i usuń z listy */
@@ -1281,23 +1537,42 @@ static gboolean watch_old_wrapper(GIOChannel *f, GIOCondition cond, gpointer dat
 /* ripped from irc plugin */
 static int watch_handle_write(watch_t *w) {
 	int (*handler)(int, int, const char *, void *) = w->handler;
-	int res = -1;
-	int len = (w && w->buf) ? w->buf->len : 0;
+	watch_chunk_t *c;
+	gssize res = -1;
+	gsize len;
 
 	g_assert(w);
 #ifdef FIXME_WATCHES_TRANSFER_LIMITS
 	if (w->transfer_limit == -1) return 0;	/* transfer limit turned on, don't send anythink... XXX */
 #endif
-	g_assert(len);
-	debug_io("[watch_handle_write] fd: %d in queue: %d bytes.... ", w->fd, len);
+	g_assert(w->wqueued);
+	debug_io("[watch_handle_write] fd: %d in queue: %" G_GSIZE_FORMAT " bytes.... ", w->fd, w->wqueued);
+
+	c = g_queue_peek_head(w->wqueue);
+	len = c->len - w->whead_off;
 
 	if (handler) {
-		res = handler(0, w->fd, w->buf->str, w->data);
+		/* handlers (SSL, compression) get one chunk at time, as NUL-terminated string */
+		res = handler(0, w->fd, c->data + w->whead_off, w->data);
 	} else {
 #ifdef NO_POSIX_SYSTEM
-		res = send(w->fd, w->buf->str, len, 0 /* MSG_NOSIGNAL */);
+		res = send(w->fd, c->data + w->whead_off, len, 0 /* MSG_NOSIGNAL */);
 #else
-		res = write(w->fd, w->buf->str, len);
+		struct iovec iov[WATCH_IOV_MAX];
+		GList *l = w->wqueue->head;
+		int n = 1;
+
+		iov[0].iov_base = c->data + w->whead_off;
+		iov[0].iov_len	= len;
+
+		for (l = l->next; l && n < WATCH_IOV_MAX; l = l->next, n++) {
+			c = l->data;
+			iov[n].iov_base = c->data;
+			iov[n].iov_len	= c->len;
+			len += c->len;
+		}
+
+		res = writev(w->fd, iov, n);
 #endif
 	}
 
@@ -1318,7 +1593,7 @@ static int watch_handle_write(watch_t *w) {
 		return -1;
 	}
 	
-	if (res > len) {
+	if (res > (gssize) len) {
 		/* use debug_fatal() */
 		/* debug_fatal() should do:
 		 *	- print this info to all open windows with RED color
@@ -1329,45 +1604,79 @@ static int watch_handle_write(watch_t *w) {
 		 * XXX, implement and use it. It should be used as ASSERT()
 		 */
 		
-		debug_error("watch_write(): handler returned bad value, 0x%x vs 0x%x\n", res, len);
+		debug_error("watch_write(): handler returned bad value, 0x%x vs 0x%x\n", (int) res, (int) len);
 		res = len;
 	} else if (res < 0) {
 		debug_error("watch_write(): handler returned negative value other than -1.. XXX\n");
 		res = 0;
 	}
 
-	string_remove(w->buf, res);
-	debug_io("left: %d bytes\n", w->buf->len);
+	watch_queue_consume(w, res);
+	debug_io("left: %" G_GSIZE_FORMAT " bytes\n", w->wqueued);
 
-	if (!w->buf->len) {
+	if (!w->wqueued && w->id != -1) {
 		/* all written, remove the watch */
 		g_source_remove(w->id);
 		w->id = -1;
 	}
 
-	return res;
+	return (int) res;
+}
+
+/* queue was empty before, try to write and readd the watch if needed */
+static void watch_write_start(watch_t *w) {
+	/* but maybe we could write it all right now? */
+	watch_handle_write(w);
+	/* ...or maybe not */
+	if (w->wqueued)
+		w->id = g_io_add_watch_full(w->f, G_PRIORITY_DEFAULT,
+			G_IO_OUT | G_IO_ERR | G_IO_HUP | G_IO_NVAL,
+			watch_old_wrapper, w, NULL);
+		/* XXX: we can't clearly destroy it ;f */
 }
 
 int watch_write_data(watch_t *w, const char *buf, int len) {		/* XXX, refactory: watch_write() */
 	int was_empty;
 
-	if (!w || !buf || len <= 0)
+	if (!w || !w->wqueue || !buf || len <= 0)
 		return -1;
 
-	was_empty = !w->buf->len;
-	string_append_raw(w->buf, buf, len);
+	was_empty = !w->wqueued;
+	watch_queue_append(w, buf, len);
+
+	if (w->whigh && w->wqueued > w->whigh)
+		w->wthrottled = 1;
 
 	/* if it was empty, we need to readd the watch */
-	if (was_empty) {
-		/* but maybe we could write it all right now? */
-		watch_handle_write(w);
-		/* ...or maybe not */
-		if (w->buf->len)
-			w->id = g_io_add_watch_full(w->f, G_PRIORITY_DEFAULT,
-				G_IO_OUT | G_IO_ERR | G_IO_HUP | G_IO_NVAL,
-				watch_old_wrapper, w, NULL);
-			/* XXX: we can't clearly destroy it ;f */
-	}
+	if (was_empty)
+		watch_write_start(w);
+	return 0;
+}
+
+/**
+ * watch_write_chunk()
+ *
+ * Queue chunk @a c on WATCH_WRITE_LINE watch @a w, without copying it. Watch takes its own reference.
+ */
+
+int watch_write_chunk(watch_t *w, watch_chunk_t *c) {
+	int was_empty;
+
+	if (!w || !w->wqueue || !c)
+		return -1;
+
+	if (!c->len)
+		return 0;
+
+	was_empty = !w->wqueued;
+	g_queue_push_tail(w->wqueue, watch_chunk_ref(c));
+	w->wqueued += c->len;
+
+	if (w->whigh && w->wqueued > w->whigh)
+		w->wthrottled = 1;
+
+	if (was_empty)
+		watch_write_start(w);
 	return 0;
 }
 
@@ -1444,16 +1753,22 @@ static gboolean watch_old_wrapper(GIOChannel *f, GIOCondition cond, gpointer dat
 			ret = watch_handle_write(w);
 
 		if (ret == -1)
-			return FALSE;
+			goto remove;
 	}
 
 	if (cond & (G_IO_ERR | G_IO_NVAL | G_IO_HUP)) {
 		debug("watch_old_wrapper(): fd no longer valid, fd=%d, type=%d, plugin=%s\n",
 				w->fd, w->type, (w->plugin) ? w->plugin->name : ("none"));
-		return FALSE;
+		goto remove;
 	}
 
 	return TRUE;
+
+remove:
+	/* source added by watch_write_start() has got no destroy notify, watch stays till watch_free() */
+	if (w->wqueue)
+		w->id = -1;
+	return FALSE;
 }
 
 static void watch_old_destroy_notify(gpointer data) {
@@ -1483,6 +1798,12 @@ void watch_free(watch_t *w) {
 	if (!w)
 		return;
 
+	if (w->wqueue && w->id != -1) {
+		/* output is being written, see watch_write_start() */
+		g_source_remove(w->id);
+		w->id = -1;
+	}
+
 	if (w->id != -1)
 		g_source_remove(w->id);
 	/* stupid line watchers with their stupid manual removal */
@@ -1518,7 +1839,8 @@ watch_t *watch_add(plugin_t *plugin, int fd, watch_type_t type, watcher_handler_
 		w->buf = string_init(NULL);
 	} else if (w->type == WATCH_WRITE_LINE) {
 		w->type = WATCH_WRITE;
-		w->buf = string_init(NULL);
+		w->buf = string_init(NULL);	/* unused, but plugins check it to know if it's line watch */
+		w->wqueue = g_queue_new();
 	}
 	
 	w->started = time(NULL);
@@ -35,6 +35,11 @@ typedef ekg_source_t ekg_child_t;
 
 ekg_child_t ekg_child_add(plugin_t *plugin, const gchar *name_format, GPid pid, GChildWatchFunc handler, gpointer data, GDestroyNotify destr, ...) G_GNUC_PRINTF(2, 7) G_GNUC_MALLOC;
 
+/* Idle handlers */
+typedef ekg_source_t ekg_idle_t;
+
+ekg_idle_t ekg_idle_add(plugin_t *plugin, const gchar *name_format, GSourceFunc handler, gpointer data, GDestroyNotify destr, ...) G_GNUC_PRINTF(2, 6) G_GNUC_MALLOC;
+
 /* Timers */
 typedef ekg_source_t ekg_timer_t;
 
@@ -75,6 +80,8 @@ typedef WATCHER(watcher_handler_func_t);
 /* typedef WATCHER_LINE(watcher_handler_line_func_t); */
 typedef WATCHER_SESSION(watcher_session_handler_func_t);
 
+typedef struct watch_chunk watch_chunk_t;
+
 typedef struct watch {
 	int fd;			/* obserwowany deskryptor */
 	watch_type_t type;	/* co sprawdzamy */
@@ -82,6 +89,13 @@ typedef struct watch {
 	void *handler;		/* funkcja wywoływana je¶li s± dane itp. */
 	void *data;		/* dane przekazywane powyższym funkcjom. */
 	string_t buf;		/* bufor na linię */
+	gsize line_start;	/* WATCH_READ_LINE: offset of first line not passed to handler yet */
+	gsize line_scan;	/* WATCH_READ_LINE: buf before this offset has got no '\n' after line_start */
+	GQueue *wqueue;		/* WATCH_WRITE_LINE: watch_chunk_t waiting to be written */
+	gsize whead_off;	/* WATCH_WRITE_LINE: bytes of first chunk already written */
+	gsize wqueued;		/* WATCH_WRITE_LINE: bytes in wqueue, see watch_queued() */
+	gsize wlow, whigh;	/* WATCH_WRITE_LINE: watermarks, see watch_set_watermarks() */
+	int wthrottled;		/* WATCH_WRITE_LINE: wqueued went above whigh, and not yet below wlow */
 	time_t timeout;		/* timeout */
 	time_t started;		/* kiedy zaczęto obserwować */
 
@@ -107,6 +121,16 @@ int watch_write(watch_t *w, const char *format, ...) __attribute__ ((format (pri
 int watch_write(watch_t *w, const char *format, ...);
 #endif
 int watch_write_data(watch_t *w, const char *buf, int len);
+int watch_write_chunk(watch_t *w, watch_chunk_t *c);
+
+watch_chunk_t *watch_chunk_new(const char *buf, gsize len);
+watch_chunk_t *watch_chunk_ref(watch_chunk_t *c);
+void watch_chunk_unref(watch_chunk_t *c);
+gsize watch_chunk_len(watch_chunk_t *c);
+
+gsize watch_queued(watch_t *w);
+void watch_set_watermarks(watch_t *w, gsize low, gsize high);
+int watch_writable(watch_t *w);
 
 watch_t *watch_find(plugin_t *plugin, int fd, watch_type_t type);
 void watch_free(watch_t *w);
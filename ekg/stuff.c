@@ -65,7 +65,6 @@ list_t autofinds = NULL;
 struct conference *conferences = NULL;
 newconference_t *newconferences = NULL;
 
-struct buffer_info buffer_debug = { NULL, 0, DEBUG_MAX_LINES };		/**< debug buffer */
 struct buffer_info buffer_speech = { NULL, 0, 50 };		/**< speech buffer */
 
 int old_stderr;
@@ -130,6 +129,7 @@ int config_windows_save = 0;
 char *config_windows_layout = NULL;
 char *config_profile = NULL;
 int config_debug = 1;
+int config_debug_queries = 0;
 int config_version = 0;
 char *config_exit_exec = NULL;
 int config_session_locks = 0;
@@ -2443,7 +2443,7 @@ int ekg_write(int fd, const char *buf, int len) {
 
 	if (wl) {
 		if (!buf && len == -1) /* smells stupid, but do it */
-			return wl->buf->len;
+			return watch_queued(wl);
 	} else {
 		/* if we have no watch, let's create it. */	/* XXX, first try write() ? */
 		wl = watch_add(NULL, fd, WATCH_WRITE_LINE, NULL, NULL);
@@ -53,8 +53,6 @@
 extern "C" {
 #endif
 
-#define DEBUG_MAX_LINES	50	/* ile linii z debug zrzuca do pliku */
-
 /* obsuga procesw potomnych */
 
 #ifndef EKG2_WIN32_NOFUNCTION
@@ -115,7 +113,6 @@ extern alias_t *aliases;
 extern list_t autofinds; /* char* data */
 extern struct conference *conferences;
 extern newconference_t *newconferences;
-extern struct buffer_info buffer_debug;
 extern struct buffer_info buffer_speech;
 
 extern char *config_profile;
@@ -140,6 +137,7 @@ extern int config_beep_notify;
 extern int config_completion_notify;
 extern char *config_completion_char;
 extern int config_debug;
+extern int config_debug_queries;
 extern int config_default_status_window;
 extern int config_display_ack;
 extern int config_display_blinking;
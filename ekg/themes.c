@@ -34,17 +34,58 @@ static const char *timestamp_cache = NULL;
 
 static int no_prompt_cache = 0;
 static int no_prompt_cache_hash = 0x139dcbd6;	/* hash value of "no_prompt_cache" */
+static int format_dont_resolve = 0;
+
+typedef enum {
+	FORMAT_OP_TEXT = 0,	/* literal text */
+	FORMAT_OP_ESCAPE,	/* %X - colour, prompt, timestamp... */
+	FORMAT_OP_ARG,		/* %N, %[..]N, %(..)N */
+	FORMAT_OP_GENDER,	/* %@N */
+	FORMAT_OP_COND		/* %{N...}X */
+} format_op_type_t;
+
+struct format_op {
+	format_op_type_t type;
+	int arg;			/* index in args[] or -1 */
+	char ch;			/* FORMAT_OP_ESCAPE */
+	char *text;			/* FORMAT_OP_TEXT, FORMAT_OP_COND: letters */
+	char *results;			/* FORMAT_OP_COND: formatees for letters */
+
+	int fill_length;		/* FORMAT_OP_ARG */
+	char fill_char;
+	unsigned int fill_before : 1;
+	unsigned int fill_after	 : 1;
+	unsigned int fill_soft	 : 1;
+	unsigned int center	 : 1;
+};
+
+struct format_compiled {
+	int argc;			/* number of arguments taken */
+	int count;
+	struct format_op *ops;
+};
 
 struct format {
 	struct format *next;
 	char *name;
 	int name_hash;
 	char *value;
+	struct format_compiled *compiled;	/* compiled value, made by va_format_string() when needed */
 };
 
 static struct format* formats[0x100];
 
+static GHashTable *formats_by_value = NULL;	/* f->value -> f, to find compiled formats */
+static GHashTable *format_find_cache = NULL;	/* name -> f, resolved by format_find(), only found ones */
+static char *format_find_cache_theme = NULL;	/* config_theme, for which format_find_cache is valid */
+static int format_find_cache_speech = 0;	/* !!config_speech_app, j.w. */
+
+static void format_compiled_free(struct format_compiled *fc);
+
 static LIST_FREE_ITEM(list_format_free, struct format *) {
+	if (formats_by_value)
+		g_hash_table_remove(formats_by_value, data->value);
+	format_compiled_free(data->compiled);
 	xfree(data->value);
 	xfree(data->name);
 }
@@ -72,52 +113,97 @@ static int gim_hash(const char *name) {
 #undef ROL
 }
 
+static struct format *format_lookup(const char *name) {
+	struct format *fl;
+	int hash = gim_hash(name);
+
+	for (fl = formats[hash & 0xff]; fl; fl = fl->next) {
+		struct format *f = fl;
+
+		if (hash == f->name_hash && !xstrcmp(f->name, name))
+			return f;
+	}
+	return NULL;
+}
+
 /*
- * format_find()
+ * format_resolve()
  *
- * odnajduje warto danego formatu. jeli nie znajdzie, zwraca pusty cig,
- * eby nie musie uwaa na adne null-references.
- *
- *  - name.
+ * odnajduje format o danej nazwie, uwzgldniajc config_speech_app
+ * i wariant motywu z config_theme.
  */
-const char *format_find(const char *name)
-{
-	struct format *fl;
+static struct format *format_resolve(const char *name) {
+	struct format *f;
 	const char *tmp;
-	int hash;
-
-	if (!name)
-		return "";
 
 	if (config_speech_app && !xstrchr(name, ',')) {
 		char *name2	= saprintf("%s,speech", name);
-		const char *tmp = format_find(name2);
 
+		f = format_resolve(name2);
 		xfree(name2);
 
-		if (format_ok(tmp))
-			return tmp;
+		if (f && format_ok(f->value))
+			return f;
 	}
 
 	if (config_theme && (tmp = xstrchr(config_theme, ',')) && !xstrchr(name, ',')) {
 		char *name2	= saprintf("%s,%s", name, tmp + 1);
-		const char *tmp = format_find(name2);
 
+		f = format_resolve(name2);
 		xfree(name2);
 
-		if (format_ok(tmp))
-			return tmp;
+		if (f && format_ok(f->value))
+			return f;
 	}
 
-	hash = gim_hash(name);
+	return format_lookup(name);
+}
 
-	for (fl = formats[hash & 0xff]; fl; fl = fl->next) {
-		struct format *f = fl;
+/*
+ * format_find_cache_reset()
+ *
+ * czyci pami podrczn format_find(), trzeba woa przy kadej
+ * zmianie listy formatw.
+ */
+static void format_find_cache_reset(void) {
+	if (format_find_cache)
+		g_hash_table_remove_all(format_find_cache);
+}
 
-		if (hash == f->name_hash && !xstrcmp(f->name, name))
-			return f->value;
+/*
+ * format_find()
+ *
+ * odnajduje warto danego formatu. jeli nie znajdzie, zwraca pusty cig,
+ * eby nie musie uwaa na adne null-references.
+ *
+ *  - name.
+ */
+const char *format_find(const char *name)
+{
+	struct format *f;
+	gpointer value;
+
+	if (!name)
+		return "";
+
+	if (!format_find_cache)
+		format_find_cache = g_hash_table_new_full(g_str_hash, g_str_equal, xfree, NULL);
+
+	if (format_find_cache_speech != !!config_speech_app || xstrcmp(format_find_cache_theme, config_theme)) {
+		format_find_cache_reset();
+		xfree(format_find_cache_theme);
+		format_find_cache_theme = xstrdup(config_theme);
+		format_find_cache_speech = !!config_speech_app;
 	}
-	return "";
+
+	/* misses aren't cached, name can come from network (irc numerics),
+	 * and we don't want cache to grow without bound */
+	if ((value = g_hash_table_lookup(format_find_cache, name)))
+		f = value;
+	else if ((f = format_resolve(name)))
+		g_hash_table_insert(format_find_cache, xstrdup(name), f);
+
+	return f ? f->value : "";
 }
 
 /*
@@ -318,21 +404,14 @@ static char *fstring2str(fstring_t *f) {
 
 
 /*
- * va_format_string()
- *
- * formatuje zgodnie z podanymi parametrami cig znakw.
+ * format_args_count()
  *
- *  - format - warto, nie nazwa formatu,
- *  - ap - argumenty.
+ * liczy ilo argumentw potrzebnych formatowi.
  */
-static char *va_format_string(const char *format, va_list ap) {
-	string_t buf = string_init(NULL);
-	static int dont_resolve = 0;
+static int format_args_count(const char *format) {
 	const char *p;
-	char *args[9] = { NULL, NULL, NULL, NULL, NULL, NULL, NULL, NULL, NULL };
-	int i, argc = 0;
+	int argc = 0;
 
-	/* liczymy ilo argumentw */
 	for (p = format; *p; p++) {
 		if (*p == '\\' && p[1] == '%') {
 			p++;
@@ -379,11 +458,301 @@ static char *va_format_string(const char *format, va_list ap) {
 		}
 	}
 
-	for (i = 0; i < argc; i++)
+	return argc;
+}
+
+/* returns index in args[] or -1 */
+static inline int format_arg_index(char ch) {
+	return (ch >= '1' && ch <= '9') ? ch - '1' : -1;
+}
+
+static void format_compiled_text(GArray *ops, string_t text) {
+	struct format_op op = { FORMAT_OP_TEXT, };
+
+	if (!text->len)
+		return;
+
+	op.text = g_strndup(text->str, text->len);
+	g_array_append_val(ops, op);
+	g_string_truncate(text, 0);
+}
+
+/*
+ * format_compile()
+ *
+ * kompiluje format do listy operacji, wykonywanych potem przez
+ * format_compiled_expand() bez ponownego parsowania formatu.
+ *
+ *  - format - warto, nie nazwa formatu.
+ */
+static struct format_compiled *format_compile(const char *format) {
+	struct format_compiled *fc = xmalloc(sizeof(struct format_compiled));
+	GArray *ops = g_array_new(FALSE, TRUE, sizeof(struct format_op));
+	string_t text = string_init(NULL);
+	const char *p = format;
+
+	fc->argc = format_args_count(format);
+
+	while (*p) {
+		struct format_op op = { FORMAT_OP_TEXT, };
+
+		if (*p == '\\' && (p[1] == '%' || p[1] == '\\')) {
+			string_append_c(text, p[1]);
+			p += 2;
+			continue;
+		}
+
+		if ((*p == '/') && (p[1] == '|')) {	/* /| 'set margin' */
+			if ((p == format) || (p[-1] != '/'))
+				string_append(text, "\033[0000m");	/* najgupsze, ale to nie jest moje ostatnie sowo */
+			else
+				string_append_c(text, '|');
+			p += 2;
+			continue;
+		}
+
+		if (*p != '%') {
+			string_append_c(text, *p);
+			p++;
+			continue;
+		}
+
+		p++;
+		if (!*p)
+			break;
+
+		if (*p == '%' || *p == '|' || *p == ']') {
+			/* stae, nie zale od niczego */
+			if (*p == '%')
+				string_append_c(text, '%');
+			else if (*p == '|')
+				string_append(text, "\033[00m");	/* gupie, wiem */
+			else
+				string_append(text, "\033[000m");	/* jeszcze gupsze */
+			p++;
+			continue;
+		}
+
+		format_compiled_text(ops, text);
+
+		/* This is conditional formatee, it looks like:
+		 * %{NcdefSTUV}X
+		 * N - is a parameter number, first letter of this parameter will be checked against 'cdef' letters
+		 *   if N[0] == 'c', %S formatee is used
+		 *   if N[0] == 'd', %T formatee is used
+		 *   if N[0] == 'e', %U formatee is used
+		 *   if N[0] == 'f', %V formatee is used
+		 * if none matches, nothing is used. S, T, U, V can be only simple
+		 * formatees (colours, %>, %#, parameter without padding, ...)
+		 */
+		if (*p == '{') {
+			const char *end;
+			int hm = 0;
+
+			p++;
+
+			if (*p == '}') {			/* ${...}X */
+				p++;
+				if (*p)
+					p++;
+				continue;
+			}
+			if (format_arg_index(*p) == -1) {	/* not number, skip it this formatee */
+				p++;
+				continue;
+			}
+
+			op.type	= FORMAT_OP_COND;
+			op.arg	= format_arg_index(*p);
+			p++;
+
+			for (end = p; *end && *end != '}'; end++)
+				hm++;
+			hm >>= 1;
+
+			op.text		= g_strndup(p, hm);
+			op.results	= g_strndup(p + hm, hm);
+			g_array_append_val(ops, op);
+
+			/* skip "cdefSTUV}X" */
+			for (end = p + 2 * hm; *end && end < p + 2 * hm + 2; end++)
+				;
+			p = end;
+			continue;
+		}
+
+		if (*p == '@') {
+			op.type	= FORMAT_OP_GENDER;
+			op.arg	= format_arg_index(p[1]);
+			g_array_append_val(ops, op);
+
+			p++;
+			if (*p)
+				p++;
+			continue;
+		}
+
+		if (*p == '[' || *p == '(') {
+			char *q;
+
+			op.fill_soft = (*p == '(');
+			op.fill_char = ' ';
+			p++;
+
+			if (*p == '^') {
+				op.center = 1;
+				p++;
+			}
+
+			if (*p == '.') {
+				op.fill_char = '0';
+				p++;
+			} else if (*p == ',') {
+				op.fill_char = '.';
+				p++;
+			} else if (*p == '_') {
+				op.fill_char = '_';
+				p++;
+			}
+
+			op.fill_length = strtol(p, &q, 0);
+			p = q;
+			if (op.fill_length > 0)
+				op.fill_after = 1;
+			else {
+				op.fill_length = -op.fill_length;
+				op.fill_before = 1;
+			}
+			if (*p)
+				p++;
+
+			if (format_arg_index(*p) != -1) {
+				op.type	= FORMAT_OP_ARG;
+				op.arg	= format_arg_index(*p);
+				g_array_append_val(ops, op);
+			}
+			if (*p)
+				p++;
+			continue;
+		}
+
+		if (format_arg_index(*p) != -1) {
+			op.type	= FORMAT_OP_ARG;
+			op.arg	= format_arg_index(*p);
+		} else {
+			op.type	= FORMAT_OP_ESCAPE;
+			op.ch	= *p;
+		}
+		g_array_append_val(ops, op);
+		p++;
+	}
+
+	format_compiled_text(ops, text);
+	string_free(text, 1);
+
+	fc->count = ops->len;
+	fc->ops = (struct format_op *) g_array_free(ops, FALSE);
+
+	return fc;
+}
+
+static void format_compiled_free(struct format_compiled *fc) {
+	int i;
+
+	if (!fc)
+		return;
+
+	for (i = 0; i < fc->count; i++) {
+		xfree(fc->ops[i].text);
+		xfree(fc->ops[i].results);
+	}
+	xfree(fc->ops);
+	xfree(fc);
+}
+
+/*
+ * format_escape()
+ *
+ * dopisuje do bufora rozwinicie prostej formatki %ch.
+ */
+static void format_escape(string_t buf, char ch, char **args) {
+	switch (ch) {
+		case '%':	string_append_c(buf, '%');			break;
+		case '>':	string_append(buf, prompt_cache);		break;
+		case ')':	string_append(buf, prompt2_cache);		break;
+		case '!':	string_append(buf, error_cache);		break;
+		case '|':	string_append(buf, "\033[00m");			break;
+		case ']':	string_append(buf, "\033[000m");		break;
+		case '#':	string_append(buf, timestamp(timestamp_cache));	break;
+		default:
+			if (format_arg_index(ch) != -1)
+				string_append(buf, args[format_arg_index(ch)]);
+			else if (config_display_color)
+				string_append(buf, format_ansi(ch));
+	}
+}
+
+static void format_expand_arg(string_t buf, const struct format_op *op, char *str) {
+	int fill_before	= op->fill_before;
+	int fill_after	= op->fill_after;
+	int fill_length	= op->fill_length;
+	int center	= op->center;
+	int i, need_free = 0;
+
+	if (fill_length) {
+		fstring_t * fstr = fstring_new(str);
+		/* XXX: width */
+		int len = g_utf8_strlen(fstr->str, -1);
+		if (len >= fill_length) {
+			if (!op->fill_soft) {
+				/* XXX: how about double width chars? */
+				*(g_utf8_offset_to_pointer(fstr->str, fill_length)) = 0;
+				str = fstring2str(fstr);
+				need_free = 1;
+			}
+			fill_length = 0;
+		} else
+			fill_length -= len;
+		fstring_free(fstr);
+	}
+
+	if (center) {
+		fill_before = fill_after = 1;
+		center = fill_length & 1;
+		fill_length /= 2;
+	}
+
+	if (fill_before)
+		for (i = 0; i < fill_length+center; i++)
+			string_append_c(buf, op->fill_char);
+
+	string_append(buf, str);
+
+	if (fill_after)
+		for (i = 0; i < fill_length; i++)
+			string_append_c(buf, op->fill_char);
+	if (need_free)
+		xfree(str);
+}
+
+/*
+ * format_compiled_expand()
+ *
+ * formatuje skompilowany format zgodnie z podanymi parametrami.
+ *
+ *  - fc - skompilowany format,
+ *  - ap - argumenty.
+ */
+static char *format_compiled_expand(const struct format_compiled *fc, va_list ap) {
+	char *args[9] = { NULL, NULL, NULL, NULL, NULL, NULL, NULL, NULL, NULL };
+	string_t buf = string_init(NULL);
+	int i;
+
+	for (i = 0; i < fc->argc; i++)
 		args[i] = va_arg(ap, char *);
 
-	if (!dont_resolve) {
-		dont_resolve = 1;
+	if (!format_dont_resolve) {
+		format_dont_resolve = 1;
 		if (no_prompt_cache) {
 			/* zawsze czytaj */
 			timestamp_cache	= format_find("timestamp");
@@ -397,206 +766,85 @@ static char *va_format_string(const char *format, va_list ap) {
 			if (!prompt2_cache)	prompt2_cache	= format_string(format_find("prompt2"));
 			if (!error_cache)	error_cache	= format_string(format_find("error"));
 		}
-		dont_resolve = 0;
+		format_dont_resolve = 0;
 	}
 
-	p = format;
-
-	while (*p) {
-		if (*p == '\\' && (p[1] == '%' || p[1] == '\\')) {
-			string_append_c(buf, p[1]);
-			p += 2;
-			continue;
-		} else if (*p == '%') {
-			int fill_before = 0;
-			int fill_after	= 0;
-			int fill_soft	= 1;
-			int fill_length = 0;
-			char fill_char	= ' ';
-			int center	= 0;
+	for (i = 0; i < fc->count; i++) {
+		const struct format_op *op = &fc->ops[i];
+		char *str = (op->arg != -1) ? args[op->arg] : NULL;
 
-			p++;
-			if (!*p)
+		switch (op->type) {
+			case FORMAT_OP_TEXT:
+				string_append(buf, op->text);
 				break;
-			/* This is conditional formatee, it looks like:
-			 * %{NcdefSTUV}X
-			 * N - is a parameter number, first letter of this parameter will be checked against 'cdef' letters
-			 *   if N[0] == 'c', %S formatee is used
-			 *   if N[0] == 'd', %T formatee is used
-			 *   if N[0] == 'e', %U formatee is used
-			 *   if N[0] == 'f', %V formatee is used
-			 */
-			if (*p == '{') {		/* how does it works ? i czemu tego nie ma w docs/themes.txt ? */
-							/* bo to pisa GiM, a on jak wiadomo super komentuje kod :> */
-				int hm		= 0;
-				char *str;
-				char *cnt;
-
-				p++;
 
-				if (*p == '}')				{  p++; p++; continue; }	/* dj: why p++; p++; ? who wrote it? */
-													/* G->dj: It's on purpose, format looks like:
-													 * ${...}X
-													 */
-				else if (!(*p >= '0' && *p <= '9'))	{	p++; continue; }	/* not number, skip it this formatee */
-				else					str = args[*p - '1'];		/* if number, get str from args table */
+			case FORMAT_OP_ESCAPE:
+				format_escape(buf, op->ch, args);
+				break;
 
-				p++;
-				/* there must be even, point cnt to the half of string
-				 * [according to example above p points to "cdef.." cnt points to "STUV", hm=4]
-				 */
-				cnt = (char *)p;
-				while (*cnt && *cnt!='}') { cnt++; hm++; }
-				hm>>=1; cnt=(char *)(p+hm);
-				/* debug(">>> [HM:%d]", hm); */
-				for (; hm>0; hm--) {
-					if (*p == *str) break;
-					p++; cnt++;
-				}
-				/* debug(" [%c%c][%d] [%s] ", *p, *cnt, hm, p); */
-				/* hm == 0, means N-th parameter doesn't fit to any of letter specified,
-				 * so we skip this formatee, but first we must fix 'p' to point to proper place
-				 */
-				if (!hm) { 
-					p = *cnt ? *(cnt+1) ? (cnt+2) : (cnt+1) : cnt;		/* + point 'p' = cnt+2 if it exist
-												 *   ((cnt+2) is after end of formatee
-												 *    (there's X after enclosing '}')
-												 * + or point to '\0' */
-					continue; 
-				}
-				/* N-th param matched a letter, so point 'p' to that free X at the end,
-				 * and correct it with proper formatee letter, and go-on with theme code :)
-				 * Now you should understand why there's that 'X' at the end :>
-				 */
-				p=(cnt+hm+1);
-				*((char *)p)=*cnt;
-			}
-			if (*p == '%')
-				string_append_c(buf, '%');
-			else if (*p == '>')
-				string_append(buf, prompt_cache);
-			else if (*p == ')')
-				string_append(buf, prompt2_cache);
-			else if (*p == '!')
-				string_append(buf, error_cache);
-			else if (*p == '|')
-				string_append(buf, "\033[00m"); /* gupie, wiem */
-			else if (*p == ']')
-				string_append(buf, "\033[000m");	/* jeszcze gupsze */
-			else if (*p == '#')
-				string_append(buf, timestamp(timestamp_cache));
-			else if (config_display_color) {
-				const char *tmp = format_ansi(*p);
-				string_append(buf, tmp);
-			} 
-
-			if (*p == '@') {
-				char *str = (char*) args[*(p + 1) - '1'];
+			case FORMAT_OP_ARG:
+				format_expand_arg(buf, op, str);
+				break;
 
+			case FORMAT_OP_GENDER:
 				if (str) {
 					char *q = str + xstrlen(str) - 1;
 
 					while (q >= str && (isspace(*q) || ispunct(*q)))
 						q--;
 
-					if (*q == 'a')
+					if (q >= str && *q == 'a')
 						string_append(buf, "a");
 					else
 						string_append(buf, "y");
 				} else
 					string_append(buf, "y"); /* display_notify&4, I think male form would be fine for UIDs */
-				p += 2;
-				continue;
-			}
-
-			if (*p == '[' || *p == '(') {
-				char *q;
-
-				fill_soft = (*p == '(');
-				p++;
+				break;
 
-				if (*p == '^') {
-					center = 1;
-					p++;
-				}
-				/* fill_char = ' '; */		/* zadeklarowane wczesniej */
+			case FORMAT_OP_COND:
+			{
+				const char *c;
 
-				if (*p == '.') {
-					fill_char = '0';
-					p++;
-				} else if (*p == ',') {
-					fill_char = '.';
-					p++;
-				} else if (*p == '_') {
-					fill_char = '_';
-					p++;
-				}
+				if (!str || !*str || !(c = xstrchr(op->text, *str)))
+					break;
 
-				fill_length = strtol(p, &q, 0);
-				p = q;
-				if (fill_length > 0)
-					fill_after = 1;
-				else {
-					fill_length = -fill_length;
-					fill_before = 1;
-				}
-				p++;
+				format_escape(buf, op->results[c - op->text], args);
+				break;
 			}
+		}
+	}
 
-			if (*p >= '1' && *p <= '9') {
-				char *str = (char *) args[*p - '1'];
-				int i, need_free = 0;
-
-				if (fill_length) {
-					fstring_t * fstr = fstring_new(str);
-					/* XXX: width */
-					int len = g_utf8_strlen(fstr->str, -1);
-					if (len >= fill_length) {
-						if (!fill_soft) {
-							/* XXX: how about double width chars? */
-							*(g_utf8_offset_to_pointer(fstr->str, fill_length)) = 0;
-							str = fstring2str(fstr);
-							need_free = 1;
-						}
-						fill_length = 0;
-					} else
-						fill_length -= len;
-					fstring_free(fstr);
-				}
-
-				if (center) {
-					fill_before = fill_after = 1;
-					center = fill_length & 1;
-					fill_length /= 2;
-				}
+	if (!format_dont_resolve && no_prompt_cache)
+		theme_cache_reset();
 
-				if (fill_before)
-					for (i = 0; i < fill_length+center; i++)
-						string_append_c(buf, fill_char);
+	return string_free(buf, 0);
+}
 
-				string_append(buf, str);
+/*
+ * va_format_string()
+ *
+ * formatuje zgodnie z podanymi parametrami cig znakw. formaty
+ * z listy formats s kompilowane tylko raz.
+ *
+ *  - format - warto, nie nazwa formatu,
+ *  - ap - argumenty.
+ */
+static char *va_format_string(const char *format, va_list ap) {
+	struct format *f;
+	struct format_compiled *fc;
+	char *res;
 
-				if (fill_after)
-					for (i = 0; i < fill_length; i++)
-						string_append_c(buf, fill_char);
-				if (need_free)
-					xfree(str);
-			}
-		} else if ((*p=='/') && (p[1] == '|')) {	/* /| 'set margin' */
-			if ((p == format) || (p[-1]!='/'))
-				string_append(buf, "\033[0000m");	/* najgupsze, ale to nie jest moje ostatnie sowo */
-			else
-				string_append_c(buf, '|');
-			p++;
-		} else
-			string_append_c(buf, *p);
-		p++;
+	if (formats_by_value && (f = g_hash_table_lookup(formats_by_value, format))) {
+		if (!f->compiled)
+			f->compiled = format_compile(f->value);
+		return format_compiled_expand(f->compiled, ap);
 	}
 
-	if (!dont_resolve && no_prompt_cache)
-		theme_cache_reset();
+	fc = format_compile(format);
+	res = format_compiled_expand(fc, ap);
+	format_compiled_free(fc);
 
-	return string_free(buf, 0);
+	return res;
 }
 
 /**
@@ -1150,13 +1398,23 @@ void format_add(const char *name, const char *value, int replace) {
 		return;
 	}
 
+	if (!formats_by_value)
+		formats_by_value = g_hash_table_new(g_direct_hash, g_direct_equal);
+
 	for (fl = formats[hash & 0xff]; fl; fl = fl->next) {
 		struct format *f = fl;
 
 		if (hash == f->name_hash && !xstrcmp(name, f->name)) {
 			if (replace) {
+				g_hash_table_remove(formats_by_value, f->value);
+				format_compiled_free(f->compiled);
+				f->compiled = NULL;
+
 				xfree(f->value);
 				f->value = xstrdup(value);
+				g_hash_table_insert(formats_by_value, f->value, f);
+
+				format_find_cache_reset();
 			}
 			return;
 		}
@@ -1168,6 +1426,9 @@ void format_add(const char *name, const char *value, int replace) {
 	f->value	= xstrdup(value);
 
 	formats_add(&(formats[hash & 0xff]), f);
+	g_hash_table_insert(formats_by_value, f->value, f);
+
+	format_find_cache_reset();
 	return;
 }
 
@@ -1198,6 +1459,7 @@ static int format_remove(const char *name) {
 
 		if (hash == f->name_hash && !xstrcmp(f->name, name)) {
 			(void) formats_removei(&(formats[hash & 0xff]), f);
+			format_find_cache_reset();
 			return 0;
 		}
 	}
@@ -1380,6 +1642,17 @@ void theme_free() {
 	for (i = 0; i < 0x100; i++)
 		formats_destroy(&(formats[i]));
 
+	if (formats_by_value) {
+		g_hash_table_destroy(formats_by_value);
+		formats_by_value = NULL;
+	}
+	if (format_find_cache) {
+		g_hash_table_destroy(format_find_cache);
+		format_find_cache = NULL;
+	}
+	xfree(format_find_cache_theme);
+	format_find_cache_theme = NULL;
+
 	no_prompt_cache = 0;
 
 	theme_cache_reset();
@@ -29,6 +29,7 @@
 #include <arpa/inet.h>
 #endif
 
+#include <ctype.h>
 #include <errno.h>
 #include <limits.h>
 #include <stdarg.h>
@@ -84,22 +85,307 @@ static LIST_FREE_ITEM(userlist_free_item, userlist_t *) {
 }
 DYNSTUFF_LIST_DECLARE_SORTED(userlists, userlist_t, userlist_compare, userlist_free_item,
 	static __DYNSTUFF_ADD_SORTED,					/* userlists_add() */
-	__DYNSTUFF_REMOVE_SAFE,						/* userlists_remove() */
-	__DYNSTUFF_DESTROY)						/* userlists_destroy() */
+	static __DYNSTUFF_REMOVE_SAFE,					/* userlists_remove() */
+	__DYNSTUFF_NODESTROY)						/* userlists_destroy() */
 
 /*
- * userlist_add_entry()
+ * userlist indexes
+ *
+ * Every userlist (session->userlist, window->userlist, conference participants)
+ * gets its own set of case-insensitive hash tables, keyed by the address of the
+ * list head. Each key maps to GSList of entries, because nicknames (and bare jids
+ * of MUC participants) don't need to be unique. We remember under which keys
+ * entry was indexed, so it can be removed even if someone changed u->nickname
+ * behind our back; userlist_find_u() double-checks every hit.
+ */
+typedef struct {
+	char *uid;
+	char *nickname;
+	char *bare;		/* tlen:/xmpp: uid without resource */
+} userlist_index_keys_t;
+
+typedef struct {
+	char *key;		/* casefolded uid or nickname */
+	userlist_t *u;
+} userlist_sorted_t;
+
+typedef struct {
+	GHashTable *uids;
+	GHashTable *nicks;
+	GHashTable *bare;
+	GHashTable *keys;	/* userlist_t * -> userlist_index_keys_t * */
+	GArray *sorted_uids;	/* userlist_sorted_t, sorted by key, for prefix searches */
+	GArray *sorted_nicks;
+} userlist_index_t;
+
+static GHashTable *userlist_indexes = NULL;	/* userlist_t ** -> userlist_index_t * */
+
+static guint userlist_index_hash(gconstpointer key) {
+	const unsigned char *p = key;
+	guint hash = 5381;
+
+	for (; *p; p++)
+		hash = (hash << 5) + hash + tolower(*p);
+	return hash;
+}
+
+static gboolean userlist_index_equal(gconstpointer a, gconstpointer b) {
+	return !xstrcasecmp(a, b);
+}
+
+static char *userlist_bare_uid(const char *uid) {
+	const char *tmp;
+
+	if (xstrncmp(uid, "tlen:", 5) && xstrncmp(uid, "xmpp:", 5))
+		return NULL;
+
+	if (!(tmp = xstrchr(uid, '/')))
+		return xstrdup(uid);
+
+	return (tmp - uid) > 0 ? xstrndup(uid, tmp - uid) : NULL;
+}
+
+static void userlist_index_keys_free(userlist_index_keys_t *k) {
+	xfree(k->uid);
+	xfree(k->nickname);
+	xfree(k->bare);
+	xfree(k);
+}
+
+static void userlist_index_insert(GHashTable *h, const char *key, userlist_t *u) {
+	gpointer orig_key, l;
+
+	if (!key)
+		return;
+
+	if (g_hash_table_lookup_extended(h, key, &orig_key, &l)) {
+		g_hash_table_steal(h, key);
+		g_hash_table_insert(h, orig_key, g_slist_prepend(l, u));
+	} else
+		g_hash_table_insert(h, xstrdup(key), g_slist_prepend(NULL, u));
+}
+
+static void userlist_index_delete(GHashTable *h, const char *key, userlist_t *u) {
+	gpointer orig_key, l;
+
+	if (!key || !g_hash_table_lookup_extended(h, key, &orig_key, &l))
+		return;
+
+	g_hash_table_steal(h, key);
+
+	if ((l = g_slist_remove(l, u)))
+		g_hash_table_insert(h, orig_key, l);
+	else
+		xfree(orig_key);
+}
+
+static void userlist_index_list_free(gpointer data) {
+	g_slist_free(data);
+}
+
+/* the same folding as strncasecmp_pl(), which completion uses */
+static char *userlist_fold(const char *str, gssize len) {
+	return g_utf8_casefold(str, len);
+}
+
+/*
+ * userlist_sorted_bound()
  *
- * dodaje do listy kontaktw pojedyncz lini z pliku lub z serwera.
+ * index of first entry in @a a, which key (first @a len chars of it) isn't lower than @a key
  */
-void userlist_add_entry(session_t *session, const char *line) {
+static guint userlist_sorted_bound(GArray *a, const char *key, size_t len) {
+	guint lo = 0, hi = a->len;
+
+	while (lo < hi) {
+		guint mid = lo + (hi - lo) / 2;
+
+		if (strncmp(g_array_index(a, userlist_sorted_t, mid).key, key, len) < 0)
+			lo = mid + 1;
+		else
+			hi = mid;
+	}
+	return lo;
+}
+
+static void userlist_sorted_insert(GArray *a, const char *key, userlist_t *u) {
+	userlist_sorted_t item;
+
+	if (!key)
+		return;
+
+	item.key = userlist_fold(key, -1);
+	item.u	 = u;
+	g_array_insert_val(a, userlist_sorted_bound(a, item.key, strlen(item.key) + 1), item);
+}
+
+static void userlist_sorted_append(GArray *a, const char *key, userlist_t *u) {
+	userlist_sorted_t item;
+
+	if (!key)
+		return;
+
+	item.key = userlist_fold(key, -1);
+	item.u	 = u;
+	g_array_append_val(a, item);
+}
+
+static gint userlist_sorted_compare(gconstpointer a, gconstpointer b) {
+	return strcmp(((const userlist_sorted_t *) a)->key, ((const userlist_sorted_t *) b)->key);
+}
+
+static void userlist_sorted_delete(GArray *a, const char *key, userlist_t *u) {
+	char *folded;
+	guint i;
+
+	if (!key)
+		return;
+
+	folded = userlist_fold(key, -1);
+	for (i = userlist_sorted_bound(a, folded, strlen(folded) + 1); i < a->len; i++) {
+		userlist_sorted_t *item = &g_array_index(a, userlist_sorted_t, i);
+
+		if (strcmp(item->key, folded))
+			break;
+		if (item->u == u) {
+			g_free(item->key);
+			g_array_remove_index(a, i);
+			break;
+		}
+	}
+	g_free(folded);
+}
+
+static void userlist_sorted_free(GArray *a) {
+	guint i;
+
+	for (i = 0; i < a->len; i++)
+		g_free(g_array_index(a, userlist_sorted_t, i).key);
+	g_array_free(a, TRUE);
+}
+
+static userlist_index_t *userlist_index_get(userlist_t **userlist, int create) {
+	userlist_index_t *idx;
+
+	if (!userlist_indexes) {
+		if (!create)
+			return NULL;
+		userlist_indexes = g_hash_table_new(g_direct_hash, g_direct_equal);
+	}
+
+	if ((idx = g_hash_table_lookup(userlist_indexes, userlist)) || !create)
+		return idx;
+
+	idx = xmalloc(sizeof(userlist_index_t));
+	idx->uids	= g_hash_table_new_full(userlist_index_hash, userlist_index_equal, xfree, userlist_index_list_free);
+	idx->nicks	= g_hash_table_new_full(userlist_index_hash, userlist_index_equal, xfree, userlist_index_list_free);
+	idx->bare	= g_hash_table_new_full(userlist_index_hash, userlist_index_equal, xfree, userlist_index_list_free);
+	idx->keys	= g_hash_table_new_full(g_direct_hash, g_direct_equal, NULL, (GDestroyNotify) userlist_index_keys_free);
+	idx->sorted_uids	= g_array_new(FALSE, FALSE, sizeof(userlist_sorted_t));
+	idx->sorted_nicks	= g_array_new(FALSE, FALSE, sizeof(userlist_sorted_t));
+
+	g_hash_table_insert(userlist_indexes, userlist, idx);
+	return idx;
+}
+
+/*
+ * userlist_index_add()
+ *
+ * indexes @a u. with @a bulk set, sorted arrays are only appended to,
+ * and caller has to call userlist_index_sort() after adding the last one.
+ */
+static void userlist_index_add_real(userlist_t **userlist, userlist_t *u, int bulk) {
+	userlist_index_t *idx = userlist_index_get(userlist, 1);
+	void (*sorted_add)(GArray *, const char *, userlist_t *) = bulk ? userlist_sorted_append : userlist_sorted_insert;
+	userlist_index_keys_t *k = xmalloc(sizeof(userlist_index_keys_t));
+
+	k->uid		= xstrdup(u->uid);
+	k->nickname	= xstrdup(u->nickname);
+	k->bare		= userlist_bare_uid(u->uid);
+
+	userlist_index_insert(idx->uids, k->uid, u);
+	userlist_index_insert(idx->nicks, k->nickname, u);
+	userlist_index_insert(idx->bare, k->bare, u);
+	sorted_add(idx->sorted_uids, k->uid, u);
+	sorted_add(idx->sorted_nicks, k->nickname, u);
+
+	g_hash_table_replace(idx->keys, u, k);
+}
+
+static void userlist_index_add(userlist_t **userlist, userlist_t *u) {
+	userlist_index_add_real(userlist, u, 0);
+}
+
+static void userlist_index_sort(userlist_t **userlist) {
+	userlist_index_t *idx = userlist_index_get(userlist, 1);
+
+	g_array_sort(idx->sorted_uids, userlist_sorted_compare);
+	g_array_sort(idx->sorted_nicks, userlist_sorted_compare);
+}
+
+static void userlist_index_remove(userlist_t **userlist, userlist_t *u) {
+	userlist_index_t *idx = userlist_index_get(userlist, 0);
+	userlist_index_keys_t *k;
+
+	if (!idx || !(k = g_hash_table_lookup(idx->keys, u)))
+		return;
+
+	userlist_index_delete(idx->uids, k->uid, u);
+	userlist_index_delete(idx->nicks, k->nickname, u);
+	userlist_index_delete(idx->bare, k->bare, u);
+	userlist_sorted_delete(idx->sorted_uids, k->uid, u);
+	userlist_sorted_delete(idx->sorted_nicks, k->nickname, u);
+
+	g_hash_table_remove(idx->keys, u);
+}
+
+static void userlist_index_destroy(userlist_t **userlist) {
+	userlist_index_t *idx = userlist_index_get(userlist, 0);
+
+	if (!idx)
+		return;
+
+	g_hash_table_remove(userlist_indexes, userlist);
+
+	g_hash_table_destroy(idx->uids);
+	g_hash_table_destroy(idx->nicks);
+	g_hash_table_destroy(idx->bare);
+	g_hash_table_destroy(idx->keys);
+	userlist_sorted_free(idx->sorted_uids);
+	userlist_sorted_free(idx->sorted_nicks);
+	xfree(idx);
+}
+
+static void userlist_link(userlist_t **userlist, userlist_t *u) {
+	userlists_add(userlist, u);
+	userlist_index_add(userlist, u);
+}
+
+/*
+ * userlists_destroy()
+ *
+ * frees whole userlist together with its lookup indexes.
+ */
+void userlists_destroy(userlist_t **userlist) {
+	userlist_index_destroy(userlist);
+
+	LIST_DESTROY2(*userlist, userlist_free_item);
+	*userlist = NULL;
+}
+
+/*
+ * userlist_parse_entry()
+ *
+ * tworzy kontakt z pojedynczej linii z pliku lub z serwera, nie dodajc
+ * go do adnej listy.
+ */
+static userlist_t *userlist_parse_entry(session_t *session, const char *line) {
 	char **entry = array_make(line, ";", 8, 0, 0);
 	userlist_t *u;
 	int count, i;
 
 	if ((count = g_strv_length(entry)) < 7) {
 		g_strfreev(entry);
-		return;
+		return NULL;
 	}
 
 	u = xmalloc(sizeof(userlist_t)); /* we'd need this here */
@@ -116,7 +402,7 @@ void userlist_add_entry(session_t *session, const char *line) {
 		array_free_count(entry, count);
 		xfree((void *) u->uid);
 		xfree(u);
-		return;
+		return NULL;
 	}
 
 	u->status = EKG_STATUS_NA;
@@ -129,6 +415,7 @@ void userlist_add_entry(session_t *session, const char *line) {
 	}
 			
 	u->groups	= group_init(entry[5]);
+	ignored_update(u);
 
 	if (entry[3]) {
 		u->nickname	= !valid_nick(entry[3]) ? 
@@ -141,7 +428,64 @@ void userlist_add_entry(session_t *session, const char *line) {
 		NULL;
 	
 	array_free_count(entry, count);
-	userlists_add(&(session->userlist), u);
+	return u;
+}
+
+/*
+ * userlist_add_entry()
+ *
+ * dodaje do listy kontaktw pojedyncz lini z pliku lub z serwera.
+ */
+void userlist_add_entry(session_t *session, const char *line) {
+	userlist_t *u;
+
+	if ((u = userlist_parse_entry(session, line)))
+		userlist_link(&(session->userlist), u);
+}
+
+typedef struct {
+	userlist_t *u;
+	guint pos;		/* line number, to keep order of equal nicknames */
+} userlist_read_item_t;
+
+/* the same order, in which userlists_add() would put them one by one */
+static gint userlist_read_compare(gconstpointer a, gconstpointer b) {
+	const userlist_read_item_t *i1 = a, *i2 = b;
+	int ret;
+
+	if ((ret = userlist_compare(i1->u, i2->u)))
+		return ret;
+
+	return (i1->pos < i2->pos) - (i1->pos > i2->pos);
+}
+
+/*
+ * userlist_link_bulk()
+ *
+ * sorts @a items once and merges them into (already sorted) @a userlist
+ * in a single pass, instead of walking the list for every entry.
+ */
+static void userlist_link_bulk(userlist_t **userlist, GArray *items) {
+	userlist_t **tail = userlist;
+	guint i;
+
+	g_array_sort(items, userlist_read_compare);
+
+	for (i = 0; i < items->len; i++) {
+		userlist_t *u = g_array_index(items, userlist_read_item_t, i).u;
+
+		/* userlists_add() puts new entry before the equal ones */
+		while (*tail && userlist_compare(u, *tail) > 0)
+			tail = &(*tail)->next;
+
+		u->next = *tail;
+		*tail = u;
+		tail = &u->next;
+
+		userlist_index_add_real(userlist, u, 1);
+	}
+
+	userlist_index_sort(userlist);
 }
 
 /**
@@ -156,17 +500,29 @@ void userlist_add_entry(session_t *session, const char *line) {
 int userlist_read(session_t *session) {
 	char *buf;
 	GDataInputStream *f;
+	GArray *items;
 
 	if (!(f = G_DATA_INPUT_STREAM(config_open("%s-userlist", "r", session->uid))))
 		return -1;
+
+	items = g_array_new(FALSE, FALSE, sizeof(userlist_read_item_t));
 			
 	while ((buf = read_line(f))) {
+		userlist_read_item_t item;
+
 		if (buf[0] == '#' || (buf[0] == '/' && buf[1] == '/'))
 			continue;
 		
-		userlist_add_entry(session, buf);
+		if (!(item.u = userlist_parse_entry(session, buf)))
+			continue;
+
+		item.pos = items->len;
+		g_array_append_val(items, item);
 	}
 
+	userlist_link_bulk(&(session->userlist), items);
+	g_array_free(items, TRUE);
+
 	query_emit(NULL, "userlist-refresh");	/* XXX, wywolywac tylko kiedy dodalismy przynajmniej 1 */
 
 	g_object_unref(f);
@@ -189,18 +545,25 @@ int userlist_read(session_t *session) {
  *		-2 if we fail to create/open userlist file in rw mode
  */
 
+#define USERLIST_WRITE_CHUNK 8192
+
 void userlist_write(session_t *session) {
 	GOutputStream *f;
+	GString *buf;
 	userlist_t *ul;
+	char **entry;
 
 	if (!(f = G_OUTPUT_STREAM(config_open("%s-userlist", "w", session->uid))))
 		return;
 
+	/* one entry array for all contacts, privhandlers may only replace its items */
+	entry = xcalloc(7, sizeof(char *));
+	buf = g_string_sized_new(USERLIST_WRITE_CHUNK + 512);
+
 	/* userlist_dump() */
 	for (ul = session->userlist; ul; ul = ul->next) {
 		userlist_t *u = ul;
-		char **entry = xcalloc(7, sizeof(char *));
-		char *line;
+		int i;
 
 		entry[0] = NULL;				/* first name [gg] */
 		entry[1] = NULL;				/* last name [gg] */
@@ -208,7 +571,7 @@ void userlist_write(session_t *session) {
 		entry[3] = xstrdup(u->nickname);		/* nickname */
 		entry[4] = NULL;				/* mobile [gg] */
 		entry[5] = group_to_string(u->groups, 1, 0);	/* groups (alloced itself) */
-		entry[6] = strdup(u->uid);			/* uid */
+		entry[6] = xstrdup(u->uid);			/* uid */
 
 		{
 			int function = EKG_USERLIST_PRIVHANDLER_WRITING;
@@ -216,15 +579,30 @@ void userlist_write(session_t *session) {
 			query_emit(NULL, "userlist-privhandle", &u, &function, &entry);
 		}
 
-		line = array_join_count(entry, ";", 7);
+		for (i = 0; i < 7; i++) {
+			if (i)
+				g_string_append_c(buf, ';');
+			if (entry[i])
+				g_string_append(buf, entry[i]);
+			xfree(entry[i]);
+			entry[i] = NULL;
+		}
 
-		ekg_fprintf(f, "%s%s\n", 
-			line,					/* look upper */
-			u->foreign ? u->foreign : "");		/* backwards compatibility */
+		if (u->foreign)					/* backwards compatibility */
+			g_string_append(buf, u->foreign);
+		g_string_append_c(buf, '\n');
 
-		xfree(line);
-		array_free_count(entry, 7);
+		if (buf->len >= USERLIST_WRITE_CHUNK) {
+			ekg_fwrite(f, buf->str, buf->len);
+			g_string_truncate(buf, 0);
+		}
 	}
+
+	if (buf->len)
+		ekg_fwrite(f, buf->str, buf->len);
+
+	g_string_free(buf, TRUE);
+	xfree(entry);
 }
 
 static void userlist_private_free(userlist_t *u) {
@@ -394,7 +772,7 @@ userlist_t *userlist_add_u(userlist_t **userlist, const char *uid, const char *n
 	u->nickname = xstrdup(nickname);
 	u->status = EKG_STATUS_NA;
 
-	userlists_add(userlist, u);
+	userlist_link(userlist, u);
 	return u;
 }
 
@@ -420,6 +798,7 @@ int userlist_remove_u(userlist_t **userlist, userlist_t *u) {
 	if (!u)
 		return -1;
 
+	userlist_index_remove(userlist, u);
 	userlists_remove(userlist, u);
 
 	return 0;
@@ -442,7 +821,8 @@ int userlist_replace(session_t *session, userlist_t *u) {
 		return -1;
 	if (!LIST_UNLINK2(&(session->userlist), u) && (errno == ENOENT))
 		return -1;
-	userlists_add(&(session->userlist), u);
+	userlist_index_remove(&(session->userlist), u);
+	userlist_link(&(session->userlist), u);
 
 	return 0;
 }
@@ -462,6 +842,33 @@ userlist_t *userlist_find(session_t *session, const char *uid) {
 	return userlist_find_u(&(session->userlist), uid);
 }
 
+/*
+ * userlist_index_match()
+ *
+ * sets *hit to the entry indexed under @a key, if there's one.
+ * returns 1 if more than one entry (counting *hit, found under other key) matches,
+ * then caller has to find which one comes first in the list.
+ */
+static int userlist_index_match(GHashTable *h, const char *key, int (*check)(userlist_t *, const char *), userlist_t **hit) {
+	GSList *l;
+
+	for (l = g_hash_table_lookup(h, key); l; l = l->next) {
+		userlist_t *u = l->data;
+
+		if (!check(u, key))
+			continue;
+
+		if (*hit && *hit != u)
+			return 1;
+		*hit = u;
+	}
+	return 0;
+}
+
+static int userlist_check_uid(userlist_t *u, const char *key) { return !xstrcasecmp(u->uid, key); }
+static int userlist_check_nickname(userlist_t *u, const char *key) { return (u->nickname && !xstrcasecmp(u->nickname, key)); }
+static int userlist_check_bare(userlist_t *u, const char *key) { return !xstrncasecmp(u->uid, key, xstrlen(key)); }
+
 /* 
  * userlist_find_u()
  *
@@ -469,11 +876,36 @@ userlist_t *userlist_find(session_t *session, const char *uid) {
  * uid
  */
 userlist_t *userlist_find_u(userlist_t **userlist, const char *uid) {
+	userlist_index_t *idx;
 	userlist_t *ul;
 
 	if (!uid || !userlist)
 		return NULL;
 
+	if ((idx = userlist_index_get(userlist, 0))) {
+		userlist_t *hit = NULL;
+		char *bare;
+		int many;
+
+		if (!userlist_index_match(idx->uids, uid, userlist_check_uid, &hit) &&
+				!userlist_index_match(idx->nicks, uid, userlist_check_nickname, &hit)) {
+
+			/* porwnujemy resource */
+			if (!xstrchr(uid, '/') || !(bare = userlist_bare_uid(uid)))
+				return hit;
+
+			many = userlist_index_match(idx->bare, bare, userlist_check_bare, &hit);
+			xfree(bare);
+
+			if (!many)
+				return hit;
+		}
+
+		/* more entries match (e.g. someone's nickname is other's uid),
+		 * the first one in list order wins, like it always did. */
+	}
+
+	/* list without index, or ambiguous key, fallback to plain search */
 	for (ul = *userlist; ul; ul = ul->next) {
 		userlist_t *u = ul;
 		const char *tmp;
@@ -499,6 +931,112 @@ userlist_t *userlist_find_u(userlist_t **userlist, const char *uid) {
 	return NULL;
 }
 
+/* like userlist_find_u(), but only by uid */
+static userlist_t *userlist_find_uid_u(userlist_t **userlist, const char *uid) {
+	userlist_index_t *idx;
+	userlist_t *ul = NULL;
+
+	if ((idx = userlist_index_get(userlist, 0))) {
+		userlist_index_match(idx->uids, uid, userlist_check_uid, &ul);
+		return ul;
+	}
+
+	for (ul = *userlist; ul; ul = ul->next) {
+		if (!xstrcasecmp(ul->uid, uid))
+			return ul;
+	}
+	return NULL;
+}
+
+/*
+ * userlist_rename_u()
+ *
+ * changes uid and nickname of @a u, keeping @a userlist sorted and indexed.
+ * Other entries with the same uid are removed, since they're stale now
+ * (e.g. irc nick taken by someone, who we didn't notice leaving).
+ *
+ * 0/-1
+ */
+int userlist_rename_u(userlist_t **userlist, userlist_t *u, const char *uid, const char *nickname) {
+	userlist_t *other;
+	char *new_uid, *new_nickname;
+
+	if (!u || !uid)
+		return -1;
+	if (!LIST_UNLINK2(userlist, u) && (errno == ENOENT))
+		return -1;
+	userlist_index_remove(userlist, u);
+
+	while ((other = userlist_find_uid_u(userlist, uid))) {
+		debug_error("userlist_rename_u() %s already on list, removing stale entry\n", uid);
+		userlist_remove_u(userlist, other);
+	}
+
+	new_uid = xstrdup(uid);
+	new_nickname = xstrdup(nickname);
+
+	xfree((void *) u->uid);
+	u->uid = new_uid;
+	xfree(u->nickname);
+	u->nickname = new_nickname;
+
+	userlist_link(userlist, u);
+	return 0;
+}
+
+/**
+ * userlist_find_prefix()
+ *
+ * Calls @a func for each entry of @a userlist, which uid (or nickname, if @a nickname is set)
+ * starts with first @a len chars of @a prefix, compared like strncasecmp_pl() does.<br>
+ * Uses sorted arrays of userlist index, so it costs O(log n) plus number of matches.
+ *
+ * @return number of matching entries.
+ */
+int userlist_find_prefix(userlist_t **userlist, const char *prefix, int len, int nickname, void (*func)(userlist_t *u, void *data), void *data) {
+	userlist_index_t *idx = userlist_index_get(userlist, 0);
+	int count = 0;
+
+	if (!prefix || len < 0)
+		return 0;
+
+	if (idx) {
+		GArray *a = nickname ? idx->sorted_nicks : idx->sorted_uids;
+		char *folded = userlist_fold(prefix, len);
+		size_t flen = strlen(folded);
+		guint i;
+
+		for (i = userlist_sorted_bound(a, folded, flen); i < a->len; i++) {
+			userlist_sorted_t *item = &g_array_index(a, userlist_sorted_t, i);
+			userlist_t *u = item->u;
+
+			if (strncmp(item->key, folded, flen))
+				break;
+
+			/* someone could clear u->nickname without userlist_replace() */
+			if (nickname && !u->nickname)
+				continue;
+
+			func(u, data);
+			count++;
+		}
+		g_free(folded);
+
+	} else {
+		userlist_t *u;
+
+		for (u = *userlist; u; u = u->next) {
+			const char *str = nickname ? u->nickname : u->uid;
+
+			if (str && !strncasecmp_pl(prefix, str, len)) {
+				func(u, data);
+				count++;
+			}
+		}
+	}
+	return count;
+}
+
 /*
  * valid_nick()
  *
@@ -748,6 +1286,7 @@ int ignored_remove(session_t *session, const char *uid) {
 
 		gl = ekg_groups_removei(&u->groups, g);
 	}
+	ignored_update(u);
 
 	if (!u->nickname && !u->groups) {
 		userlist_remove(session, u);
@@ -817,23 +1356,49 @@ int ignored_add(session_t *session, const char *uid, ignore_t level) {
  *
  */
 int ignored_check(session_t *session, const char *uid) {
-	userlist_t *u = userlist_find(session, uid);
+	return ignored_check_u(userlist_find(session, uid));
+}
+
+/**
+ * ignored_check_u()
+ *
+ * Like ignored_check(), but for already found userlist entry.
+ *
+ * @param u - userlist entry, may be NULL
+ *
+ * @return ignore level of @a u (0 if not ignored)
+ */
+int ignored_check_u(userlist_t *u) {
+	return u ? u->ignore_level : 0;
+}
+
+/**
+ * ignored_update()
+ *
+ * Recomputes u->ignore_level from its __ignored groups. ekg_group_add() and
+ * ekg_group_remove() call it, it's needed only if u->groups is set directly.
+ */
+void ignored_update(userlist_t *u) {
 	struct ekg_group *gl;
 
 	if (!u)
-		return 0;
+		return;
+
+	u->ignore_level = 0;
 
 	for (gl = u->groups; gl; gl = gl->next) {
 		struct ekg_group *g = gl;
 
-		if (!xstrcasecmp(g->name, "__ignored"))
-			return IGNORE_ALL;
+		if (!xstrcasecmp(g->name, "__ignored")) {
+			u->ignore_level = IGNORE_ALL;
+			return;
+		}
 
-		if (!xstrncasecmp(g->name, "__ignored_", 10))
-			return atoi(g->name + 10);
+		if (!xstrncasecmp(g->name, "__ignored_", 10)) {
+			u->ignore_level = atoi(g->name + 10);
+			return;
+		}
 	}
-
-	return 0;
 }
 
 /**
@@ -934,6 +1499,7 @@ int ekg_group_add(userlist_t *u, const char *group) {
 	g->name = xstrdup(group);
 
 	ekg_groups_add(&u->groups, g);
+	ignored_update(u);
 
 	return 0;
 }
@@ -959,6 +1525,7 @@ int ekg_group_remove(userlist_t *u, const char *group) {
 
 		if (!xstrcasecmp(g->name, group)) {
 			(void) ekg_groups_removei(&u->groups, g);
+			ignored_update(u);
 			
 			return 0;
 		}
@@ -79,6 +79,7 @@ typedef struct userlist {
 	time_t		status_time;	/**< From when we have this status, description */
 	void		*priv_data;	/**< Alternate private data, used by ncurses plugin */
 	private_data_t	*priv_list;	/* New user private data */
+	int		ignore_level;	/**< ignore level from __ignored groups, kept by ignored_update() */
 } userlist_t;
 
 typedef enum {
@@ -163,8 +164,10 @@ void userlist_add_entry(session_t *session,const char *line);
 int userlist_remove(session_t *session, userlist_t *u);
 int userlist_remove_u(userlist_t **userlist, userlist_t *u);
 int userlist_replace(session_t *session, userlist_t *u);
+int userlist_rename_u(userlist_t **userlist, userlist_t *u, const char *uid, const char *nickname);
 userlist_t *userlist_find(session_t *session, const char *uid);
 userlist_t *userlist_find_u(userlist_t **userlist, const char *uid);
+int userlist_find_prefix(userlist_t **userlist, const char *prefix, int len, int nickname, void (*func)(userlist_t *u, void *data), void *data);
 #define userlist_find_n(a, b) userlist_find(session_find(a), b)
 void userlist_free(session_t *session);
 void userlists_destroy(userlist_t **userlist);
@@ -179,6 +182,8 @@ void userlist_resource_remove(userlist_t *u, ekg_resource_t *r);
 int ignored_add(session_t *session, const char *uid, ignore_t level);
 int ignored_remove(session_t *session, const char *uid);
 int ignored_check(session_t *session, const char *uid);
+int ignored_check_u(userlist_t *u);
+void ignored_update(userlist_t *u);
 int ignore_flags(const char *str);
 const char *ignore_format(int level);
 
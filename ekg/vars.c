@@ -77,6 +77,19 @@ void variable_init() {
 	variable_add(NULL, ("config_version"), VAR_INT, 2, &config_version, NULL, NULL, NULL);
 	variable_add(NULL, ("dcc_dir"), VAR_STR, 1, &config_dcc_dir, NULL, NULL, NULL); 
 	variable_add(NULL, ("debug"), VAR_BOOL, 1, &config_debug, NULL, NULL, NULL);
+	variable_add(NULL, ("debug_levels"), VAR_MAP, 1, &config_debug_levels, NULL,
+			variable_map(9,
+				DEBUG_LEVEL_BIT(0), 0, "default",
+				DEBUG_LEVEL_BIT(DEBUG_IO), 0, "io",
+				DEBUG_LEVEL_BIT(DEBUG_IORECV), 0, "iorecv",
+				DEBUG_LEVEL_BIT(DEBUG_FUNCTION), 0, "function",
+				DEBUG_LEVEL_BIT(DEBUG_ERROR), 0, "error",
+				DEBUG_LEVEL_BIT(DEBUG_GGMISC), 0, "ggmisc",
+				DEBUG_LEVEL_BIT(DEBUG_WHITE), 0, "white",
+				DEBUG_LEVEL_BIT(DEBUG_WARN), 0, "warn",
+				DEBUG_LEVEL_BIT(DEBUG_OK), 0, "ok"),
+			NULL);
+	variable_add(NULL, ("debug_queries"), VAR_BOOL, 1, &config_debug_queries, NULL, NULL, NULL);
 /*	variable_add(NULL, ("default_protocol"), VAR_STR, 1, &config_default_protocol, NULL, NULL, NULL); */
 	variable_add(NULL, ("default_status_window"), VAR_BOOL, 1, &config_default_status_window, NULL, NULL, NULL);
 	variable_add(NULL, ("display_ack"), VAR_MAP, 1, &config_display_ack, NULL, variable_map(6, 0, 0, "none", 1, 0, "delivered", 2, 0, "queued", 4, 0, "dropped", 8, 0, "tempfail", 16, 0, "unknown"), NULL);
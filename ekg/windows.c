@@ -188,6 +188,8 @@ void window_switch(int id) {
 			session_current = w->session;
 	
 		window_current = w;
+		if (w == window_debug)
+			debug_window_sync();
 		query_emit(NULL, "ui-window-switch", &w);	/* XXX */
 
 		w->act = EKG_WINACT_NONE;
@@ -325,12 +327,17 @@ window_t *window_new(const char *target, session_t *session, int new_id) {
  */
 
 void window_print(window_t *w, fstring_t *line) {
+	static query_id_t ui_window_print_id = QUERY_ID_INVALID;
+
 	g_assert(w);
 	g_assert(line);
 
+	if (ui_window_print_id == QUERY_ID_INVALID)
+		ui_window_print_id = query_id("ui-window-print");
+
 	if (!line->ts)
 		line->ts = time(NULL);
-	query_emit(NULL, "ui-window-print", &w, &line);
+	query_emit_id(NULL, ui_window_print_id, &w, &line);
 }
 
 /*
@@ -6,8 +6,15 @@
 
 #include <stdio.h>
 
+void add_commands_tests(void);
+void add_debug_tests(void);
+void add_queries_tests(void);
 void add_recode_tests(void);
+void add_sessions_tests(void);
 void add_static_aborts_tests(void);
+void add_themes_tests(void);
+void add_userlist_tests(void);
+void add_watches_tests(void);
 
 PLUGIN_DEFINE(check, PLUGIN_UI, NULL);
 
@@ -26,8 +33,15 @@ EXPORT int check_plugin_init(int prio) {
 
 	g_test_init(&argc, &argvp, NULL);
 
+	add_commands_tests();
+	add_debug_tests();
+	add_queries_tests();
 	add_recode_tests();
+	add_sessions_tests();
 	add_static_aborts_tests();
+	add_themes_tests();
+	add_userlist_tests();
+	add_watches_tests();
 
 	g_test_run();
 	ekg_exit();
@@ -0,0 +1,53 @@
+#include "ekg2.h"
+
+static COMMAND(check_command_handler) {
+	return 0;
+}
+
+static void check_command_count(command_t *c, void *data) {
+	int *count = data;
+
+	g_assert(!xstrncasecmp(c->name, "chkcmd:", 7));
+	(*count)++;
+}
+
+static void check_command_lookup(void) {
+	command_t *alpha, *alphabet, *beta, *c, *first;
+	int count = 0;
+
+	alphabet = command_add(NULL, "chkcmd:alphabet", NULL, check_command_handler, 0, NULL);
+	alpha	 = command_add(NULL, "chkcmd:alpha", NULL, check_command_handler, 0, NULL);
+	beta	 = command_add(NULL, "chkcmd:beta", NULL, check_command_handler, 0, NULL);
+
+	g_assert_cmpint(command_lookup(NULL, 0, "chkcmd:alpha", 12, &c, &first), ==, 2);
+	g_assert(c == alpha);
+	g_assert(first == alpha);
+
+	g_assert_cmpint(command_lookup(NULL, 0, "CHKCMD:ALPHAB", 13, &c, &first), ==, 1);
+	g_assert(c == NULL);
+	g_assert(first == alphabet);
+
+	/* plugin prefix and the rest are matched as one name */
+	g_assert_cmpint(command_lookup("chkcmd:test", 7, "b", 1, &c, &first), ==, 1);
+	g_assert(first == beta);
+	g_assert_cmpint(command_lookup("chkcmd:", 7, "", 0, NULL, NULL), ==, 3);
+	g_assert_cmpint(command_lookup("chkcmd:", 7, "gamma", 5, &c, &first), ==, 0);
+	g_assert(c == NULL && first == NULL);
+
+	command_foreach("chkcmd:", 7, "", 0, check_command_count, &count);
+	g_assert_cmpint(count, ==, 3);
+
+	/* trie must follow command_remove() */
+	g_assert_cmpint(command_remove(NULL, "chkcmd:alphabet"), ==, 0);
+	g_assert_cmpint(command_lookup(NULL, 0, "chkcmd:alpha", 12, &c, NULL), ==, 1);
+	g_assert(c == alpha);
+	g_assert_cmpint(command_lookup(NULL, 0, "chkcmd:alphab", 13, NULL, NULL), ==, 0);
+
+	command_remove(NULL, "chkcmd:alpha");
+	command_remove(NULL, "chkcmd:beta");
+	g_assert_cmpint(command_lookup("chkcmd:", 7, "", 0, NULL, NULL), ==, 0);
+}
+
+void add_commands_tests(void) {
+	g_test_add_func("/commands/command_lookup()", check_command_lookup);
+}
@@ -0,0 +1,83 @@
+#include "ekg2.h"
+
+#include <string.h>
+
+struct check_debug_lines {
+	guint32	first;
+	int	count;
+	GString	*last;
+	int	last_level;
+};
+
+static void check_debug_collect(guint32 seq, int level, time_t ts, const char *line, void *data) {
+	struct check_debug_lines *l = data;
+
+	if (!l->count)
+		l->first = seq;
+	l->count++;
+	g_string_assign(l->last, line);
+	l->last_level = level;
+}
+
+static void check_debug_ring(void) {
+	struct check_debug_lines l = { 0, 0, g_string_new(NULL), 0 };
+	GString *longline = g_string_new(NULL);
+	guint32 start;
+	int i;
+
+	debug_ring_clear();
+	start = debug_ring_seq();
+
+	/* line spanning a few records comes back in one piece */
+	for (i = 0; i < DEBUG_RECORD_TEXT * 3 + 10; i++)
+		g_string_append_c(longline, 'a' + i % 26);
+	debug_ring_add(DEBUG_ERROR, longline->str);
+
+	debug_ring_foreach(start, check_debug_collect, &l);
+	g_assert_cmpint(l.count, ==, 1);
+	g_assert_cmpint(l.last_level, ==, DEBUG_ERROR);
+	g_assert_cmpstr(l.last->str, ==, longline->str);
+
+	/* after wrapping over its first two records, the long line is skipped */
+	for (i = 0; i < DEBUG_RING_RECORDS - 3; i++)
+		debug_ring_add(0, "x");
+	debug_ring_add(DEBUG_OK, "last");
+
+	l.count = 0;
+	debug_ring_foreach(start, check_debug_collect, &l);
+	g_assert_cmpint(l.count, ==, DEBUG_RING_RECORDS - 2);
+	g_assert_cmpint(l.first, ==, start + 2);
+	g_assert_cmpstr(l.last->str, ==, "last");
+
+	/* only lines newer than 'after' */
+	l.count = 0;
+	debug_ring_foreach(debug_ring_seq() - 1, check_debug_collect, &l);
+	g_assert_cmpint(l.count, ==, 1);
+	g_assert_cmpint(l.last_level, ==, DEBUG_OK);
+
+	g_string_free(longline, TRUE);
+	g_string_free(l.last, TRUE);
+}
+
+static void check_debug_levels(void) {
+	int old_debug = config_debug, old_levels = config_debug_levels;
+	guint32 seq;
+
+	config_debug = 1;
+	config_debug_levels = DEBUG_LEVELS_ALL & ~DEBUG_LEVEL_BIT(DEBUG_IO);
+
+	seq = debug_ring_seq();
+	debug_io("masked %d\n", 1);
+	g_assert_cmpint(debug_ring_seq(), ==, seq);
+
+	debug_error("not masked %d\n", 2);
+	g_assert_cmpint(debug_ring_seq(), ==, seq + 1);
+
+	config_debug = old_debug;
+	config_debug_levels = old_levels;
+}
+
+void add_debug_tests(void) {
+	g_test_add_func("/debug/ring", check_debug_ring);
+	g_test_add_func("/debug/levels", check_debug_levels);
+}
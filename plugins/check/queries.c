@@ -0,0 +1,96 @@
+#include "ekg2.h"
+
+static int check_query_calls;
+static query_t *check_query_second;
+
+static QUERY(check_query_first_handler) {
+	int *arg = va_arg(ap, int *);
+
+	g_assert_cmpint(*arg, ==, 42);
+	check_query_calls++;
+
+	/* freeing next handler during emit must not call it */
+	if (check_query_second) {
+		query_free(check_query_second);
+		check_query_second = NULL;
+	}
+	return 0;
+}
+
+static QUERY(check_query_second_handler) {
+	check_query_calls += 100;
+	return 0;
+}
+
+static void check_query_emit_id(void) {
+	query_id_t id = query_id("check-query");
+	query_t *first;
+	int arg = 42;
+
+	query_register("check-query", QUERY_ARG_INT, QUERY_ARG_END);
+	g_assert(id != QUERY_ID_INVALID);
+	g_assert_cmpint(query_id("check-query"), ==, id);
+	g_assert_cmpint(query_emit_id(NULL, id, &arg), ==, -2);
+
+	first = query_connect(NULL, "check-query", check_query_first_handler, NULL);
+	check_query_calls = 0;
+	g_assert_cmpint(query_emit(NULL, "check-query", &arg), ==, 0);
+	g_assert_cmpint(query_emit_id(NULL, id, &arg), ==, 0);
+	g_assert_cmpint(check_query_calls, ==, 2);
+
+	check_query_second = query_connect(NULL, "check-query", check_query_second_handler, NULL);
+	check_query_calls = 0;
+	query_emit_id(NULL, id, &arg);
+	g_assert_cmpint(check_query_calls, ==, 1);
+	query_emit_id(NULL, id, &arg);
+	g_assert_cmpint(check_query_calls, ==, 2);
+
+	query_free(first);
+	g_assert_cmpint(query_emit_id(NULL, id, &arg), ==, -2);
+	g_assert_cmpint(query_emit(NULL, "check-query-unknown", &arg), ==, -2);
+}
+
+static QUERY(check_query_deferred_handler) {
+	check_query_calls++;
+	return 0;
+}
+
+static void check_query_deferred(void) {
+	static const query_def_t def = { NULL, "check-query-deferred", 0, { QUERY_ARG_END }, QUERY_DEFERRABLE };
+	query_id_t id;
+	query_t *q;
+	guint merged;
+
+	query_register_const(&def);
+	id = query_id("check-query-deferred");
+	q = query_connect(NULL, "check-query-deferred", check_query_deferred_handler, NULL);
+	merged = query_deferred_merged(id);
+
+	check_query_calls = 0;
+	query_emit(NULL, "check-query-deferred");
+	query_emit(NULL, "check-query-deferred");
+	query_emit_id(NULL, id);
+	g_assert_cmpint(check_query_calls, ==, 0);
+
+	query_deferred_flush();
+	g_assert_cmpint(check_query_calls, ==, 1);
+	g_assert_cmpuint(query_deferred_merged(id), ==, merged + 2);
+
+	/* nothing pending, nothing emitted */
+	query_deferred_flush();
+	g_assert_cmpint(check_query_calls, ==, 1);
+
+	/* from main loop */
+	query_emit(NULL, "check-query-deferred");
+	query_emit(NULL, "check-query-deferred");
+	while (g_main_context_iteration(NULL, FALSE))
+		;
+	g_assert_cmpint(check_query_calls, ==, 2);
+
+	query_free(q);
+}
+
+void add_queries_tests(void) {
+	g_test_add_func("/queries/query_emit_id()", check_query_emit_id);
+	g_test_add_func("/queries/deferred", check_query_deferred);
+}
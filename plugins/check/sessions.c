@@ -0,0 +1,78 @@
+#include "ekg2.h"
+
+static plugins_params_t check_session_vars[] = {
+	PLUGIN_VAR_ADD("auto_away",		VAR_INT, "600", 0, NULL),
+	PLUGIN_VAR_ADD("display_notify",	VAR_INT, NULL, 0, NULL),
+	PLUGIN_VAR_ADD("log_formats",		VAR_STR, "xml", 0, NULL),
+	PLUGIN_VAR_END()
+};
+
+static plugin_t check_session_plugin = {
+	.name = "checksess",
+	.pclass = PLUGIN_PROTOCOL,
+	.params = check_session_vars
+};
+
+static QUERY(check_session_validate_uid) {
+	char	*uid	= *(va_arg(ap, char **));
+	int	*valid	= va_arg(ap, int *);
+
+	if (uid && !xstrncmp(uid, "checksess:", 10)) {
+		(*valid)++;
+		return -1;
+	}
+	return 0;
+}
+
+static void check_session_slots(void) {
+	session_slot_t auto_away, notify, formats, alias, unknown;
+	session_t *s;
+
+	auto_away	= session_slot("auto_away");
+	notify		= session_slot("display_notify");
+	formats		= session_slot("log_formats");
+	alias		= session_slot("alias");
+	unknown		= session_slot("check_local_var");
+
+	g_assert_cmpint(auto_away, >, 0);
+	g_assert_cmpint(session_slot("AUTO_AWAY"), ==, auto_away);
+	g_assert_cmpint(notify, !=, auto_away);
+
+	plugin_register(&check_session_plugin, -254);
+	query_connect(&check_session_plugin, "protocol-validate-uid", check_session_validate_uid, NULL);
+
+	s = session_add("checksess:test");
+	g_assert(s);
+
+	g_assert_cmpint(session_slot_int_get(s, auto_away), ==, 600);
+	g_assert_cmpint(session_slot_int_get(s, notify), ==, -1);
+	g_assert_cmpstr(session_slot_get(s, formats), ==, "xml");
+
+	/* cached values must follow session_set() */
+	session_int_set(s, "auto_away", 30);
+	session_set(s, "display_notify", "2");
+	g_assert_cmpint(session_slot_int_get(s, auto_away), ==, 30);
+	g_assert_cmpint(session_slot_int_get(s, notify), ==, 2);
+	session_set(s, "display_notify", NULL);
+	g_assert_cmpint(session_slot_int_get(s, notify), ==, -1);
+	g_assert_cmpint(session_slot_int_get(s, auto_away), ==, session_int_get(s, "auto_away"));
+
+	/* builtin and local variables fall back to session_get() */
+	session_set(s, "alias", "chk");
+	g_assert_cmpstr(session_slot_get(s, alias), ==, "chk");
+	g_assert(session_slot_get(s, unknown) == NULL);
+	session_set(s, "check_local_var", "12");
+	g_assert_cmpint(session_slot_int_get(s, unknown), ==, 12);
+
+	g_assert(session_slot_get(NULL, auto_away) == NULL);
+	g_assert_cmpint(session_slot_int_get(NULL, auto_away), ==, -1);
+	g_assert_cmpint(session_slot_int_get(s, 0), ==, -1);
+
+	session_remove("checksess:test");
+	plugin_unregister(&check_session_plugin);
+	g_assert(check_session_plugin.session_slots == NULL);
+}
+
+void add_sessions_tests(void) {
+	g_test_add_func("/sessions/session_slot()", check_session_slots);
+}
@@ -0,0 +1,42 @@
+#include "ekg2.h"
+
+#include <string.h>
+
+static void check_format_expand(const char *expected, char *result) {
+	g_assert_cmpstr(result, ==, expected);
+	xfree(result);
+}
+
+static void check_format_string(void) {
+	check_format_expand("%1 % x", format_string("\\%1 %% %1", "x"));
+	check_format_expand("ab   |", format_string("%[5]1|", "ab"));
+	check_format_expand("   ab", format_string("%[-5]1", "ab"));
+	check_format_expand("007", format_string("%[.-3]1", "7"));
+	check_format_expand("  ab  ", format_string("%[^6]1", "ab"));
+	check_format_expand("abcd", format_string("%(2)1", "abcd"));
+	check_format_expand("a y", format_string("%@1 %@2", "Ala", "Jan"));
+	check_format_expand("A!", format_string("%{1ab23}X!", "a", "A", "B"));
+	check_format_expand("B!", format_string("%{1ab23}X!", "b", "A", "B"));
+	check_format_expand("!", format_string("%{1ab23}X!", "c", "A", "B"));
+}
+
+static void check_format_cache(void) {
+	format_add("check_format", "<%1>", 1);
+	check_format_expand("<x>", format_string(format_find("check_format"), "x"));
+	check_format_expand("<y>", format_string(format_find("check_format"), "y"));
+
+	format_add("check_format", "[%1]", 0);
+	check_format_expand("<x>", format_string(format_find("check_format"), "x"));
+
+	format_add("check_format", "[%1]", 1);
+	check_format_expand("[x]", format_string(format_find("check_format"), "x"));
+
+	g_assert_cmpstr(format_find("check_format_missing"), ==, "");
+	format_add("check_format_missing", "%1", 1);
+	g_assert_cmpstr(format_find("check_format_missing"), ==, "%1");
+}
+
+void add_themes_tests(void) {
+	g_test_add_func("/themes/format_string()", check_format_string);
+	g_test_add_func("/themes/format_find() & format_add()", check_format_cache);
+}
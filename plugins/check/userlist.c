@@ -0,0 +1,156 @@
+#include "ekg2.h"
+
+static void check_userlist_find(void) {
+	userlist_t *list = NULL;
+	userlist_t *a, *b, *c, *d;
+
+	a = userlist_add_u(&list, "xmpp:alice@example.org", "Alice");
+	b = userlist_add_u(&list, "irc:Bob", NULL);
+	c = userlist_add_u(&list, "xmpp:room@conf.example.org/carol", "carol");
+	d = userlist_add_u(&list, "xmpp:dave@example.org", "alice");
+
+	g_assert(userlist_find_u(&list, "XMPP:Alice@Example.ORG") == a);
+	g_assert(userlist_find_u(&list, "irc:bob") == b);
+	g_assert(userlist_find_u(&list, "CAROL") == c);
+	g_assert(userlist_find_u(&list, "xmpp:alice@example.org/laptop") == a);
+	g_assert(userlist_find_u(&list, "xmpp:room@conf.example.org/carol") == c);
+	g_assert(userlist_find_u(&list, "xmpp:room@conf.example.org/eve") == c);
+	g_assert(userlist_find_u(&list, "irc:bob/x") == NULL);
+	g_assert(userlist_find_u(&list, "nobody") == NULL);
+
+	/* both a and d are known as 'alice', removing one must keep the other */
+	g_assert(userlist_find_u(&list, "alice") != NULL);
+	userlist_remove_u(&list, a);
+	g_assert(userlist_find_u(&list, "alice") == d);
+	g_assert(userlist_find_u(&list, "xmpp:alice@example.org") == NULL);
+
+	userlists_destroy(&list);
+	g_assert(list == NULL);
+	g_assert(userlist_find_u(&list, "alice") == NULL);
+}
+
+static void check_userlist_find_order(void) {
+	userlist_t *list = NULL;
+	userlist_t *bob, *carl, *dup1, *dup2, *u;
+
+	/* carl's nickname is bob's uid, and list is sorted by nickname, so carl comes first */
+	bob	= userlist_add_u(&list, "irc:bob", "zzz");
+	carl	= userlist_add_u(&list, "irc:carl", "irc:bob");
+	g_assert(list == carl);
+
+	g_assert(userlist_find_u(&list, "irc:bob") == carl);
+	g_assert(userlist_find_u(&list, "zzz") == bob);
+	g_assert(userlist_find_u(&list, "irc:carl") == carl);
+
+	userlist_remove_u(&list, carl);
+	g_assert(userlist_find_u(&list, "irc:bob") == bob);
+
+	/* duplicated nicknames, the first one in list wins */
+	dup1	= userlist_add_u(&list, "irc:dup1", "dup");
+	dup2	= userlist_add_u(&list, "irc:dup2", "dup");
+	for (u = list; u != dup1 && u != dup2; u = u->next)
+		;
+	g_assert(userlist_find_u(&list, "dup") == u);
+
+	userlists_destroy(&list);
+}
+
+static void check_userlist_rename(void) {
+	userlist_t *list = NULL;
+	userlist_t *bob, *carl, *u;
+	int count = 0;
+
+	bob	= userlist_add_u(&list, "irc:bob", "bob");
+	carl	= userlist_add_u(&list, "irc:carl", "carl");
+	bob->status = EKG_STATUS_AVAIL;
+
+	g_assert_cmpint(userlist_rename_u(&list, bob, "irc:zed", "zed"), ==, 0);
+	g_assert(userlist_find_u(&list, "irc:zed") == bob);
+	g_assert(userlist_find_u(&list, "zed") == bob);
+	g_assert(userlist_find_u(&list, "irc:bob") == NULL);
+	g_assert(userlist_find_u(&list, "bob") == NULL);
+	g_assert_cmpint(bob->status, ==, EKG_STATUS_AVAIL);
+	g_assert(list == carl && carl->next == bob);
+
+	/* carl takes zed's nick, old entry of zed is stale and has to go */
+	g_assert_cmpint(userlist_rename_u(&list, carl, "irc:ZED", "ZED"), ==, 0);
+	g_assert(userlist_find_u(&list, "irc:zed") == carl);
+	g_assert(userlist_find_u(&list, "irc:carl") == NULL);
+	for (u = list; u; u = u->next)
+		count++;
+	g_assert_cmpint(count, ==, 1);
+
+	userlists_destroy(&list);
+}
+
+static void check_userlist_prefix_collect(userlist_t *u, void *data) {
+	GPtrArray *found = data;
+
+	g_ptr_array_add(found, u);
+}
+
+static void check_userlist_find_prefix(void) {
+	userlist_t *list = NULL;
+	userlist_t *anna, *annabel, *bob, *zenon;
+	GPtrArray *found = g_ptr_array_new();
+
+	bob	= userlist_add_u(&list, "irc:bob", "Bob");
+	annabel	= userlist_add_u(&list, "irc:annabel", "Annabel");
+	zenon	= userlist_add_u(&list, "irc:zenon", NULL);
+	anna	= userlist_add_u(&list, "irc:anna", "anna");
+
+	g_assert_cmpint(userlist_find_prefix(&list, "ANN", 3, 1, check_userlist_prefix_collect, found), ==, 2);
+	g_assert(found->pdata[0] == anna);
+	g_assert(found->pdata[1] == annabel);
+
+	/* only first len chars of prefix count */
+	g_ptr_array_set_size(found, 0);
+	g_assert_cmpint(userlist_find_prefix(&list, "bobby", 1, 1, check_userlist_prefix_collect, found), ==, 1);
+	g_assert(found->pdata[0] == bob);
+
+	/* entries without nickname are found only by uid */
+	g_assert_cmpint(userlist_find_prefix(&list, "z", 1, 1, check_userlist_prefix_collect, found), ==, 0);
+	g_assert_cmpint(userlist_find_prefix(&list, "irc:", 4, 0, check_userlist_prefix_collect, found), ==, 4);
+	g_assert_cmpint(userlist_find_prefix(&list, "", 0, 1, check_userlist_prefix_collect, found), ==, 3);
+
+	/* removed entries disappear from the sorted index */
+	userlist_remove_u(&list, anna);
+	g_ptr_array_set_size(found, 0);
+	g_assert_cmpint(userlist_find_prefix(&list, "anna", 4, 1, check_userlist_prefix_collect, found), ==, 1);
+	g_assert(found->pdata[0] == annabel);
+	g_assert_cmpint(userlist_find_prefix(&list, "irc:z", 5, 0, check_userlist_prefix_collect, found), ==, 1);
+	g_assert(found->pdata[1] == zenon);
+
+	userlists_destroy(&list);
+	g_ptr_array_free(found, TRUE);
+}
+
+static void check_userlist_ignore_level(void) {
+	userlist_t *list = NULL;
+	userlist_t *u = userlist_add_u(&list, "irc:mallory", "mallory");
+
+	g_assert_cmpint(ignored_check_u(u), ==, 0);
+	g_assert_cmpint(ignored_check_u(NULL), ==, 0);
+
+	ekg_group_add(u, "friends");
+	ekg_group_add(u, "__ignored_5");
+	g_assert_cmpint(ignored_check_u(u), ==, IGNORE_STATUS | IGNORE_MSG);
+
+	ekg_group_remove(u, "__ignored_5");
+	g_assert_cmpint(ignored_check_u(u), ==, 0);
+
+	ekg_group_add(u, "__ignored");
+	g_assert_cmpint(ignored_check_u(u), ==, IGNORE_ALL);
+	ekg_group_remove(u, "friends");
+	g_assert_cmpint(ignored_check_u(u), ==, IGNORE_ALL);
+
+	userlists_destroy(&list);
+}
+
+void add_userlist_tests(void) {
+	g_test_add_func("/userlist/userlist_find_u()", check_userlist_find);
+	g_test_add_func("/userlist/userlist_find_u() order", check_userlist_find_order);
+	g_test_add_func("/userlist/userlist_rename_u()", check_userlist_rename);
+	g_test_add_func("/userlist/userlist_find_prefix()", check_userlist_find_prefix);
+	g_test_add_func("/userlist/ignored_check_u()", check_userlist_ignore_level);
+}
@@ -0,0 +1,124 @@
+#include "ekg2.h"
+
+#include <string.h>
+#include <unistd.h>
+#include <errno.h>
+#include <fcntl.h>
+
+static GPtrArray *check_lines;
+static int check_lines_done;
+
+static WATCHER_LINE(check_line_handler) {
+	if (type) {
+		check_lines_done = 1;
+		return 0;
+	}
+
+	g_ptr_array_add(check_lines, g_strdup(watch));
+	return 0;
+}
+
+static void check_watch_read_line(void) {
+	static const char *expected[] = { "first", "", "second\r", "\r", "x", "last" };
+	GString *data = g_string_new(NULL);
+	int fds[2];
+	guint i;
+
+	g_assert(!pipe(fds));
+
+	check_lines = g_ptr_array_new_with_free_func(g_free);
+	check_lines_done = 0;
+	watch_add(NULL, fds[0], WATCH_READ_LINE, (watcher_handler_func_t *) check_line_handler, NULL);
+
+	/* one \r is stripped from the end of lines longer than 1, empty lines are passed too */
+	g_string_append(data, "first\r\n\nsecond\r\r\n\r\nx\n");
+	/* long line, split between many reads */
+	for (i = 0; i < 5000; i++)
+		g_string_append(data, "0123456789");
+	g_string_append_c(data, '\n');
+	/* last one without \n, passed on EOF */
+	g_string_append(data, "last");
+
+	g_assert_cmpint(write(fds[1], data->str, data->len), ==, data->len);
+	close(fds[1]);
+
+	while (!check_lines_done)
+		g_main_context_iteration(NULL, TRUE);
+
+	g_assert_cmpuint(check_lines->len, ==, G_N_ELEMENTS(expected) + 1);
+	for (i = 0; i < 5; i++)
+		g_assert_cmpstr(g_ptr_array_index(check_lines, i), ==, expected[i]);
+	g_assert_cmpuint(strlen(g_ptr_array_index(check_lines, 5)), ==, 50000);
+	g_assert_cmpstr(g_ptr_array_index(check_lines, 6), ==, expected[5]);
+
+	close(fds[0]);
+	g_ptr_array_free(check_lines, TRUE);
+	g_string_free(data, TRUE);
+}
+
+static void check_watch_write_line(void) {
+	GString *data = g_string_new(NULL);
+	GString *got = g_string_new(NULL);
+	watch_chunk_t *c;
+	char buf[4096];
+	gsize filled = 0;
+	int fds[2];
+	watch_t *w;
+	int i, ret;
+
+	g_assert(!pipe(fds));
+	fcntl(fds[0], F_SETFL, O_NONBLOCK);
+	fcntl(fds[1], F_SETFL, O_NONBLOCK);
+
+	/* fill the pipe, so everything written later has to be queued */
+	memset(buf, 'f', sizeof(buf));
+	while ((ret = write(fds[1], buf, sizeof(buf))) > 0)
+		filled += ret;
+	g_assert(errno == EAGAIN);
+
+	w = watch_add(NULL, fds[1], WATCH_WRITE_LINE, NULL, NULL);
+	watch_set_watermarks(w, 1000, 10000);
+	g_assert_cmpint(watch_writable(w), ==, 1);
+
+	/* many small writes, merged into chunks */
+	for (i = 0; i < 1000; i++) {
+		g_assert(!watch_write(w, "line %d\n", i));
+		g_string_append_printf(data, "line %d\n", i);
+	}
+	g_assert_cmpint(watch_writable(w), ==, 0);
+
+	/* shared chunk, queued twice, and one bigger than pooled chunks */
+	c = watch_chunk_new("shared\n", 7);
+	g_assert(!watch_write_chunk(w, c));
+	g_assert(!watch_write_chunk(w, c));
+	watch_chunk_unref(c);
+	g_string_append(data, "shared\nshared\n");
+
+	for (i = 0; i < 3 * 4096; i++)
+		g_string_append_c(data, 'a' + i % 26);
+	g_assert(!watch_write_data(w, data->str + data->len - 3 * 4096, 3 * 4096));
+
+	g_assert_cmpuint(watch_queued(w), ==, data->len);
+
+	while (got->len < filled + data->len) {
+		while ((ret = read(fds[0], buf, sizeof(buf))) > 0)
+			g_string_append_len(got, buf, ret);
+		g_main_context_iteration(NULL, FALSE);
+	}
+
+	g_assert_cmpuint(watch_queued(w), ==, 0);
+	g_assert_cmpint(watch_writable(w), ==, 1);
+	g_assert(!memcmp(got->str + filled, data->str, data->len));
+
+	w->type = WATCH_NONE;
+	watch_free(w);
+	close(fds[0]);
+	close(fds[1]);
+	g_string_free(data, TRUE);
+	g_string_free(got, TRUE);
+}
+
+void add_watches_tests(void) {
+	g_test_add_func("/watches/WATCH_READ_LINE", check_watch_read_line);
+	g_test_add_func("/watches/WATCH_WRITE_LINE", check_watch_write_line);
+}
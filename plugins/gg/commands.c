@@ -1688,6 +1688,7 @@ static COMMAND(gg_command_modify) {
 
 			xfree((void *) u->uid);
 			u->uid = tmp1;
+			userlist_replace(session, u);
 
 			modified = 1;
 			continue;
@@ -49,9 +49,15 @@ typedef struct {
 	int margin_left, margin_right, margin_top, margin_bottom;
 	fstring_t **backlog;
 	int backlog_size;
+	int backlog_alloc;
+	int backlog_head;
+	unsigned int backlog_seq;
+	unsigned int backlog_gen;
 	int redraw;
 	int start;
 	int lines_count;
+	int lines_alloc;
+	int lines_first;
 	void **lines;
 	int overflow;
 	int (*handle_redraw)(window_t *w);
@@ -672,7 +678,7 @@ WATCHER(http_watch_read) {
 					/* really, really stupid... */
 					string_append(htheader, "ch = document.createElement('li');\n"
 							"ch.setAttribute('id', 'lin'+i);\n");
-					tempdata = http_fstring(w2->id, "ch", n->backlog[i]);
+					tempdata = http_fstring(w2->id, "ch", n->backlog[(n->backlog_head + n->backlog_alloc - i) % n->backlog_alloc]);
 					string_append(htheader, tempdata);
 					if (j^=1)
 						string_append(htheader, "ch.className='info1';");
@@ -818,14 +818,20 @@ static COMMAND(irc_command_quote) {
 
 static COMMAND(irc_command_pipl) {
 	irc_private_t	*j = irc_private(session);
-	list_t		t1, t2;
+	GHashTableIter	iter;
+	gpointer	value;
+	list_t		t2;
 	people_t	*per;
 	people_chan_t	*chan;
 
 	debug_white("[irc] this is a secret command ;-)\n");
 
-	for (t1 = j->people; t1; t1=t1->next) {
-		per = (people_t *)t1->data;
+	if (!j->people)
+		return 0;
+
+	g_hash_table_iter_init(&iter, j->people);
+	while (g_hash_table_iter_next(&iter, NULL, &value)) {
+		per = (people_t *)value;
 		debug("(%s)![%s]@{%s} ", per->nick, per->ident, per->host);
 		for (t2 = per->channels; t2; t2=t2->next)
 		{
@@ -881,15 +887,11 @@ static COMMAND(irc_command_alist) {
 		}
 
 		if (!xstrncmp(params[1], "irc:", 4)) {	/* nickname */
-			list_t l;
-			for (l = j->people; l; l = l->next) {
-				people_t *per = l->data;
-
-				if (!xstrcmp(per->nick+4, params[1]+4)) {
-					/* XXX, here generate mask */
-					mask = saprintf("%s!%s@%s", per->nick+4, per->ident, per->host);
-					break;
-				}
+			people_t *per;
+
+			if ((per = irc_find_person(j, j->people, (char *) params[1]+4))) {
+				/* XXX, here generate mask */
+				mask = saprintf("%s!%s@%s", per->nick+4, per->ident, per->host);
 			}
 
 			if (!mask) {
@@ -928,7 +930,10 @@ static COMMAND(irc_command_alist) {
 					else printq("irc_access_invalid_flag", value);
 				}
 				g_strfreev(arr);
-			} else u->groups = group_init(irc_config_default_access_groups);
+			} else {
+				u->groups = group_init(irc_config_default_access_groups);
+				ignored_update(u);
+			}
 			xfree(tmp);
 		}
 
@@ -37,7 +37,7 @@ typedef struct _irc_private_t {
 	char *nick;			/* guess again ? ;> */
 	char *host_ident;		/* ident+host */
 
-	list_t people;			/* list of people_t */
+	GHashTable *people;		/* people_t, keyed by irc_nick_key() */
 	list_t channels;		/* list of people_chan_t */
 	list_t hilights;
 
@@ -94,7 +94,7 @@ typedef struct {
 	int		mode;
 	char		*topic, *topicby, *mode_str;
 	window_t	*window;
-	list_t		onchan;
+	GHashTable	*onchan;	/* people_t, keyed by irc_nick_key() */
 	char		*nickpad_str;
 	int		nickpad_len, nickpad_pos;
 	int		longest_nick;
@@ -134,6 +134,7 @@ enum { IRC_GC_CHAN=0, IRC_GC_NOT_CHAN, IRC_GC_ANY };
 #define irc_write(s, args...) ekg_connection_write(irc_private(s)->send_stream, args)
 
 int irc_parse_line(session_t *s, const char *l, int fd);	/* misc.c */
+char *irc_tolower_int(char *buf, int casemapping);		/* misc.c */
 
 extern int irc_config_allow_fake_contacts;
 extern int irc_config_clean_channel_name;
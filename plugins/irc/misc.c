@@ -280,7 +280,7 @@ static int gatoi(char *buf, int *a) {
  * @return	pointer to beginning of a string
  */
 
-static char *irc_tolower_int(char *buf, int casemapping)
+char *irc_tolower_int(char *buf, int casemapping)
 {
 	char *p = buf;
 	int upper_bound;
@@ -444,7 +444,7 @@ and the prefix.
 
 IRC_COMMAND(irc_c_init)
 {
-	int		i, k;
+	int		i, k, casemapping = j->casemapping;
 	char		*t;
 	switch (irccommands[ecode].num)
 	{
@@ -462,6 +462,8 @@ IRC_COMMAND(irc_c_init)
 			j->autoreconnecting = 0;
 
 			j->casemapping = IRC_CASEMAPPING_RFC1459;
+			if (j->casemapping != casemapping)
+				irc_people_rekey(s, j);
 			xfree(SOP(_005_PREFIX));
 			SOP(_005_PREFIX) = xstrdup("(ov)@+");
 			j->nick_signs = SOP(_005_PREFIX) + 4;
@@ -522,6 +524,8 @@ IRC_COMMAND(irc_c_init)
 						}
 					}
 			}
+			if (j->casemapping != casemapping)
+				irc_people_rekey(s, j);
 
 			k = (xstrlen(SOP(_005_PREFIX))>>1) - 1;
 			j->nick_signs = SOP(_005_PREFIX) + k + 2;
@@ -41,9 +41,117 @@ static LIST_FREE_ITEM(list_irc_channel_free, channel_t *) {
 	xfree(data->topicby);
 	xfree(data->mode_str);
 	list_destroy(data->banlist, 1);
+	if (data->onchan)
+		g_hash_table_destroy(data->onchan);
 	xfree(data);
 }
 
+/* irc_nick_key()
+ *
+ * returns key, under which nick is stored in priv_data->people
+ * and channel->onchan: nick lowercased according to casemapping
+ * used by server.
+ *
+ * @param nick - nickname of user without <em>'irc:'</em> prefix
+ *   and without '@%+' prefix
+ *
+ * @return allocated string, which should be freed
+ */
+static char *irc_nick_key(irc_private_t *j, const char *nick)
+{
+	char *key = xstrdup(nick);
+
+	irc_tolower_int(key, j->casemapping);
+	return key;
+}
+
+static GHashTable *irc_people_new(void)
+{
+	return g_hash_table_new_full(g_str_hash, g_str_equal, xfree, (GDestroyNotify) list_irc_people_free);
+}
+
+static GHashTable *irc_onchan_new(void)
+{
+	return g_hash_table_new_full(g_str_hash, g_str_equal, xfree, NULL);
+}
+
+/* irc_people_rekey()
+ *
+ * rebuilds priv_data->people and channel->onchan tables,
+ * it must be called when server changes casemapping
+ */
+void irc_people_rekey(session_t *s, irc_private_t *j)
+{
+	GHashTableIter iter;
+	gpointer value;
+	GHashTable *old_people = NULL;
+	list_t l;
+
+	if (j->people) {
+		GHashTable *people = irc_people_new();
+
+		g_hash_table_iter_init(&iter, j->people);
+		while (g_hash_table_iter_next(&iter, NULL, &value)) {
+			people_t *per = value;
+			char *key = irc_nick_key(j, per->nick+4);
+
+			if (g_hash_table_lookup(people, key)) {
+				/* left in old_people, and dropped below */
+				debug_error("[irc] people_rekey() %s collides with other nick\n", per->nick);
+				xfree(key);
+				continue;
+			}
+			g_hash_table_insert(people, key, per);
+			g_hash_table_iter_steal(&iter);
+		}
+		old_people = j->people;
+		j->people = people;
+	}
+
+	for (l = j->channels; l; l = l->next) {
+		channel_t *chan = l->data;
+		GHashTable *onchan;
+
+		if (!chan->onchan)
+			continue;
+
+		onchan = irc_onchan_new();
+		g_hash_table_iter_init(&iter, chan->onchan);
+		while (g_hash_table_iter_next(&iter, NULL, &value)) {
+			char *key = irc_nick_key(j, ((people_t *) value)->nick+4);
+
+			/* person dropped because of collision */
+			if (g_hash_table_lookup(j->people, key) != value) {
+				xfree(key);
+				continue;
+			}
+			g_hash_table_replace(onchan, key, value);
+		}
+
+		g_hash_table_destroy(chan->onchan);
+		chan->onchan = onchan;
+	}
+
+	if (old_people) {
+		g_hash_table_iter_init(&iter, old_people);
+		while (g_hash_table_iter_next(&iter, NULL, &value)) {
+			people_t *per = value;
+
+			/* and from nicklists of channel windows */
+			for (l = per->channels; l; l = l->next) {
+				window_t *w = window_find_s(s, ((people_chan_t *) l->data)->chanp->name);
+				userlist_t *u;
+
+				if (w && (u = userlist_find_u(&(w->userlist), per->nick)))
+					userlist_remove_u(&(w->userlist), u);
+			}
+			list_destroy(per->channels, 1);
+			per->channels = NULL;
+		}
+		g_hash_table_destroy(old_people);
+	}
+}
+
 /* add others
  */
 int irc_xstrcasecmp_default(char *str1, char *str2)
@@ -51,18 +159,19 @@ int irc_xstrcasecmp_default(char *str1, char *str2)
 	return xstrcasecmp(str1, str2);
 }
 
-/* this function searches for a given nickname on a given list
+/* this function searches for a given nickname in a given table,
+ * nicknames are compared using server casemapping
  * nick MUST BE without the 'irc:' prefix
  * nick can contain a mode prefix (one of): '@%+'
  *
- * list should be one of:
- *     priv_data->channels 
- *     priv_data->people->channels->onchan
+ * table should be one of:
+ *     priv_data->people
+ *     priv_data->channels->onchan
  */
-people_t *irc_find_person(irc_private_t *j, list_t p, char *nick)
+people_t *irc_find_person(irc_private_t *j, GHashTable *p, char *nick)
 {
-	int (*comp_func)(char *,char*);
 	people_t *person;
+	char *key;
 
 	if (!(nick && p)) return NULL;
 
@@ -72,15 +181,11 @@ people_t *irc_find_person(irc_private_t *j, list_t p, char *nick)
 
 	if (xstrchr(j->nick_signs, *nick)) nick++;
 
-	comp_func = irc_xstrcasecmp_default;
+	key = irc_nick_key(j, nick);
+	person = g_hash_table_lookup(p, key);
+	xfree(key);
 
-	for (; p; p=p->next)
-	{
-		person = (people_t *)(p->data);
-		if (person->nick && !comp_func(nick, person->nick+4))
-			return person;
-	}
-	return NULL;
+	return person;
 }
 
 /* p = priv_data->channel || */
@@ -130,11 +235,14 @@ people_chan_t *irc_find_person_chan(list_t p, char *channame)
  */
 static void update_longest_nick(channel_t *chan)
 {
-	list_t p;
+	GHashTableIter iter;
+	gpointer value;
+
 	chan->longest_nick = 0;
-	for (p=chan->onchan; p; p=p->next)
+	g_hash_table_iter_init(&iter, chan->onchan);
+	while (g_hash_table_iter_next(&iter, NULL, &value))
 	{
-		people_t *person = (people_t *)p->data;
+		people_t *person = (people_t *)value;
 		const gsize nicklen = g_utf8_strlen(person->nick+4, -1);
 		if (person->nick && nicklen > chan->longest_nick)
 			chan->longest_nick = nicklen;
@@ -161,12 +269,12 @@ static void update_longest_nick(channel_t *chan)
 static people_t *irc_add_person_int(session_t *s, irc_private_t *j,
 		char *nick, channel_t *chan)
 {
-	people_t *person, *peronchan;
+	people_t *person;
 	people_chan_t *pch_tmp;
 	userlist_t *ulist;
 	window_t *w;
 	int mode = 0, irccol = 0;
-	char *ircnick, *t;
+	char *ircnick, *key, *t;
 
 	if ((t = xstrchr(j->nick_signs, *nick)))
 		mode = 1 << (t - j->nick_signs);
@@ -184,20 +292,26 @@ static people_t *irc_add_person_int(session_t *s, irc_private_t *j,
 		irccol = irc_color_in_contacts(j, mode, ulist);
 	}
 
+	if (!j->people)
+		j->people = irc_people_new();
+	if (!chan->onchan)
+		chan->onchan = irc_onchan_new();
+
+	key = irc_nick_key(j, nick);
+
 	/* add entry in priv_data->people if nick's not yet there */
-	/* ok new irc-find-person checked */
-	if (!(person = irc_find_person(j, j->people, nick))) {
+	if (!(person = g_hash_table_lookup(j->people, key))) {
 	/*	debug("+%s lista ludzi, ", nick); */
 		person = xmalloc(sizeof(people_t));
 		person->nick = xstrdup(ircnick);
-		/* K&Rv2 5.4 */
-		list_add(&(j->people), person);
+		g_hash_table_insert(j->people, xstrdup(key), person);
 	}
 	/* add entry in priv_data->channels->onchan if nick's not yet there */
-	if (!(peronchan = irc_find_person(j, chan->onchan, nick)))  {
+	if (!g_hash_table_lookup(chan->onchan, key))  {
 	/*	debug("+do kanau, "); */
-		list_add(&(chan->onchan), person);
-	}
+		g_hash_table_insert(chan->onchan, key, person);
+	} else
+		xfree(key);
 	xfree(ircnick);
 
 	/* if channel's not yet on given user channels, add it to his channels */
@@ -293,6 +407,7 @@ static int irc_del_person_channel_int(session_t *s, irc_private_t *j, people_t *
 	userlist_t *ulist = NULL;
 	people_chan_t *tmp;
 	window_t *w;
+	char *key;
 
 	if (!nick || !chan) {
 		debug_error("programmer's mistake in call to irc_del_channel_int: nick: %s chan: %s\n", nick ? "OK" : "NULL", chan ? "OK" : "NULL");
@@ -315,18 +430,23 @@ static int irc_del_person_channel_int(session_t *s, irc_private_t *j, people_t *
 		debug("-lista kanaw usera, "); */
 		list_remove(&(nick->channels), tmp, 1);
 	}
+
+	key = irc_nick_key(j, nick->nick+4);
+
+	/* delete entry in priv_data->channels->onchan
+	debug("-z kanau\n"); */
+	if (chan->onchan)
+		g_hash_table_remove(chan->onchan, key);
+
 	if (!(nick->channels)) {
 	/* delete entry in priv_data->people 
 		debug("-%s lista ludzi, ", nick->nick); */
-		LIST_REMOVE(&(j->people), nick, list_irc_people_free);
-		
-		list_remove(&(chan->onchan), nick, 0);
+		g_hash_table_remove(j->people, key);
+		xfree(key);
 		return 1;
 	}
-	
-	/* delete entry in priv_data->channels->onchan
-	debug("-z kanau\n"); */
-	list_remove(&(chan->onchan), nick, 0);
+
+	xfree(key);
 	return 0;
 }
 
@@ -450,7 +570,6 @@ int irc_del_person(session_t *s, irc_private_t *j, char *nick,
 
 int irc_del_channel(session_t *s, irc_private_t *j, char *name)
 {
-	list_t p;
 	channel_t *chan;
 	char *tmp;
 	window_t *w;
@@ -459,9 +578,17 @@ int irc_del_channel(session_t *s, irc_private_t *j, char *name)
 		return -1;
 
 	debug_function("[irc]_del_channel() %s\n", name);
-	while ((p = (chan->onchan)))
-		if (!(p->data)) break;
-		else irc_del_person_channel_int(s, j, (people_t *)p->data, chan);
+	if (chan->onchan) {
+		GList *people = g_hash_table_get_values(chan->onchan);
+		GList *p;
+
+		for (p = people; p; p = p->next)
+			irc_del_person_channel_int(s, j, (people_t *)p->data, chan);
+		g_list_free(people);
+
+		g_hash_table_destroy(chan->onchan);
+		chan->onchan = NULL;
+	}
 
 	tmp = chan->name;	chan->name = NULL;
 	xfree(chan->topic);
@@ -506,6 +633,7 @@ channel_t *irc_add_channel(session_t *s, irc_private_t *j, char *name, window_t
 		p		= xmalloc(sizeof(channel_t));
 		p->name		= irc_uid(name);
 		p->window	= win;
+		p->onchan	= irc_onchan_new();
 		debug("[irc] add_channel() WINDOW %08X\n", win);
 		if (session_int_get(s, "auto_channel_sync") != 0)
 			irc_sync_channel(s, j, p);
@@ -545,6 +673,35 @@ int irc_nick_prefix(irc_private_t *j, people_chan_t *ch, int irc_color)
 	return 0;
 }
 		
+/* irc_drop_person()
+ *
+ * this is internal function, it forgets given person completely (all
+ * channels and priv_data->people). Used when someone takes nick, which
+ * we still think belongs to that person.
+ *
+ * @param s - current session structure
+ * @param j - irc priv_data structure of current session
+ * @param person - person to forget, it's freed
+ */
+static void irc_drop_person(session_t *s, irc_private_t *j, people_t *person)
+{
+	char *key;
+
+	while (person->channels) {
+		channel_t *chan = ((people_chan_t *) person->channels->data)->chanp;
+		int gone = irc_del_person_channel_int(s, j, person, chan);
+
+		update_longest_nick(chan);
+		if (gone)
+			return;
+	}
+
+	/* not on any channel, only in priv_data->people */
+	key = irc_nick_key(j, person->nick+4);
+	g_hash_table_remove(j->people, key);
+	xfree(key);
+}
+
 /* irc_nick_change()
  *
  * this is internal function called when give person changes nick
@@ -560,12 +717,13 @@ int irc_nick_prefix(irc_private_t *j, people_chan_t *ch, int irc_color)
  */
 int irc_nick_change(session_t *s, irc_private_t *j, char *old_nick, char *new_nick)
 {
-	userlist_t *ulist, *newul;
+	userlist_t *ulist;
 	list_t i;
 	userlist_t *ul;
-	people_t *per;
+	people_t *per, *other;
 	people_chan_t *pch;
 	window_t *w;
+	char *old_key, *new_key;
 	char *t1, *t2 = irc_uid(new_nick);
 
 	if (!(per = irc_find_person(j, j->people, old_nick))) {
@@ -574,6 +732,14 @@ int irc_nick_change(session_t *s, irc_private_t *j, char *old_nick, char *new_ni
 		return 0;
 	}
 
+	/* we've missed that previous owner of new_nick is gone, forget him
+	 * before anything, so he won't keep the key, which is per's now */
+	new_key = irc_nick_key(j, new_nick);
+	if ((other = g_hash_table_lookup(j->people, new_key)) && other != per) {
+		debug_error("irc_nick_change() %s already known, dropping stale entry\n", new_nick);
+		irc_drop_person(s, j, other);
+	}
+
 	for (ul=s->userlist; ul; ul = ul->next) {
 		userlist_t *u = ul;
 		ekg_resource_t *rl;
@@ -596,20 +762,36 @@ int irc_nick_change(session_t *s, irc_private_t *j, char *old_nick, char *new_ni
 		pch = (people_chan_t *)i->data;
 
 		w = window_find_s(s, pch->chanp->name);
-		if (w && (ulist = userlist_find_u(&(w->userlist), old_nick))) {
-			newul = userlist_add_u(&(w->userlist), t2, new_nick);
-			newul->status = ulist->status;
-			userlist_remove_u(&(w->userlist), ulist);
-			/* XXX dj, userlist_replace() */
-			/* GiM: Yes, I thought about doin' this 'in place'
-			 * but we would have to change position in userlist
-			 * to still keep it sorted, so I've chosen to do this
-			 * this way */
-		}
+		/* it also drops entry of stale owner of new_nick, if irc_drop_person() couldn't */
+		if (w && (ulist = userlist_find_u(&(w->userlist), old_nick)))
+			userlist_rename_u(&(w->userlist), ulist, t2, new_nick);
 	}
 	query_emit(NULL, "userlist-refresh");
 
 	/* update nickname in internal structures */
+	old_key = irc_nick_key(j, per->nick+4);
+
+	{
+		gpointer orig_key;
+
+		if (g_hash_table_lookup_extended(j->people, old_key, &orig_key, NULL)) {
+			g_hash_table_steal(j->people, old_key);
+			xfree(orig_key);
+		}
+		g_hash_table_insert(j->people, xstrdup(new_key), per);
+
+		/* only channels, which this person is on */
+		for (i=per->channels; i; i=i->next)
+		{
+			channel_t *chan = ((people_chan_t *)i->data)->chanp;
+
+			g_hash_table_remove(chan->onchan, old_key);
+			g_hash_table_insert(chan->onchan, xstrdup(new_key), per);
+		}
+	}
+	xfree(old_key);
+	xfree(new_key);
+
 	t1 = per->nick;
 	per->nick = t2;
 
@@ -634,21 +816,27 @@ int irc_nick_change(session_t *s, irc_private_t *j, char *old_nick, char *new_ni
 /* GiM: nope, people will never be free ;/ */
 int irc_free_people(session_t *s, irc_private_t *j)
 {
+	GHashTableIter iter;
+	gpointer value;
 	list_t t1;
 	people_t *per;
 	channel_t *chan;
 	window_t *w;
 
 	debug_function("[irc] free_people() %08X %s\n", s, s->uid);
-	for (t1=j->people; t1; t1=t1->next) {
-		per = (people_t *)t1->data;
-		list_destroy(per->channels, 1);
-		per->channels=NULL;
+	if (j->people) {
+		g_hash_table_iter_init(&iter, j->people);
+		while (g_hash_table_iter_next(&iter, NULL, &value)) {
+			per = (people_t *)value;
+			list_destroy(per->channels, 1);
+			per->channels=NULL;
+		}
 	}
 
 	for (t1=j->channels; t1; t1=t1->next) {
 		chan = (channel_t *)t1->data;
-		list_destroy(chan->onchan, 0);
+		if (chan->onchan)
+			g_hash_table_destroy(chan->onchan);
 		chan->onchan = NULL;
 
 		/* GiM: check if window isn't allready destroyed */
@@ -660,7 +848,8 @@ int irc_free_people(session_t *s, irc_private_t *j)
 		 */
 	}
 
-	LIST_DESTROY(j->people, list_irc_people_free);
+	if (j->people)
+		g_hash_table_destroy(j->people);
 	j->people = NULL;
 
 	LIST_DESTROY(j->channels, list_irc_channel_free);
@@ -20,7 +20,7 @@
 
 #include "irc.h"
 
-people_t *irc_find_person(irc_private_t *j, list_t p, char *nick);
+people_t *irc_find_person(irc_private_t *j, GHashTable *p, char *nick);
 channel_t *irc_find_channel(list_t p, char *channame);
 people_chan_t *irc_find_person_chan(list_t p, char *channame);
 
@@ -47,6 +47,8 @@ int irc_color_in_contacts(irc_private_t *j, int mode, userlist_t *ul);
 
 /* clean up */
 int irc_free_people(session_t *s, irc_private_t *j);
+/* server changed casemapping */
+void irc_people_rekey(session_t *s, irc_private_t *j);
 
 #endif
 
@@ -63,6 +63,8 @@ SSL_CTX *jabberSslCtx;
 char *jabber_default_search_server = NULL;
 char *jabber_default_pubsub_server = NULL;
 int config_jabber_beep_mail = 0;
+
+session_slot_t jabber_slot_allow_add_reply_id, jabber_slot_auto_auth, jabber_slot_display_ctcp;
 int config_jabber_disable_chatstates = EKG_CHATSTATE_ACTIVE | EKG_CHATSTATE_GONE;
 const char *jabber_authtypes[] = { "none", "from", "to", "both" };
 
@@ -153,6 +155,10 @@ static QUERY(jabber_session_deinit) {
 
 	if (j->parser)
 		XML_ParserFree(j->parser);
+	xmlnode_arena_free(j);
+#ifdef HAVE_LIBZ
+	jabber_zlib_free(j);
+#endif
 	jabber_bookmarks_free(j);
 	jabber_privacy_free(j);
 	jabber_iq_stanza_free(j);
@@ -401,6 +407,9 @@ void jabber_handle_disconnect(session_t *s, const char *reason, int type) {
 	watch_remove(&jabber_plugin, j->fd, WATCH_READ);
 
 	j->using_compress = JABBER_COMPRESSION_NONE;
+#ifdef HAVE_LIBZ
+	jabber_zlib_free(j);
+#endif
 #ifdef JABBER_HAVE_SSL
 	if (j->using_ssl && j->ssl_session)
 		SSL_BYE(j->ssl_session);
@@ -422,6 +431,7 @@ void jabber_handle_disconnect(session_t *s, const char *reason, int type) {
 	if (j->parser)
 		XML_ParserFree(j->parser);
 	j->parser = NULL;
+	j->node = NULL;		/* unfinished stanza, its memory is reused after next one */
 
 	{
 		window_t *wl;
@@ -510,49 +520,7 @@ static void xmlnode_handle_start(void *data, const char *name, const char **atts
 		jabber_iq_auth_send(s, username, passwd, jabber_attr((char **) atts, j->istlen ? "i" : "id"));
 		xfree(username);
 	} else {
-		xmlnode_t *n, *newnode;
-		int arrcount, i;
-
-		newnode = xmalloc(sizeof(xmlnode_t));
-
-		{		/* get the namespace */
-			char *x		= NULL;
-			char *tmp	= xstrdup(name);
-			char *sep	= xstrchr(tmp, '\033');
-			if (sep) {
-				*sep	= '\0';
-				name	= ++sep;
-				x	= tmp;
-			}
-
-			newnode->name = xstrdup(name);
-			newnode->xmlns = xstrdup(x);
-			xfree(tmp);
-		}
-
-		if ((n = j->node)) {
-			newnode->parent = n;
-
-			if (!n->children) 
-				n->children = newnode;
-			else {
-				xmlnode_t *m = n->children;
-
-				while (m->next)
-					m = m->next;
-
-				m->next = newnode;
-			}
-		}
-		arrcount = g_strv_length((char **) atts);
-
-		if (arrcount > 0) {		/* we don't need to allocate table if arrcount = 0 */
-			newnode->atts = xmalloc((arrcount + 1) * sizeof(char *));
-			for (i = 0; i < arrcount; i++)
-				newnode->atts[i] = xstrdup(atts[i]);
-		}
-
-		j->node = newnode;
+		j->node = xmlnode_new(j, j->node, name, atts);
 	}
 }
 
@@ -633,7 +601,10 @@ static WATCHER_SESSION(jabber_handle_stream) {
 	switch (j->using_compress) {
 		case JABBER_COMPRESSION_ZLIB:
 #ifdef HAVE_LIBZ
-			uncompressed = jabber_zlib_decompress(buf, &rlen);
+			if (!(uncompressed = jabber_zlib_decompress(j, buf, &rlen))) {
+				jabber_handle_disconnect(s, "zlib stream corrupted", EKG_DISCONNECT_NETWORK);
+				return -1;
+			}
 #else
 			debug_error("[jabber] jabber_handle_stream() compression zlib, but no zlib support.. you're joking, right?\n");
 #endif
@@ -653,14 +624,10 @@ static WATCHER_SESSION(jabber_handle_stream) {
 	}
 
 	debug_iorecv("[jabber] (%db/%db) recv: %s\n", rlen, len, uncompressed ? uncompressed : buf);
-/*
-	if (uncompressed) {
-		memcpy(buf, uncompressed, rlen);
-	}
- */
 
-	if (!XML_ParseBuffer(parser, rlen, (rlen == 0))) 
-//	if (!XML_Parse(parser, uncompressed ? uncompressed : buf, rlen, (rlen == 0))) 
+	/* decompressed data isn't in expat buffer, so it must be copied by XML_Parse(),
+	 * it can be also longer than BUFFER_LEN. Compressed stream never ends here. */
+	if (uncompressed ? !XML_Parse(parser, uncompressed, rlen, 0) : !XML_ParseBuffer(parser, rlen, (rlen == 0)))
 	{
 		char *tmp;
 
@@ -1133,6 +1100,19 @@ static QUERY(jabber_status_show_handle) {
 	print("show_status_server", j->server, ekg_itoa(j->port));
 #endif
 
+	if (j->using_compress == JABBER_COMPRESSION_ZLIB) {
+		char *wire_in	= g_strdup_printf("%" G_GUINT64_FORMAT, j->zwire_in);
+		char *data_in	= g_strdup_printf("%" G_GUINT64_FORMAT, j->zdata_in);
+		char *wire_out	= g_strdup_printf("%" G_GUINT64_FORMAT, j->zwire_out);
+		char *data_out	= g_strdup_printf("%" G_GUINT64_FORMAT, j->zdata_out);
+
+		print("jabber_compression_stats", "zlib", wire_in, data_in, wire_out, data_out);
+		xfree(wire_in);
+		xfree(data_in);
+		xfree(wire_out);
+		xfree(data_out);
+	}
+
 	if (session_int_get(s, "__gpg_enabled") == 1)
 		print("jabber_gpg_sok", session_name(s), session_get(s, "gpg_key"));
 			
@@ -1249,6 +1229,7 @@ static int jabber_theme_init() {
 	format_add("jabber_gpg_plugin",	_("%> (%1) To use OpenGPG support in jabber, first load gpg plugin!"), 1);	/* sesja */
 	format_add("jabber_gpg_config",	_("%> (%1) First set gpg_key and gpg_password before turning on gpg_active!"), 1); /* sesja */
 	format_add("jabber_gpg_ok",	_("%) (%1) GPG support: %gENABLED%n using key: %W%2%n"), 1);			/* sesja, klucz */
+	format_add("jabber_compression_stats", _("%) Compression: %T%1%n, received %T%2%n (%3) bytes, sent %T%4%n (%5) bytes"), 1);	/* %2, %4 - on wire, %3, %5 - uncompressed */
 	format_add("jabber_gpg_sok",	_("%) GPG key: %W%2%n"), 1);							/* sesja, klucz for /status */
 	format_add("jabber_gpg_fail",	_("%> (%1) We didn't manage to sign testdata using key: %W%2%n (%R%3%n)\nOpenGPG support for this session disabled."), 1);	/* sesja, klucz, error */
 
@@ -1617,6 +1598,10 @@ EXPORT int jabber_plugin_init(int prio) {
 	jabber_plugin.params	= jabber_plugin_vars;
 	jabber_plugin.priv		= &jabber_priv;
 
+	jabber_slot_allow_add_reply_id	= session_slot("allow_add_reply_id");
+	jabber_slot_auto_auth		= session_slot("auto_auth");
+	jabber_slot_display_ctcp	= session_slot("display_ctcp");
+
 	plugin_register(&jabber_plugin, prio);
 
 	session_postinit = 0;
@@ -35,6 +35,10 @@ struct xmlnode_s {
 	
 	struct xmlnode_s *next;
 /*	struct xmlnode_s *prev; */
+	struct xmlnode_s *last;		/* last child, to append in O(1) */
+
+	gsize data_len;			/* xstrlen(data) */
+	gsize data_size;		/* bytes allocated for data */
 };
 
 typedef struct xmlnode_s xmlnode_t;
@@ -132,6 +136,12 @@ typedef struct {
 	unsigned int istlen	: 2;	/**< whether this is a tlen session, 2 if connecting to tlen hub (XXX: ugly hack) */
 
 	enum jabber_compression_method using_compress;	/**< whether we're using compressed connection, and what method */
+	struct z_stream_s *zin;		/**< zlib stream of incoming data, for JABBER_COMPRESSION_ZLIB */
+	struct z_stream_s *zout;	/**< zlib stream of outgoing data */
+	GString *zpending;		/**< compressed data not sent yet */
+	int zconsumed;			/**< bytes of send_watch buffer already in zpending */
+	guint64 zwire_in, zwire_out;	/**< compressed bytes received/sent */
+	guint64 zdata_in, zdata_out;	/**< the same bytes after decompression/before compression */
 #ifdef JABBER_HAVE_SSL
 	unsigned char using_ssl	: 2;	/**< 1 if we're using SSL, 2 if we're using TLS, else 0 */
 	SSL_SESSION ssl_session;	/**< SSL session */
@@ -155,6 +165,7 @@ typedef struct {
 	watch_t *connect_watch;
 
 	xmlnode_t *node;		/**< current XML branch */
+	struct xmlnode_arena *arena;	/**< memory of current stanza tree, see xmlnode_new() */
 	jabber_conversation_t *conversations;	/**< known conversations */
 } jabber_private_t;
 
@@ -179,6 +190,7 @@ extern plugin_t jabber_plugin;
 extern char *jabber_default_pubsub_server;
 extern char *jabber_default_search_server;
 extern int config_jabber_beep_mail;
+extern session_slot_t jabber_slot_allow_add_reply_id, jabber_slot_auto_auth, jabber_slot_display_ctcp;
 extern const char *jabber_authtypes[];
 
 #define jabber_private(s)		((jabber_private_t*) session_private_get(s))
@@ -220,6 +232,8 @@ int jabber_iq_stanza_free(jabber_private_t *j);
 #define jabber_write(s, args...) watch_write((s && s->priv) ? jabber_private(s)->send_watch : NULL, args);
 WATCHER_LINE(jabber_handle_write);
 
+xmlnode_t *xmlnode_new(jabber_private_t *j, xmlnode_t *parent, const char *name, const char **atts);
+void xmlnode_arena_free(jabber_private_t *j);
 void xmlnode_handle_end(void *data, const char *name);
 void xmlnode_handle_cdata(void *data, const char *text, int len);
 
@@ -227,8 +241,10 @@ void jabber_handle_disconnect(session_t *s, const char *reason, int type);
 
 char *jabber_openpgp(session_t *s, const char *fromto, enum jabber_opengpg_type_t way, char *message, char *key, char **error);
 #ifdef HAVE_LIBZ
-char *jabber_zlib_decompress(const char *buf, int *len);
-char *jabber_zlib_compress(const char *buf, int *len);
+int jabber_zlib_init(jabber_private_t *j);
+void jabber_zlib_free(jabber_private_t *j);
+char *jabber_zlib_decompress(jabber_private_t *j, const char *buf, int *len);
+char *jabber_zlib_compress(jabber_private_t *j, const char *buf, int *len);
 #endif
 
 int jabber_conversation_find(jabber_private_t *j, const char *uid, const char *subject, const char *thread, jabber_conversation_t **result, const int can_add);
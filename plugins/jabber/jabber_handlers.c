@@ -453,8 +453,20 @@ JABBER_HANDLER(jabber_handle_compressed) {
 		return;
 	}
 
+	if (j->using_compress == JABBER_COMPRESSION_ZLIB) {
+#ifdef HAVE_LIBZ
+		if (jabber_zlib_init(j)) {
+#endif
+			jabber_handle_disconnect(s, "zlib initialization failed", EKG_DISCONNECT_FAILURE);
+			return;
+#ifdef HAVE_LIBZ
+		}
+#endif
+	}
+
 	j->parser = jabber_parser_recreate(NULL, XML_GetUserData(j->parser));
 	j->send_watch->handler	= jabber_handle_write;
+	j->send_watch->data	= j;	/* without SSL there was no handler, nor data */
 
 	watch_write(j->send_watch,
 			"<stream:stream to=\"%s\" xmlns=\"jabber:client\" xmlns:stream=\"http://etherx.jabber.org/streams\" version=\"1.0\">",
@@ -706,6 +718,7 @@ JABBER_HANDLER(jabber_handle_message) {
 	xmlnode_t *nbody	= xmlnode_find_child(n, "body");
 	xmlnode_t *nsubject	= NULL;
 	xmlnode_t *nthread	= NULL;
+	char *threadid		= NULL;
 	xmlnode_t *nhtml	= NULL;
 	xmlnode_t *xitem;
 	
@@ -888,30 +901,24 @@ JABBER_HANDLER(jabber_handle_message) {
 	}
 	if ((class == EKG_MSGCLASS_MESSAGE) /* conversations only with messages */
 			&& (!nonthreaded /* either if we've got thread */
-				|| ((nbody || nsubject) && (session_int_get(s, "allow_add_reply_id") > 1))
+				|| ((nbody || nsubject) && (session_slot_int_get(s, jabber_slot_allow_add_reply_id) > 1))
 					/* or we're allowing to use conversations for non-threaded messages */
 				)) {
 		jabber_conversation_t *thr;
 		int i = jabber_conversation_find(j, uid,
 				(nonthreaded && hassubject ? nsubject->data : NULL),
 				(nonthreaded ? NULL : nthread->data),
-				&thr, (session_int_get(s, "allow_add_reply_id") > 0));
+				&thr, (session_slot_int_get(s, jabber_slot_allow_add_reply_id) > 0));
 		
-		if (nonthreaded)
-			nthread = xmalloc(sizeof(xmlnode_t)); /* ugly hack, to make non-threaded reply work */
-		
-		if (thr) { /* XXX, do it nicer */
-			xfree(nthread->data);
-			nthread->data = saprintf("#%d", i);
+		if (thr) {	/* we show conversation number instead of <thread/> */
+			threadid = saprintf("#%d", i);
 			debug("[jabber, message] thread: %s -> #%d\n", thr->thread, i);
 		}
 	
 		if (!(nsubject && nsubject->data)) {
 			string_append(body, (thr ? "Reply-ID: " : "Thread: "));
-			string_append(body, nthread->data);
+			string_append(body, threadid ? threadid : nthread ? nthread->data : NULL);
 			string_append(body, "\n");
-			if (nonthreaded)
-				xfree(nthread);
 
 			new_line = 1;
 		} else if (thr) {
@@ -922,17 +929,15 @@ JABBER_HANDLER(jabber_handle_message) {
 	if (hassubject) {
 		string_append(body, "Subject: ");
 		string_append(body, nsubject->data);
-		if (nthread && nthread->data) {
+		if (threadid || (nthread && nthread->data)) {
 			string_append(body, " [");
-			string_append(body, nthread->data);
+			string_append(body, threadid ? threadid : nthread->data);
 			string_append(body, "]");
-			
-			if (!nthread->name) /* this means we're using above hack */
-				xfree(nthread);
 		}
 		string_append(body, "\n");
 		new_line = 1;
 	}
+	xfree(threadid);
 
 	if (new_line) string_append(body, "\n");	/* let's seperate headlines from message */
 
@@ -1356,7 +1361,7 @@ JABBER_HANDLER(jabber_handle_iq) {
 		const char *ns = q->xmlns;
 		const struct jabber_iq_generic_handler *tmp;
 
-		if (type == JABBER_IQ_TYPE_GET && session_int_get(s, "display_ctcp") == 1)
+		if (type == JABBER_IQ_TYPE_GET && session_slot_int_get(s, jabber_slot_display_ctcp) == 1)
 			print("jabber_ctcp_request", session_name(s), from, __(q->name), __(ns));
 
 		if (!(tmp = jabber_iq_find_handler(callbacks, q->name, ns))) {
@@ -1418,7 +1423,7 @@ JABBER_HANDLER(jabber_handle_presence) {
 
 		int auto_auth;
 
-		if ((auto_auth = session_int_get(s, "auto_auth")) == -1)
+		if ((auto_auth = session_slot_int_get(s, jabber_slot_auto_auth)) == -1)
 			auto_auth = 0;
 
 		if (!(u = userlist_find(s, uid))) {
@@ -1448,7 +1453,7 @@ JABBER_HANDLER(jabber_handle_presence) {
 	}
 
 	if (from && !xstrcmp(type, "unsubscribe")) {
-		int auto_auth = session_int_get(s, "auto_auth");
+		int auto_auth = session_slot_int_get(s, jabber_slot_auto_auth);
 
 		if (auto_auth == -1)
 			auto_auth = 0;
@@ -95,65 +95,143 @@ char *jabber_openpgp(session_t *s, const char *fromto, enum jabber_opengpg_type_
 }
 
 #ifdef HAVE_LIBZ
-char *jabber_zlib_compress(const char *buf, int *len) {
-	size_t destlen = (*len) * 1.01 + 12;
-	char *compressed = xmalloc(destlen);
+#define ZLIB_BUF_SIZE 4096
 
-	if (compress((unsigned char *) compressed, &destlen, (unsigned char *) buf, *len) != Z_OK) {
-		debug_error("jabber_zlib_compress() zlib compress() != Z_OK\n");
-		xfree(compressed);
-		return NULL;
-	} 
-	debug_function("jabber_handle_write() compress ok, retlen: %d orglen: %d\n", destlen, *len);
-	*len = destlen;
-	
-	return compressed;
-}
-
-char *jabber_zlib_decompress(const char *buf, int *len) {
-#define ZLIB_BUF_SIZE 1024
-	z_stream zlib_stream;
+/**
+ * jabber_zlib_init()
+ *
+ * Creates zlib streams of session (XEP-0138). Whole connection after
+ * &lt;compressed/&gt; is one compressed stream in each direction, so they're
+ * kept until jabber_zlib_free().
+ *
+ * @return 0 on success, -1 on error.
+ */
+int jabber_zlib_init(jabber_private_t *j) {
 	int err;
-	size_t size = ZLIB_BUF_SIZE+1;
-	int rlen = 0;
 
-	unsigned char *uncompressed = NULL;
+	jabber_zlib_free(j);
 
-	zlib_stream.zalloc	= Z_NULL;
-	zlib_stream.zfree	= Z_NULL;
-	zlib_stream.opaque	= Z_NULL;
+	/* xmalloc() zeroes memory, so zalloc, zfree and opaque are Z_NULL */
+	j->zin	= xmalloc(sizeof(z_stream));
+	j->zout	= xmalloc(sizeof(z_stream));
 
-	if ((err = inflateInit(&zlib_stream)) != Z_OK) {
-		debug_error("[jabber] jabber_handle_stream() inflateInit() %d != Z_OK\n", err);
-		return NULL;
+	if ((err = inflateInit(j->zin)) != Z_OK) {
+		debug_error("[jabber] jabber_zlib_init() inflateInit() %d != Z_OK\n", err);
+		xfree(j->zin);
+		xfree(j->zout);
+		j->zin = j->zout = NULL;
+		return -1;
+	}
+
+	if ((err = deflateInit(j->zout, Z_DEFAULT_COMPRESSION)) != Z_OK) {
+		debug_error("[jabber] jabber_zlib_init() deflateInit() %d != Z_OK\n", err);
+		xfree(j->zout);
+		j->zout = NULL;
+		jabber_zlib_free(j);
+		return -1;
+	}
+
+	j->zpending	= g_string_new(NULL);
+	j->zconsumed	= 0;
+
+	j->zwire_in = j->zwire_out = 0;
+	j->zdata_in = j->zdata_out = 0;
+	return 0;
+}
+
+void jabber_zlib_free(jabber_private_t *j) {
+	if (j->zin) {
+		inflateEnd(j->zin);
+		xfree(j->zin);
+		j->zin = NULL;
+	}
+	if (j->zout) {
+		deflateEnd(j->zout);
+		xfree(j->zout);
+		j->zout = NULL;
 	}
+	if (j->zpending) {
+		g_string_free(j->zpending, TRUE);
+		j->zpending = NULL;
+	}
+	j->zconsumed = 0;
+}
 
-	zlib_stream.next_in	= (unsigned char *) buf;
-	zlib_stream.avail_in	= *len;
+/*
+ * jabber_zlib_run()
+ *
+ * pushes buf through inflate() or deflate() of session stream, with
+ * Z_SYNC_FLUSH, so all data is available to the other side right now.
+ */
+static char *jabber_zlib_run(z_stream *z, int (*func)(z_streamp, int), const char *buf, int *len) {
+	GString *out = g_string_sized_new(*len);
+	unsigned char tmp[ZLIB_BUF_SIZE];
+	int err;
+
+	z->next_in	= (unsigned char *) buf;
+	z->avail_in	= *len;
 
 	do {
-		uncompressed = xrealloc(uncompressed, size);
-		zlib_stream.next_out = uncompressed + rlen;
-		zlib_stream.avail_out= ZLIB_BUF_SIZE;
-
-		err = inflate(&zlib_stream, Z_NO_FLUSH);
-		if (err != Z_OK && err != Z_STREAM_END) {
-			debug_error("[jabber] jabber_handle_stream() inflate() %d != Z_OK && %d != Z_STREAM_END %s\n", 
-					err, err, zlib_stream.msg);
-			break;
+		z->next_out	= tmp;
+		z->avail_out	= sizeof(tmp);
+
+		err = func(z, Z_SYNC_FLUSH);
+
+		if (err != Z_OK && err != Z_STREAM_END && err != Z_BUF_ERROR) {
+			debug_error("[jabber] jabber_zlib_run() %d != Z_OK %s\n", err, __(z->msg));
+			g_string_free(out, TRUE);
+			return NULL;
 		}
 
-		rlen += (ZLIB_BUF_SIZE - zlib_stream.avail_out);
-		size += (ZLIB_BUF_SIZE - zlib_stream.avail_out);
-	} while (err == Z_OK && zlib_stream.avail_out == 0);
+		g_string_append_len(out, (char *) tmp, sizeof(tmp) - z->avail_out);
 
-	inflateEnd(&zlib_stream);
+		/* Z_BUF_ERROR - no progress possible, everything was flushed */
+	} while (err == Z_OK && (z->avail_in || !z->avail_out));
 
-	uncompressed[rlen] = 0;
+	*len = out->len;
+	return g_string_free(out, FALSE);
+}
+
+/**
+ * jabber_zlib_compress()
+ *
+ * Compress @a buf with session's stream.
+ *
+ * @param len - length of @a buf, on return length of compressed data.
+ *
+ * @return compressed data, which must be freed, or NULL on error.
+ */
+char *jabber_zlib_compress(jabber_private_t *j, const char *buf, int *len) {
+	int orglen = *len;
+	char *compressed;
 
-	*len = rlen;
+	if (!(compressed = jabber_zlib_run(j->zout, deflate, buf, len)))
+		return NULL;
 
-	return (char *) uncompressed;
+	j->zdata_out += orglen;
+	j->zwire_out += *len;
+	return compressed;
+}
+
+/**
+ * jabber_zlib_decompress()
+ *
+ * Decompress @a buf with session's stream, output is NUL-terminated.
+ *
+ * @param len - length of @a buf, on return length of decompressed data.
+ *
+ * @return decompressed data, which must be freed, or NULL on error.
+ */
+char *jabber_zlib_decompress(jabber_private_t *j, const char *buf, int *len) {
+	int orglen = *len;
+	char *uncompressed;
+
+	if (!(uncompressed = jabber_zlib_run(j->zin, inflate, buf, len)))
+		return NULL;
+
+	j->zwire_in += orglen;
+	j->zdata_in += *len;
+	return uncompressed;
 }
 #endif
 
@@ -326,8 +404,8 @@ char *tlen_decode(const char *what) {
 WATCHER_LINE(jabber_handle_write) /* tylko gdy jest wlaczona kompresja lub TLS/SSL. dla zwyklych polaczen jest watch_handle_write() */
 {
 	jabber_private_t *j = data;
-	char *compressed = NULL;
 	int res = 0, len;
+	int compressing = 0;
 
 	if (type) {
 		/* XXX, do we need to make jabber_handle_disconnect() or smth simillar? */
@@ -355,8 +433,23 @@ WATCHER_LINE(jabber_handle_write) /* tylko gdy jest wlaczona kompresja lub TLS/S
 
 		case JABBER_COMPRESSION_ZLIB:
 #ifdef HAVE_LIBZ
-			res = len;
-			if (!(compressed = jabber_zlib_compress(watch, &len))) return 0;
+			/* compressed stream can't be rewound, so data after j->zconsumed is compressed once into
+			 * j->zpending, and removed from watch buffer only after all of j->zpending was sent. */
+			if (len > j->zconsumed) {
+				int clen = len - j->zconsumed;
+				char *compressed;
+
+				if (!(compressed = jabber_zlib_compress(j, watch + j->zconsumed, &clen))) {
+					debug_error("[jabber] jabber_handle_write() compression failed\n");
+					return -1;
+				}
+				g_string_append_len(j->zpending, compressed, clen);
+				xfree(compressed);
+				j->zconsumed = len;
+			}
+			watch		= j->zpending->str;
+			len		= j->zpending->len;
+			compressing	= 1;
 #else
 			debug_error("[jabber] jabber_handle_write() compression zlib, but no zlib support.. you're joking, right?\n");
 #endif
@@ -367,8 +460,6 @@ WATCHER_LINE(jabber_handle_write) /* tylko gdy jest wlaczona kompresja lub TLS/S
 			debug_error("[jabber] jabber_handle_write() unknown compression: %d\n", j->using_compress);
 	}
 
-	if (compressed) watch = (const char *) compressed;
-
 #ifdef JABBER_HAVE_SSL
 	if (j->using_ssl) {
 		res = SSL_SEND(j->ssl_session, watch, (size_t) len);
@@ -387,17 +478,25 @@ WATCHER_LINE(jabber_handle_write) /* tylko gdy jest wlaczona kompresja lub TLS/S
 
 		if (res < 0) {
 			print("generic_error", SSL_ERROR(res));
+			return res;
 		}
-
-		xfree(compressed);
-		return res;
-	}
+	} else
 #endif
-
 /* here we call write() */
-	write(fd, watch, len);
-	xfree(compressed);
+		if ((res = write(fd, watch, len)) == -1 && errno == EAGAIN)
+			res = 0;
+
+#ifdef HAVE_LIBZ
+	if (compressing && res >= 0) {
+		g_string_erase(j->zpending, 0, res);
 
+		if (j->zpending->len)
+			return 0;		/* rest of it next time */
+
+		res = j->zconsumed;
+		j->zconsumed = 0;
+	}
+#endif
 	return res;
 }
 
@@ -6,26 +6,131 @@
 
 #include "jabber.h"
 
-static void xmlnode_free(xmlnode_t *n)
+/*
+ * Stanza trees are built in per-session arena: nodes, names and attributes are
+ * bump-allocated from j->arena blocks, and all of it is dropped at once, after
+ * top-level stanza was handled. First block is kept for next stanza, so usually
+ * there's no malloc() at all.
+ */
+
+#define XMLNODE_ARENA_BLOCK	8192		/* size of normal arena block */
+#define XMLNODE_ALIGN(x)	(((x) + 7) & ~((gsize) 7))
+
+struct xmlnode_arena {
+	struct xmlnode_arena *next;
+	gsize size;
+	gsize used;
+	char data[1];
+};
+
+static void *xmlnode_alloc(jabber_private_t *j, gsize size)
 {
-	xmlnode_t *m;
+	struct xmlnode_arena *a = j->arena;
+	void *ret;
 
-	if (!n)
-		return;
+	size = XMLNODE_ALIGN(size);
 
-	for (m = n->children; m;) {
-		xmlnode_t *cur = m;
-		m = m->next;
-		xmlnode_free(cur);
+	if (!a || a->size - a->used < size) {
+		gsize bsize = MAX(size, XMLNODE_ARENA_BLOCK);
+
+		a = g_malloc(sizeof(struct xmlnode_arena) + bsize);
+		a->size	= bsize;
+		a->used	= 0;
+		a->next	= j->arena;
+		j->arena = a;
 	}
 
-	xfree(n->name);
-	xfree(n->data);
-	xfree(n->xmlns);
-	g_strfreev(n->atts);
-	xfree(n);
+	ret = a->data + a->used;
+	a->used += size;
+	return ret;
+}
+
+static char *xmlnode_strndup(jabber_private_t *j, const char *str, gsize len)
+{
+	char *ret = xmlnode_alloc(j, len + 1);
+
+	memcpy(ret, str, len);
+	ret[len] = '\0';
+	return ret;
+}
+
+/* drop whole stanza tree, but keep one normal block for next one */
+static void xmlnode_arena_reset(jabber_private_t *j)
+{
+	struct xmlnode_arena *a = j->arena, *keep = NULL;
+
+	while (a) {
+		struct xmlnode_arena *next = a->next;
+
+		if (!keep && a->size == XMLNODE_ARENA_BLOCK) {
+			keep = a;
+			keep->used = 0;
+			keep->next = NULL;
+		} else
+			g_free(a);
+		a = next;
+	}
+	j->arena = keep;
+}
+
+void xmlnode_arena_free(jabber_private_t *j)
+{
+	struct xmlnode_arena *a = j->arena;
+
+	while (a) {
+		struct xmlnode_arena *next = a->next;
+
+		g_free(a);
+		a = next;
+	}
+	j->arena = NULL;
+	j->node = NULL;
 }
- 
+
+/**
+ * xmlnode_new()
+ *
+ * Create node @a name (in expat's "xmlns\033name" form) with attributes @a atts,
+ * and append it to children of @a parent. It's valid only until stanza is handled.
+ */
+
+xmlnode_t *xmlnode_new(jabber_private_t *j, xmlnode_t *parent, const char *name, const char **atts)
+{
+	xmlnode_t *n = xmlnode_alloc(j, sizeof(xmlnode_t));
+	const char *sep;
+	int arrcount, i;
+
+	memset(n, 0, sizeof(xmlnode_t));
+
+	/* get the namespace */
+	if ((sep = xstrchr(name, '\033'))) {
+		n->xmlns = xmlnode_strndup(j, name, sep - name);
+		name = sep + 1;
+	}
+	n->name = xmlnode_strndup(j, name, xstrlen(name));
+
+	if (parent) {
+		n->parent = parent;
+
+		if (!parent->children)
+			parent->children = n;
+		else
+			parent->last->next = n;
+		parent->last = n;
+	}
+
+	arrcount = g_strv_length((char **) atts);
+
+	if (arrcount > 0) {		/* we don't need to allocate table if arrcount = 0 */
+		n->atts = xmlnode_alloc(j, (arrcount + 1) * sizeof(char *));
+		for (i = 0; i < arrcount; i++)
+			n->atts[i] = xmlnode_strndup(j, atts[i], xstrlen(atts[i]));
+		n->atts[arrcount] = NULL;
+	}
+
+	return n;
+}
+
 void xmlnode_handle_end(void *data, const char *name)
 {
 	session_t *s = (session_t *) data;
@@ -47,8 +152,8 @@ void xmlnode_handle_end(void *data, const char *name)
 
 	if (!n->parent) {
 		jabber_handle(data, n);
-		xmlnode_free(n);
 		j->node = NULL;
+		xmlnode_arena_reset(j);
 		return;
 	} else {
 		j->node = n->parent;
@@ -60,7 +165,7 @@ void xmlnode_handle_cdata(void *data, const char *text, int len)
 	session_t *s = (session_t *) data;
 	jabber_private_t *j;
 	xmlnode_t *n;
-	int oldlen;
+	gsize need;
 
 	if (!s || !(j = s->priv) || !text) {
 		debug_error("[jabber] xmlnode_handle_cdata() invalid parameters\n");
@@ -70,10 +175,30 @@ void xmlnode_handle_cdata(void *data, const char *text, int len)
 	if (!(n = j->node))
 		return;
 
-	oldlen = xstrlen(n->data);
-	n->data = xrealloc(n->data, oldlen + len + 1);
-	memcpy(n->data + oldlen, text, len);
-	n->data[oldlen + len] = 0;
+	need = n->data_len + len + 1;
+
+	if (need > n->data_size) {
+		struct xmlnode_arena *a = j->arena;
+		gsize size = MAX(need, n->data_size * 2);
+
+		size = XMLNODE_ALIGN(MAX(size, 64));
+
+		if (n->data && n->data + n->data_size == a->data + a->used && a->size - a->used >= size - n->data_size) {
+			/* it's at the top of arena, grow it in place */
+			a->used += size - n->data_size;
+		} else {
+			char *tmp = xmlnode_alloc(j, size);
+
+			if (n->data)
+				memcpy(tmp, n->data, n->data_len);
+			n->data = tmp;
+		}
+		n->data_size = size;
+	}
+
+	memcpy(n->data + n->data_len, text, len);
+	n->data_len += len;
+	n->data[n->data_len] = 0;
 }
 
 /*
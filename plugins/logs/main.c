@@ -288,7 +288,7 @@ static int logs_window_check(logs_log_t *ll, time_t t) {
 	}
 	if (chan > 0) {
 		if (l->file) { /* jesli plik byl otwarty otwieramy go z nowa sciezka */
-			fclose(l->file); l->file = NULL;
+			logs_close_file(l->file); l->file = NULL;
 			l->file = logs_open_file(l->path, l->logformat);
 		} 
 	}	
@@ -386,7 +386,7 @@ static FILE *logs_window_close(logs_log_t *l, int close) {
 	xfree(lw);
 	l->lw = NULL;
 	if (close && f) {
-		fclose(f);
+		logs_close_file(f);
 		return NULL;
 	}
 	return f;
@@ -403,7 +403,7 @@ static void logs_changed_path(const char *var) {
 		if (ll->lw) {
 			/* We don't need reopening file../ recreate magic struct.. because it'd be done when we try log smth into it. */
 			if (ll->lw->file) {
-				fclose(ll->lw->file);
+				logs_close_file(ll->lw->file);
 				ll->lw->file = NULL;
 			}
 
@@ -676,6 +676,7 @@ static FILE* logs_open_file(char *path, int ff) {
 			fputs("\"http://www.ekg2.org/DTD/ekg2log.dtd\">\n", fdesc);
 			fputs("<ekg2log xmlns=\"http://www.ekg2.org/DTD/\">\n", fdesc);
 			fputs("</ekg2log>\n", fdesc);
+			fflush(fdesc);	/* everything else goes through logs_write() */
 		} 
 		return fdesc;
 	}
@@ -683,6 +684,140 @@ static FILE* logs_open_file(char *path, int ff) {
 	return fopen(fullname, "a+");
 }
 
+/*
+ * Wpisy nie trafiaja od razu do pliku. logs_write() dopisuje je do bufora
+ * danego pliku, a ten jest zapisywany jednym write() po przekroczeniu
+ * logs:flush_size, co logs:flush_interval sekund, przed zamknieciem pliku
+ * i w logs_abort(). Sloty sa w statycznej tablicy, zeby logs_abort() nie
+ * musial chodzic po listach.
+ */
+static logs_pending_t logs_pending[LOGS_PENDING_MAX];
+
+static logs_pending_t *logs_pending_find(FILE *file, int ff, int create) {
+	logs_pending_t *slot = NULL;
+	int i;
+
+	for (i = 0; i < LOGS_PENDING_MAX; i++) {
+		if (logs_pending[i].file == file)
+			return &logs_pending[i];
+		if (!slot && !logs_pending[i].file)
+			slot = &logs_pending[i];
+	}
+
+	if (!create || !slot)
+		return NULL;
+
+	if (!slot->buf)
+		slot->buf = g_string_sized_new(config_logs_flush_size > 0 ? config_logs_flush_size : 1024);
+	slot->fd	= fileno(file);
+	slot->logformat	= ff;
+	slot->file	= file;
+	return slot;
+}
+
+/* async-signal-safe, called from logs_abort() too */
+static void logs_pending_write(int fd, int ff, const char *data, gsize len) {
+	static const char xmltail[] = "</ekg2log>\n";
+
+	if (ff == LOG_FORMAT_XML)
+		lseek(fd, -(off_t) (sizeof(xmltail) - 1), SEEK_END);	/* wracamy przed </ekg2log> */
+
+	while (len > 0) {
+		ssize_t res = write(fd, data, len);
+
+		if (res == -1 && errno == EINTR)
+			continue;
+		if (res <= 0)
+			break;
+		data += res;
+		len -= res;
+	}
+
+	if (ff == LOG_FORMAT_XML)
+		write(fd, xmltail, sizeof(xmltail) - 1);
+}
+
+static void logs_pending_flush(logs_pending_t *p) {
+	if (!p->buf->len)
+		return;
+
+	logs_pending_write(p->fd, p->logformat, p->buf->str, p->buf->len);
+	g_string_truncate(p->buf, 0);
+}
+
+static void logs_write(FILE *file, int ff, GString *data) {
+	logs_pending_t *p;
+
+	if (!(p = logs_pending_find(file, ff, 1))) {
+		/* no free slot, this file has nothing pending, so order is kept */
+		logs_pending_write(fileno(file), ff, data->str, data->len);
+		return;
+	}
+
+	g_string_append_len(p->buf, data->str, data->len);
+
+	if (config_logs_flush_interval <= 0 || p->buf->len >= config_logs_flush_size)
+		logs_pending_flush(p);
+}
+
+static void logs_close_file(FILE *file) {
+	logs_pending_t *p;
+
+	if ((p = logs_pending_find(file, 0, 0))) {
+		logs_pending_flush(p);
+		p->file = NULL;
+	}
+	fclose(file);
+}
+
+static void logs_flush_all(int sync) {
+	int i;
+
+	for (i = 0; i < LOGS_PENDING_MAX; i++) {
+		logs_pending_t *p = &logs_pending[i];
+
+		if (!p->file)
+			continue;
+
+		logs_pending_flush(p);
+		if (sync)
+			fsync(p->fd);
+	}
+}
+
+static void logs_abort(void) {
+	int i;
+
+	for (i = 0; i < LOGS_PENDING_MAX; i++) {
+		logs_pending_t *p = &logs_pending[i];
+
+		if (p->file && p->buf && p->buf->len)
+			logs_pending_write(p->fd, p->logformat, p->buf->str, p->buf->len);
+	}
+}
+
+static TIMER(logs_flush_timer) {
+	if (type)
+		return 0;
+
+	logs_flush_all(0);
+	return 0;
+}
+
+static void logs_changed_flush(const char *var) {
+	timer_remove(&logs_plugin, "logs:flush");
+
+	if (config_logs_flush_interval > 0)
+		timer_add(&logs_plugin, "logs:flush", config_logs_flush_interval, 1, logs_flush_timer, NULL);
+	else
+		logs_flush_all(0);
+}
+
+static COMMAND(logs_cmd_sync) {
+	logs_flush_all(1);
+	return 0;
+}
+
 /*
  * zapis w formacie znanym z ekg1
  * typ,uid,nickname,timestamp,{timestamp wyslania dla odleglych}, text
@@ -697,29 +832,30 @@ static void logs_simple(FILE *file, const char *session, const char *uid, const
 	const char *gotten_nickname = get_nickname(s, uid);
 
 	const gchar *logsenc = config_logs_encoding ? config_logs_encoding : console_charset;
-	GString *tmp;
+	GString *tmp, *out;
 
 	if (!file)
 		return;
 	textcopy = log_escape(text);
+	out = g_string_sized_new(256);
 
 	if (!gotten_uid)	gotten_uid = uid;
 	if (!gotten_nickname)	gotten_nickname = uid;
 
 	switch (class) {
-		case EKG_MSGCLASS_MESSAGE	: fputs("msgrecv,", file);
+		case EKG_MSGCLASS_MESSAGE	: g_string_append(out, "msgrecv,");
 						  break;
-		case EKG_MSGCLASS_CHAT		: fputs("chatrecv,", file);
+		case EKG_MSGCLASS_CHAT		: g_string_append(out, "chatrecv,");
 						  break;
-		case EKG_MSGCLASS_SENT		: fputs("msgsend,", file);
+		case EKG_MSGCLASS_SENT		: g_string_append(out, "msgsend,");
 						  break;
-		case EKG_MSGCLASS_SENT_CHAT	: fputs("chatsend,", file);
+		case EKG_MSGCLASS_SENT_CHAT	: g_string_append(out, "chatsend,");
 						  break;
-		case EKG_MSGCLASS_SYSTEM	: fputs("msgsystem,", file);
+		case EKG_MSGCLASS_SYSTEM	: g_string_append(out, "msgsystem,");
 						  break;
-		case EKG_MSGCLASS_PRIV_STATUS	: fputs("status,", file);
+		case EKG_MSGCLASS_PRIV_STATUS	: g_string_append(out, "status,");
 						  break;
-		default				: fputs("chatrecv,", file);
+		default				: g_string_append(out, "chatrecv,");
 						  break;
 	};
 
@@ -731,40 +867,42 @@ static void logs_simple(FILE *file, const char *session, const char *uid, const
 
 	tmp = g_string_new(gotten_uid);
 	ekg_recode_gstring_to(logsenc, tmp);
-	fputs(tmp->str, file);      fputc(',', file);
+	g_string_append(out, tmp->str);      g_string_append_c(out, ',');
 	g_string_assign(tmp, gotten_nickname);
 	ekg_recode_gstring_to(logsenc, tmp);
-	fputs(tmp->str, file); fputc(',', file);
+	g_string_append(out, tmp->str); g_string_append_c(out, ',');
 	if (class == EKG_MSGCLASS_PRIV_STATUS) {
 		userlist_t *u = userlist_find(s, gotten_uid);
 		int __ip = u ? user_private_item_get_int(u, "ip") : INADDR_NONE;
 
-		fputs(inet_ntoa(*((struct in_addr*) &__ip)), file);
-		fputc(':', file);
-		fputs(ekg_itoa(u ? user_private_item_get_int(u, "port") : 0), file); 
-		fputc(',', file);
+		g_string_append(out, inet_ntoa(*((struct in_addr*) &__ip)));
+		g_string_append_c(out, ':');
+		g_string_append(out, ekg_itoa(u ? user_private_item_get_int(u, "port") : 0)); 
+		g_string_append_c(out, ',');
 	}
 
-	fputs(timestamp, file); fputc(',', file);
+	g_string_append(out, timestamp); g_string_append_c(out, ',');
 
 	if (class == EKG_MSGCLASS_MESSAGE || class == EKG_MSGCLASS_CHAT) {
 		const char *senttimestamp = prepare_timestamp_format(config_logs_timestamp, sent);
-		fputs(senttimestamp, file);
-		fputc(',', file);
+		g_string_append(out, senttimestamp);
+		g_string_append_c(out, ',');
 	} else if (class == EKG_MSGCLASS_PRIV_STATUS) {
-		fputs(status, file); 
-		fputc(',', file);
+		g_string_append(out, status); 
+		g_string_append_c(out, ',');
 	}
 	if (textcopy) {
 		g_string_assign(tmp, textcopy);
 		ekg_recode_gstring_to(logsenc, tmp);
-		fputs(tmp->str, file);
+		g_string_append(out, tmp->str);
 	}
-	fputs("\n", file);
+	g_string_append(out, "\n");
+
+	logs_write(file, LOG_FORMAT_SIMPLE, out);
 
 	xfree(textcopy);
 	g_string_free(tmp, TRUE);
-	fflush(file);
+	g_string_free(out, TRUE);
 }
 
 /*
@@ -778,6 +916,7 @@ static void logs_xml(FILE *file, const char *session, const char *uid, const cha
 /*	const char *senttimestamp = prepare_timestamp_format(config_logs_timestamp, sent); */
 	char *gotten_uid, *gotten_nickname;
 	const char *tmp;
+	GString *out;
 
 	if (!file)
 		return;
@@ -788,7 +927,7 @@ static void logs_xml(FILE *file, const char *session, const char *uid, const cha
 	gotten_uid	= xml_escape( (tmp = get_uid(s, uid))		? tmp : uid);
 	gotten_nickname = xml_escape( (tmp = get_nickname(s, uid))	? tmp : uid);
 
-	fseek(file, -11, SEEK_END); /* wracamy przed </ekg2log> */
+	out = g_string_sized_new(512);	/* logs_write() zajmie sie </ekg2log> */
 
 	/*
 	 * <message class="chatsend">
@@ -806,42 +945,43 @@ static void logs_xml(FILE *file, const char *session, const char *uid, const cha
 	 * </message>
 	 */
 
-	fputs("<message class=\"",file);
+	g_string_append(out, "<message class=\"");
 
 	switch (class) {
-		case EKG_MSGCLASS_MESSAGE	: fputs("msgrecv", file);	  break;
-		case EKG_MSGCLASS_CHAT		: fputs("chatrecv", file);	  break;
-		case EKG_MSGCLASS_SENT		: fputs("msgsend", file);	  break;
-		case EKG_MSGCLASS_SENT_CHAT	: fputs("chatsend", file);	  break;
-		case EKG_MSGCLASS_SYSTEM	: fputs("msgsystem", file);	  break;
-		default				: fputs("chatrecv", file);	  break;
+		case EKG_MSGCLASS_MESSAGE	: g_string_append(out, "msgrecv");	  break;
+		case EKG_MSGCLASS_CHAT		: g_string_append(out, "chatrecv");	  break;
+		case EKG_MSGCLASS_SENT		: g_string_append(out, "msgsend");	  break;
+		case EKG_MSGCLASS_SENT_CHAT	: g_string_append(out, "chatsend");	  break;
+		case EKG_MSGCLASS_SYSTEM	: g_string_append(out, "msgsystem");	  break;
+		default				: g_string_append(out, "chatrecv");	  break;
 	};
 
-	fputs("\">\n", file);
+	g_string_append(out, "\">\n");
 
-	fputs("\t<time>\n", file);
-	fputs("\t\t<received>", file); fputs(timestamp, file); fputs("</received>\n", file);
+	g_string_append(out, "\t<time>\n");
+	g_string_append(out, "\t\t<received>"); g_string_append(out, timestamp); g_string_append(out, "</received>\n");
 	if (class == EKG_MSGCLASS_MESSAGE || class == EKG_MSGCLASS_CHAT) {
-		fputs("\t\t<sent>", file); fputs(timestamp, file); fputs("</sent>\n", file);
+		g_string_append(out, "\t\t<sent>"); g_string_append(out, timestamp); g_string_append(out, "</sent>\n");
 	}
-	fputs("\t</time>\n", file);
+	g_string_append(out, "\t</time>\n");
 
-	fputs("\t<sender>\n", file);
-	fputs("\t\t<uid>", file);   fputs(gotten_uid, file);	   fputs("</uid>\n", file);
-	fputs("\t\t<nick>", file);  fputs(gotten_nickname, file);  fputs("</nick>\n", file);
-	fputs("\t</sender>\n", file);
+	g_string_append(out, "\t<sender>\n");
+	g_string_append(out, "\t\t<uid>");   g_string_append(out, gotten_uid);	   g_string_append(out, "</uid>\n");
+	g_string_append(out, "\t\t<nick>");  g_string_append(out, gotten_nickname);  g_string_append(out, "</nick>\n");
+	g_string_append(out, "\t</sender>\n");
 
-	fputs("\t<body>\n", file);
-	if (textcopy) fputs(textcopy, file);
-	fputs("\t</body>\n", file);
+	g_string_append(out, "\t<body>\n");
+	if (textcopy) g_string_append(out, textcopy);
+	g_string_append(out, "\t</body>\n");
 
-	fputs("</message>\n", file);
-	fputs("</ekg2log>\n", file);
+	g_string_append(out, "</message>\n");
+
+	logs_write(file, LOG_FORMAT_XML, out);
 
 	xfree(textcopy);
 	xfree(gotten_uid);
 	xfree(gotten_nickname);
-	fflush(file);
+	g_string_free(out, TRUE);
 }
 
 /*
@@ -861,6 +1001,7 @@ static void logs_gaim()
 static void logs_irssi(FILE *file, const char *session, const char *uid, const char *text, time_t sent, msgclass_t class) {
 	const char *nuid = NULL;	/* get_nickname(session_find(session), uid) */
 	gchar *tmp, *enc;
+	GString *out;
 
 	if (!file)
 		return;
@@ -888,10 +1029,11 @@ static void logs_irssi(FILE *file, const char *session, const char *uid, const c
 			return; /* to avoid flushisk file */
 	}
 	enc = ekg_recode_to(config_logs_encoding, tmp);
-	fputs(enc, file);
+	out = g_string_new(enc);
+	logs_write(file, LOG_FORMAT_IRSSI, out);
+	g_string_free(out, TRUE);
 	g_free(tmp);
 	g_free(enc);
-	fflush(file);
 }
 
 /* 
@@ -1197,6 +1339,8 @@ EXPORT int logs_plugin_init(int prio) {
 		/* we need to reopen files on change and that's what logs_changed_path() does */
 	variable_add(&logs_plugin, ("encoding"), VAR_STR, 1, &config_logs_encoding, &logs_changed_path, NULL, NULL);
 	/* TODO: maksymalna ilosc plikow otwartych przez plugin logs */
+	variable_add(&logs_plugin, ("flush_interval"), VAR_INT, 1, &config_logs_flush_interval, &logs_changed_flush, NULL, NULL);
+	variable_add(&logs_plugin, ("flush_size"), VAR_INT, 1, &config_logs_flush_size, NULL, NULL, NULL);
 	variable_add(&logs_plugin, ("log_max_open_files"), VAR_INT, 1, &config_logs_max_files, NULL /* XXX: logs_changed_maxfd */, NULL, NULL); 
 	variable_add(&logs_plugin, ("log"), VAR_MAP, 1, &config_logs_log, &logs_changed_path, 
 			variable_map(3, 
@@ -1211,12 +1355,18 @@ EXPORT int logs_plugin_init(int prio) {
 	variable_add(&logs_plugin, ("remind_number"), VAR_INT, 1, &config_logs_remind_number, NULL, NULL, NULL);
 	variable_add(&logs_plugin, ("timestamp"), VAR_STR, 1, &config_logs_timestamp, NULL, NULL, NULL);
 
+	command_add(&logs_plugin, "logs:sync", NULL, logs_cmd_sync, 0, 0);
+
+	logs_changed_flush(NULL);
+	ekg2_register_abort_handler(logs_abort, &logs_plugin);
+
 	return 0;
 }
 
 static int logs_plugin_destroy() {
 	list_t old_logs = log_logs;
 	struct buffer *b;
+	int i;
 
 	for (; log_logs; log_logs = log_logs->next) {
 		logs_log_t *ll = log_logs->data;
@@ -1241,7 +1391,7 @@ static int logs_plugin_destroy() {
 						prepare_timestamp_format(IRSSI_LOG_EKG2_CLOSED, t), 0,
 						EKG_MSGCLASS_SYSTEM);
 			}
-			fclose(f);
+			logs_close_file(f);
 		}
 
 		xfree(ll->session);
@@ -1249,6 +1399,14 @@ static int logs_plugin_destroy() {
 	}
 	list_destroy(old_logs, 1);	log_logs = NULL;
 
+	logs_flush_all(0);	/* just in case, everything should be closed by now */
+	for (i = 0; i < LOGS_PENDING_MAX; i++) {
+		if (logs_pending[i].buf)
+			g_string_free(logs_pending[i].buf, TRUE);
+		logs_pending[i].file = NULL;
+		logs_pending[i].buf = NULL;
+	}
+
 	if (config_logs_log_raw) for (b = buffer_lograw.data; b;) {
 		static FILE *f = NULL;
 		static char *oldtarget = NULL;
@@ -32,6 +32,16 @@ typedef struct {
 	FILE *file;	/* file don't close it! it will be closed at unloading plugin. */
 } log_window_t;
 
+/* dane czekajace na zapis do jednego pliku */
+typedef struct {
+	FILE	*file;		/* NULL - slot is free */
+	int	fd;		/* fileno(file), kept for logs_abort() */
+	int	logformat;
+	GString	*buf;		/* pending data, in the order it was logged */
+} logs_pending_t;
+
+#define LOGS_PENDING_MAX 64	/* files with unwritten data at once, the rest is written directly */
+
 typedef struct {
 	char *session;	/* session name */
 	char *uid;	/* uid of user */
@@ -60,6 +70,9 @@ static logs_log_t *logs_log_find(const char *session, const char *uid, int creat
 static logs_log_t *logs_log_new(logs_log_t *l, const char *session, const char *uid);
 
 static FILE *logs_open_file(char *path, int ff);
+static void logs_close_file(FILE *file);
+static void logs_write(FILE *file, int ff, GString *data);
+static void logs_flush_all(int sync);
 
 static void logs_simple(FILE *file, const char *session, const char *uid, const char *text, time_t sent, msgclass_t class, const char *status);
 static void logs_xml	(FILE *file, const char *session, const char *uid, const char *text, time_t sent, msgclass_t class);
@@ -79,5 +92,7 @@ static int config_logs_max_files = 7;
 static char *config_logs_path;
 static char *config_logs_timestamp;
 static gchar *config_logs_encoding;
+static int config_logs_flush_interval = 5;
+static int config_logs_flush_size = 16384;
 
 #endif
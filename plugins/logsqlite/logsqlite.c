@@ -54,10 +54,296 @@ int config_logsqlite_last_print_on_open = 0;
 int config_logsqlite_log = 0;
 int config_logsqlite_log_ignored = 0;
 int config_logsqlite_log_status = 0;
+int config_logsqlite_commit_interval = 5;
+int config_logsqlite_commit_rows = 100;
+int config_logsqlite_wal = 0;
+int config_logsqlite_fts = 1;
 
 static sqlite_t * logsqlite_current_db = NULL;
 static char * logsqlite_current_db_path = NULL;
 static int logsqlite_in_transaction = 0;
+static int logsqlite_transaction_rows = 0;
+
+#ifdef HAVE_LIBSQLITE3
+/* INSERTs prepared once per logsqlite_current_db */
+static sqlite3_stmt * logsqlite_stmt_msg = NULL;
+static sqlite3_stmt * logsqlite_stmt_status = NULL;
+
+/* full-text index of logsqlite_current_db: 5 - fts5, 4 - fts4, 0 - none (LIKE) */
+static int logsqlite_fts_mode = 0;
+#endif
+
+static struct {
+	guint64	rows;		/* rows inserted since plugin load */
+	guint	commits;
+	gint64	commit_time;	/* total time spent in COMMIT, usec */
+	gint64	commit_max;
+	time_t	since;
+} logsqlite_stats;
+
+/*
+ * commit rows inserted in current transaction
+ */
+static void logsqlite_commit()
+{
+	gint64 start, spent;
+
+	if (!logsqlite_current_db || !logsqlite_in_transaction)
+		return;
+
+	start = g_get_monotonic_time();
+	sqlite_n_exec(logsqlite_current_db, "COMMIT", NULL, NULL, NULL);
+	spent = g_get_monotonic_time() - start;
+
+	logsqlite_stats.commits++;
+	logsqlite_stats.commit_time += spent;
+	if (spent > logsqlite_stats.commit_max)
+		logsqlite_stats.commit_max = spent;
+
+	debug("[logsqlite] committed %d rows in %" G_GINT64_FORMAT " usec\n", logsqlite_transaction_rows, spent);
+
+	logsqlite_in_transaction = 0;
+	logsqlite_transaction_rows = 0;
+}
+
+static void logsqlite_begin(sqlite_t * db)
+{
+	if (logsqlite_in_transaction)
+		return;
+
+	sqlite_n_exec(db, "BEGIN TRANSACTION", NULL, NULL, NULL);
+	logsqlite_in_transaction = 1;
+	logsqlite_transaction_rows = 0;
+}
+
+/*
+ * called after each INSERT, commits every 'commit_rows' rows
+ * (the rest is committed by logsqlite_commit_timer())
+ */
+static void logsqlite_row_added()
+{
+	logsqlite_stats.rows++;
+
+	if (++logsqlite_transaction_rows >= config_logsqlite_commit_rows || config_logsqlite_commit_interval <= 0)
+		logsqlite_commit();
+}
+
+#ifdef HAVE_LIBSQLITE3
+/*
+ * return cached statement, preparing it if needed
+ */
+static sqlite3_stmt * logsqlite_stmt(sqlite3_stmt ** stmt, sqlite_t * db, const char * sql)
+{
+	if (*stmt)
+		return *stmt;
+
+	if (sqlite3_prepare_v2(db, sql, -1, stmt, NULL) != SQLITE_OK) {
+		debug_error("[logsqlite] can't prepare statement: %s\n", sqlite3_errmsg(db));
+		sqlite3_finalize(*stmt);
+		*stmt = NULL;
+	}
+	return *stmt;
+}
+#endif
+
+#ifdef HAVE_LIBSQLITE3
+/*
+ * full-text index
+ *
+ * log_msg_fts and log_status_fts are external content tables over
+ * log_msg.body and log_status.desc, keyed by rowid and kept in sync by
+ * triggers. /last -s looks words up there and filters the candidates
+ * with LIKE, so results stay the same as before, only words are matched
+ * by prefix.
+ */
+static const char *logsqlite_fts_tables[][2] = {
+	{ "log_msg",	"body" },
+	{ "log_status",	"desc" },
+};
+
+static int logsqlite_fts_create(sqlite_t * db, int mode, const char * table, const char * column)
+{
+	char *sql;
+	int res;
+
+	if (mode == 5)
+		sql = sqlite3_mprintf("CREATE VIRTUAL TABLE %s_fts USING fts5(\"%s\", content='%s')", table, column, table);
+	else
+		sql = sqlite3_mprintf("CREATE VIRTUAL TABLE %s_fts USING fts4(content=\"%s\", \"%s\")", table, table, column);
+
+	res = sqlite3_exec(db, sql, NULL, NULL, NULL);
+	sqlite3_free(sql);
+
+	if (res != SQLITE_OK)
+		return -1;
+
+	sql = sqlite3_mprintf("CREATE TRIGGER %s_fts_ai AFTER INSERT ON %s BEGIN "
+			"INSERT INTO %s_fts(rowid, \"%s\") VALUES (new.rowid, new.\"%s\"); END",
+			table, table, table, column, column);
+	res = sqlite3_exec(db, sql, NULL, NULL, NULL);
+	sqlite3_free(sql);
+
+	if (mode == 5)
+		sql = sqlite3_mprintf("CREATE TRIGGER %s_fts_ad AFTER DELETE ON %s BEGIN "
+				"INSERT INTO %s_fts(%s_fts, rowid, \"%s\") VALUES ('delete', old.rowid, old.\"%s\"); END",
+				table, table, table, table, column, column);
+	else
+		sql = sqlite3_mprintf("CREATE TRIGGER %s_fts_ad BEFORE DELETE ON %s BEGIN "
+				"DELETE FROM %s_fts WHERE docid = old.rowid; END",
+				table, table, table);
+	if (res == SQLITE_OK)
+		res = sqlite3_exec(db, sql, NULL, NULL, NULL);
+	sqlite3_free(sql);
+
+	/* index rows logged before the index existed */
+	sql = sqlite3_mprintf("INSERT INTO %s_fts(%s_fts) VALUES ('rebuild')", table, table);
+	if (res == SQLITE_OK)
+		res = sqlite3_exec(db, sql, NULL, NULL, NULL);
+	sqlite3_free(sql);
+
+	return (res == SQLITE_OK) ? 0 : -1;
+}
+
+/*
+ * find or create full-text index, returns its fts version or 0
+ */
+static int logsqlite_fts_prepare(sqlite_t * db, const char * path)
+{
+	sqlite3_stmt *stmt;
+	int mode = 0;
+	int i;
+
+	if (sqlite3_prepare_v2(db, "SELECT sql FROM sqlite_master WHERE type = 'table' AND name = 'log_msg_fts'", -1, &stmt, NULL) == SQLITE_OK) {
+		if (sqlite3_step(stmt) == SQLITE_ROW)
+			mode = xstrstr((const char *) sqlite3_column_text(stmt, 0), "fts5") ? 5 : 4;
+		sqlite3_finalize(stmt);
+	}
+
+	if (mode || !config_logsqlite_fts)
+		return mode;
+
+	print("logsqlite_fts_building", path);
+
+	for (mode = 5; mode >= 4; mode--) {
+		sqlite3_exec(db, "BEGIN TRANSACTION", NULL, NULL, NULL);
+
+		for (i = 0; i < G_N_ELEMENTS(logsqlite_fts_tables); i++) {
+			if (logsqlite_fts_create(db, mode, logsqlite_fts_tables[i][0], logsqlite_fts_tables[i][1]))
+				break;
+		}
+
+		if (i == G_N_ELEMENTS(logsqlite_fts_tables)) {
+			sqlite3_exec(db, "COMMIT", NULL, NULL, NULL);
+			debug("[logsqlite] created fts%d index\n", mode);
+			return mode;
+		}
+
+		debug_error("[logsqlite] can't create fts%d index: %s\n", mode, sqlite3_errmsg(db));
+		sqlite3_exec(db, "ROLLBACK", NULL, NULL, NULL);
+	}
+
+	return 0;
+}
+
+static void logsqlite_fts_drop(sqlite_t * db)
+{
+	int i;
+
+	for (i = 0; i < G_N_ELEMENTS(logsqlite_fts_tables); i++) {
+		const char *table = logsqlite_fts_tables[i][0];
+		char *sql = sqlite3_mprintf("DROP TRIGGER IF EXISTS %s_fts_ai; DROP TRIGGER IF EXISTS %s_fts_ad; DROP TABLE IF EXISTS %s_fts",
+				table, table, table);
+
+		sqlite3_exec(db, sql, NULL, NULL, NULL);
+		sqlite3_free(sql);
+	}
+}
+
+/*
+ * does word give any token to fts tokenizer? fts4 (simple) indexes ascii
+ * alphanumerics and every non-ascii character, fts5 (unicode61) only
+ * letters and digits
+ */
+static int logsqlite_fts_indexable(const char * word)
+{
+	const char *p;
+
+	if (!g_utf8_validate(word, -1, NULL))
+		return 1;
+
+	for (p = word; *p; p = g_utf8_next_char(p)) {
+		if (!(*p & 0x80)) {
+			if (g_ascii_isalnum(*p))
+				return 1;
+		} else if (logsqlite_fts_mode != 5 || g_unichar_isalnum(g_utf8_get_char(p)))
+			return 1;
+	}
+	return 0;
+}
+
+/*
+ * turn /last -s text into MATCH expression: every word has to be there,
+ * as a prefix of some word in the message. words without tokens (only
+ * punctuation) are left to LIKE, which is always checked too; NULL if
+ * nothing is left, then only LIKE is used
+ */
+static char * logsqlite_fts_match(const char * text)
+{
+	gchar **words = g_strsplit_set(text, " \t", -1);
+	GString *match = g_string_new(NULL);
+	int i;
+
+	for (i = 0; words[i]; i++) {
+		const char *p;
+
+		if (!logsqlite_fts_indexable(words[i]))
+			continue;
+
+		if (match->len)
+			g_string_append_c(match, ' ');
+
+		g_string_append_c(match, '"');
+		for (p = words[i]; *p; p++) {
+			if (*p == '"')
+				g_string_append_c(match, '"');
+			g_string_append_c(match, *p);
+		}
+		g_string_append(match, (logsqlite_fts_mode == 5) ? "\"*" : "*\"");
+	}
+	g_strfreev(words);
+
+	return g_string_free(match, !match->len);
+}
+
+/*
+ * /last query; ?1 - uid, ?2 - limit, ?3 - LIKE pattern, ?4 - MATCH expression
+ */
+static gchar * logsqlite_last_sql(int status, int by_uid, int fts)
+{
+	const char *table = status ? "log_status" : "log_msg";
+	gchar *fts_cond = fts ? g_strdup_printf("rowid IN (SELECT rowid FROM %s_fts WHERE %s_fts MATCH ?4) AND ", table, table) : NULL;
+	gchar *sql;
+
+	sql = g_strdup_printf("SELECT * FROM (SELECT %s FROM %s WHERE %s%s%s LIKE ?3 ORDER BY ts DESC LIMIT ?2) ORDER BY ts ASC",
+			status ? "uid, nick, ts, status, desc" : "uid, nick, ts, body, sent",
+			table,
+			by_uid ? "uid = ?1 AND " : "",
+			fts_cond ? fts_cond : "",
+			status ? "desc" : "body");
+
+	g_free(fts_cond);
+	return sql;
+}
+#endif
+
+static TIMER(logsqlite_commit_timer)
+{
+	if (type)
+		return 0;
+
+	logsqlite_commit();
+	return 0;
+}
 
 
 /*
@@ -70,6 +356,8 @@ int last(const char **params, session_t *session, int quiet, int status)
 	const char *last_direction;
 #ifdef HAVE_LIBSQLITE3
 	sqlite3_stmt *stmt;
+	gchar *sql;
+	char *fts_match = NULL;
 #else
 	char *sql;
 	const char ** results;
@@ -135,6 +423,8 @@ int last(const char **params, session_t *session, int quiet, int status)
 
 	sql_search = sql_search ? sql_search : "";	/* XXX: use fix() */
 #ifdef HAVE_LIBSQLITE3
+	if (logsqlite_fts_mode && *sql_search)
+		fts_match = logsqlite_fts_match(sql_search);
 	sql_search = sqlite3_mprintf("%%%s%%", sql_search);
 #endif
 
@@ -148,13 +438,10 @@ int last(const char **params, session_t *session, int quiet, int status)
 			target_window = gotten_uid;
 
 #ifdef HAVE_LIBSQLITE3
-		if (!status)
-			sqlite3_prepare(db, "SELECT * FROM (SELECT uid, nick, ts, body, sent FROM log_msg WHERE uid = ?1 AND body LIKE ?3 ORDER BY ts DESC LIMIT ?2) ORDER BY ts ASC", -1, &stmt, NULL);
-		else
-			sqlite3_prepare(db, "SELECT * FROM (SELECT uid, nick, ts, status, desc FROM log_status WHERE uid = ?1 AND desc LIKE ?3 ORDER BY ts DESC LIMIT ?2) ORDER BY ts ASC", -1, &stmt, NULL);
+		sql = logsqlite_last_sql(status, 1, !!fts_match);
+		sqlite3_prepare(db, sql, -1, &stmt, NULL);
 
 		sqlite3_bind_text(stmt, 1, gotten_uid, -1, SQLITE_STATIC);
-		sqlite3_bind_text(stmt, 3, sql_search, -1, SQLITE_STATIC);
 #else
 		if(!status)
 			sql = sqlite_mprintf("SELECT * FROM (SELECT uid, nick, ts, body, sent FROM log_msg WHERE uid = '%q' AND body LIKE '%%%q%%' ORDER BY ts DESC LIMIT %i) ORDER BY ts ASC", gotten_uid, sql_search, limit_msg);
@@ -167,12 +454,8 @@ int last(const char **params, session_t *session, int quiet, int status)
 			target_window = "__status";
 
 #ifdef HAVE_LIBSQLITE3
-		if(!status)
-			sqlite3_prepare(db, "SELECT * FROM (SELECT uid, nick, ts, body, sent FROM log_msg WHERE body LIKE ?3 ORDER BY ts DESC LIMIT ?2) ORDER BY ts ASC", -1, &stmt, NULL);
-		else
-			sqlite3_prepare(db, "SELECT * FROM (SELECT uid, nick, ts, status, desc FROM log_status WHERE desc LIKE ?3 ORDER BY ts DESC LIMIT ?2) ORDER BY ts ASC", -1, &stmt, NULL);
-
-		sqlite3_bind_text(stmt, 3, sql_search, -1, SQLITE_STATIC);
+		sql = logsqlite_last_sql(status, 0, !!fts_match);
+		sqlite3_prepare(db, sql, -1, &stmt, NULL);
 #else
 		if(!status)
 			sql = sqlite_mprintf("SELECT * FROM (SELECT uid, nick, ts, body, sent FROM log_msg WHERE body LIKE '%%%q%%' ORDER BY ts DESC LIMIT %i) ORDER BY ts ASC", sql_search, limit_msg);
@@ -183,6 +466,10 @@ int last(const char **params, session_t *session, int quiet, int status)
 	}
 
 #ifdef HAVE_LIBSQLITE3
+	sqlite3_bind_text(stmt, 3, sql_search, -1, SQLITE_STATIC);
+	if (fts_match)
+		sqlite3_bind_text(stmt, 4, fts_match, -1, SQLITE_STATIC);
+
 	if(status)
 		sqlite3_bind_int(stmt, 2, limit_status);
 	else
@@ -286,6 +573,8 @@ int last(const char **params, session_t *session, int quiet, int status)
 #ifdef HAVE_LIBSQLITE3
 	sqlite3_free(sql_search);
 	sqlite3_finalize(stmt);
+	g_free(sql);
+	g_free(fts_match);
 #else
 	sqlite_freemem(sql);
 	sqlite_finalize(vm, &errors);
@@ -305,12 +594,26 @@ COMMAND(logsqlite_cmd_laststatus)
 
 COMMAND(logsqlite_cmd_sync)
 {
-	if (logsqlite_current_db && logsqlite_in_transaction)
-		sqlite_n_exec(logsqlite_current_db, "COMMIT", NULL, NULL, NULL);
+	logsqlite_commit();
 	
 	return 0;
 }
 
+COMMAND(logsqlite_cmd_stats)
+{
+	time_t elapsed = time(NULL) - logsqlite_stats.since;
+	char rows[24], rate[24], commits[16], avg[24], max[24];
+
+	g_snprintf(rows, sizeof(rows), "%" G_GUINT64_FORMAT, logsqlite_stats.rows);
+	g_snprintf(rate, sizeof(rate), "%.2f", (double) logsqlite_stats.rows / (elapsed > 0 ? elapsed : 1));
+	g_snprintf(commits, sizeof(commits), "%u", logsqlite_stats.commits);
+	g_snprintf(avg, sizeof(avg), "%.2f", logsqlite_stats.commits ? (double) logsqlite_stats.commit_time / logsqlite_stats.commits / 1000 : 0.0);
+	g_snprintf(max, sizeof(max), "%.2f", (double) logsqlite_stats.commit_max / 1000);
+
+	printq("logsqlite_stats", rows, rate, commits, avg, max, ekg_itoa(logsqlite_transaction_rows));
+	return 0;
+}
+
 /*
  * set default configuration options
  */
@@ -388,30 +691,25 @@ sqlite_t * logsqlite_prepare_db(session_t * session, time_t sent, int mode)
 		xfree(logsqlite_current_db_path);
 		logsqlite_current_db_path = xstrdup(path);
 		logsqlite_current_db = db;
-
-		if (mode)
-			sqlite_n_exec(db, "BEGIN TRANSACTION", NULL, NULL, NULL);
-		logsqlite_in_transaction = mode;
 	} else if (!xstrcmp(path, logsqlite_current_db_path) && logsqlite_current_db) {
 		db = logsqlite_current_db;
 		debug("[logsqlite] keeping old db\n");
 
-		if (mode && !logsqlite_in_transaction)
-			sqlite_n_exec(db, "BEGIN TRANSACTION", NULL, NULL, NULL);
-		else if (!mode && logsqlite_in_transaction)
-			sqlite_n_exec(db, "COMMIT", NULL, NULL, NULL);
-		logsqlite_in_transaction = mode;
+		/* reads see our own uncommitted rows, so there's no need
+		 * to break the batch here */
 	} else {
 		logsqlite_close_db(logsqlite_current_db);
-		db = logsqlite_open_db(session, sent, path);
+		if (!(db = logsqlite_open_db(session, sent, path))) {
+			xfree(path);
+			return 0;
+		}
 		logsqlite_current_db = db;
 		xfree(logsqlite_current_db_path);
 		logsqlite_current_db_path = xstrdup(path);
-
-		if (mode)
-			sqlite_n_exec(db, "BEGIN TRANSACTION", NULL, NULL, NULL);
-		logsqlite_in_transaction = mode;
 	}
+
+	if (mode)
+		logsqlite_begin(db);
 	xfree(path);
 	return db;
 }
@@ -488,6 +786,12 @@ sqlite_t * logsqlite_open_db(session_t * session, time_t sent, char * path)
 #endif
 		return 0;
 	}
+
+#ifdef HAVE_LIBSQLITE3
+	if (config_logsqlite_wal)
+		sqlite3_exec(db, "PRAGMA journal_mode=WAL", NULL, NULL, NULL);
+	logsqlite_fts_mode = logsqlite_fts_prepare(db, path);
+#endif
 	return db;
 }
 
@@ -505,12 +809,16 @@ void logsqlite_close_db(sqlite_t * db)
 	}
 	debug("[logsqlite] close db\n");
 	if (db == logsqlite_current_db) {
+		logsqlite_commit();
+#ifdef HAVE_LIBSQLITE3
+		sqlite3_finalize(logsqlite_stmt_msg);
+		sqlite3_finalize(logsqlite_stmt_status);
+		logsqlite_stmt_msg = logsqlite_stmt_status = NULL;
+		logsqlite_fts_mode = 0;
+#endif
 		logsqlite_current_db = NULL;
 		xfree(logsqlite_current_db_path);
 		logsqlite_current_db_path = NULL;
-
-		if (logsqlite_in_transaction)
-			sqlite_n_exec(db, "COMMIT", NULL, NULL, NULL);
 	}
 	sqlite_n_close(db);
 }
@@ -629,18 +937,19 @@ QUERY(logsqlite_msg_handler)
 	}
 
 #ifdef HAVE_LIBSQLITE3
-	sqlite3_prepare(db, "INSERT INTO log_msg VALUES (?, ?, ?, ?, ?, ?, ?, ?)", -1, &stmt, NULL);
-	sqlite3_bind_text(stmt, 1, session, -1, SQLITE_STATIC);
-	sqlite3_bind_text(stmt, 2, myuid ? myuid : gotten_uid, -1, SQLITE_STATIC);
-	sqlite3_bind_text(stmt, 3, gotten_nickname, -1, SQLITE_STATIC);
-	sqlite3_bind_text(stmt, 4, type, -1, SQLITE_STATIC);
-	sqlite3_bind_int(stmt, 5, is_sent);
-	sqlite3_bind_int(stmt, 6, time(0));
-	sqlite3_bind_int(stmt, 7, sent);
-	sqlite3_bind_text(stmt, 8, text, -1, SQLITE_STATIC);
-
-	sqlite3_step(stmt);
-	sqlite3_finalize(stmt);
+	if ((stmt = logsqlite_stmt(&logsqlite_stmt_msg, db, "INSERT INTO log_msg VALUES (?, ?, ?, ?, ?, ?, ?, ?)"))) {
+		sqlite3_bind_text(stmt, 1, session, -1, SQLITE_STATIC);
+		sqlite3_bind_text(stmt, 2, myuid ? myuid : gotten_uid, -1, SQLITE_STATIC);
+		sqlite3_bind_text(stmt, 3, gotten_nickname, -1, SQLITE_STATIC);
+		sqlite3_bind_text(stmt, 4, type, -1, SQLITE_STATIC);
+		sqlite3_bind_int(stmt, 5, is_sent);
+		sqlite3_bind_int(stmt, 6, time(0));
+		sqlite3_bind_int(stmt, 7, sent);
+		sqlite3_bind_text(stmt, 8, text, -1, SQLITE_STATIC);
+
+		sqlite3_step(stmt);
+		sqlite3_reset(stmt);
+	}
 	
 #else
 	sqlite_exec_printf(db, "INSERT INTO log_msg VALUES(%Q, %Q, %Q, %Q, %i, %i, %i, %Q)", 0, 0, 0,
@@ -654,6 +963,7 @@ QUERY(logsqlite_msg_handler)
 		text);
 #endif 
 	xfree(myuid);
+	logsqlite_row_added();
 
 	return 0;
 };
@@ -704,16 +1014,17 @@ QUERY(logsqlite_status_handler) {
 	debug("[logsqlite] running status query\n");
 
 #ifdef HAVE_LIBSQLITE3
-	sqlite3_prepare(db, "INSERT INTO log_status VALUES(?, ?, ?, ?, ?, ?)", -1, &stmt, NULL);
-	sqlite3_bind_text(stmt, 1, session, -1, SQLITE_STATIC);
-	sqlite3_bind_text(stmt, 2, gotten_uid, -1, SQLITE_STATIC);
-	sqlite3_bind_text(stmt, 3, gotten_nickname, -1, SQLITE_STATIC);
-	sqlite3_bind_int(stmt, 4, time(0));
-	sqlite3_bind_text(stmt, 5, status, -1, SQLITE_STATIC);
-	sqlite3_bind_text(stmt, 6, descr, -1, SQLITE_STATIC);
-
-	sqlite3_step(stmt);
-	sqlite3_finalize(stmt);
+	if ((stmt = logsqlite_stmt(&logsqlite_stmt_status, db, "INSERT INTO log_status VALUES(?, ?, ?, ?, ?, ?)"))) {
+		sqlite3_bind_text(stmt, 1, session, -1, SQLITE_STATIC);
+		sqlite3_bind_text(stmt, 2, gotten_uid, -1, SQLITE_STATIC);
+		sqlite3_bind_text(stmt, 3, gotten_nickname, -1, SQLITE_STATIC);
+		sqlite3_bind_int(stmt, 4, time(0));
+		sqlite3_bind_text(stmt, 5, status, -1, SQLITE_STATIC);
+		sqlite3_bind_text(stmt, 6, descr, -1, SQLITE_STATIC);
+
+		sqlite3_step(stmt);
+		sqlite3_reset(stmt);
+	}
 
 #else
 	sqlite_exec_printf(db, "INSERT INTO log_status VALUES(%Q, %Q, %Q, %i, %Q, %Q)", 0, 0, 0,
@@ -724,6 +1035,7 @@ QUERY(logsqlite_status_handler) {
 		status,
 		descr);
 #endif 
+	logsqlite_row_added();
 
 	return 0;
 }
@@ -813,9 +1125,49 @@ static QUERY(logsqlite_newwin_handler) {
 	return 0;
 }
 
+static void logsqlite_changed_commit_interval(const char *var)
+{
+	timer_remove(&logsqlite_plugin, "logsqlite:commit");
+
+	if (config_logsqlite_commit_interval > 0)
+		timer_add(&logsqlite_plugin, "logsqlite:commit", config_logsqlite_commit_interval, 1, logsqlite_commit_timer, NULL);
+	else
+		logsqlite_commit();
+}
+
+#ifdef HAVE_LIBSQLITE3
+static void logsqlite_changed_wal(const char *var)
+{
+	if (!logsqlite_current_db)
+		return;
+
+	/* journal mode can't be changed inside a transaction */
+	logsqlite_commit();
+	sqlite3_exec(logsqlite_current_db, config_logsqlite_wal ? "PRAGMA journal_mode=WAL" : "PRAGMA journal_mode=DELETE", NULL, NULL, NULL);
+}
+
+/* setting fts to 0 drops the index, setting it back to 1 builds it from scratch */
+static void logsqlite_changed_fts(const char *var)
+{
+	if (!logsqlite_current_db)
+		return;
+
+	logsqlite_commit();
+
+	if (config_logsqlite_fts)
+		logsqlite_fts_mode = logsqlite_fts_prepare(logsqlite_current_db, logsqlite_current_db_path);
+	else {
+		logsqlite_fts_drop(logsqlite_current_db);
+		logsqlite_fts_mode = 0;
+	}
+}
+#endif
+
 int logsqlite_theme_init() {
 #ifndef NO_DEFAULT_THEME
 	format_add("logsqlite_open_error", "%! Can't open database: %1\n", 1);
+	format_add("logsqlite_fts_building", "%> Building full-text index in %T%1%n, it may take a while...\n", 1);
+	format_add("logsqlite_stats", "%> Rows: %T%1%n (%2/s), commits: %T%3%n, commit time avg %4 ms, max %5 ms, pending: %6\n", 1);
 #endif
 	return 0;
 }
@@ -844,11 +1196,17 @@ int logsqlite_plugin_init(int prio)
 	command_add(&logsqlite_plugin, "logsqlite:last", "puU puU puU puU puU", logsqlite_cmd_last, 0, "-n --number -s --search");
 	command_add(&logsqlite_plugin, "logsqlite:laststatus", "puU puU puU puU puU", logsqlite_cmd_laststatus, 0, "-n --number -s --search");
 	command_add(&logsqlite_plugin, "logsqlite:sync", NULL, logsqlite_cmd_sync, 0, 0);
+	command_add(&logsqlite_plugin, "logsqlite:stats", NULL, logsqlite_cmd_stats, 0, 0);
 
 	query_connect(&logsqlite_plugin, "protocol-message-post", logsqlite_msg_handler, NULL);
 	query_connect(&logsqlite_plugin, "protocol-status", logsqlite_status_handler, NULL);
 	query_connect(&logsqlite_plugin, "ui-window-new",	logsqlite_newwin_handler, NULL);
 
+	variable_add(&logsqlite_plugin, ("commit_interval"), VAR_INT, 1, &config_logsqlite_commit_interval, logsqlite_changed_commit_interval, NULL, NULL);
+	variable_add(&logsqlite_plugin, ("commit_rows"), VAR_INT, 1, &config_logsqlite_commit_rows, NULL, NULL, NULL);
+#ifdef HAVE_LIBSQLITE3
+	variable_add(&logsqlite_plugin, ("fts"), VAR_BOOL, 1, &config_logsqlite_fts, logsqlite_changed_fts, NULL, NULL);
+#endif
 	variable_add(&logsqlite_plugin, ("last_open_window"), VAR_BOOL, 1, &config_logsqlite_last_open_window, NULL, NULL, NULL);
 	variable_add(&logsqlite_plugin, ("last_in_window"), VAR_BOOL, 1, &config_logsqlite_last_in_window, NULL, NULL, NULL);
 	variable_add(&logsqlite_plugin, ("last_limit_msg"), VAR_INT, 1, &config_logsqlite_last_limit_msg, NULL, NULL, NULL);
@@ -858,6 +1216,12 @@ int logsqlite_plugin_init(int prio)
 	variable_add(&logsqlite_plugin, ("log_status"), VAR_BOOL, 1, &config_logsqlite_log_status, NULL, NULL, NULL);
 	variable_add(&logsqlite_plugin, ("log"), VAR_BOOL, 1, &config_logsqlite_log, NULL, NULL, NULL);
 	variable_add(&logsqlite_plugin, ("path"), VAR_DIR, 1, &config_logsqlite_path, NULL, NULL, NULL);
+#ifdef HAVE_LIBSQLITE3
+	variable_add(&logsqlite_plugin, ("wal"), VAR_BOOL, 1, &config_logsqlite_wal, logsqlite_changed_wal, NULL, NULL);
+#endif
+
+	logsqlite_stats.since = time(NULL);
+	logsqlite_changed_commit_interval(NULL);
 
 	debug("[logsqlite] plugin registered\n");
 
@@ -49,5 +49,9 @@ extern int config_logsqlite_last_print_on_open;
 extern int config_logsqlite_log;
 extern int config_logsqlite_log_ignored;
 extern int config_logsqlite_log_status;
+extern int config_logsqlite_commit_interval;
+extern int config_logsqlite_commit_rows;
+extern int config_logsqlite_wal;
+extern int config_logsqlite_fts;
 
 #endif
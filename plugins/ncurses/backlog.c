@@ -57,6 +57,216 @@ static inline int xmbswidth(const char *s, size_t n) {
 #endif
 }
 
+/*
+ * ncurses_backlog_resize()
+ *
+ * przenosi backlog do nowego bufora o alloc slotach, najstarsza linia
+ * trafia do slotu 0. alloc musi byc >= n->backlog_size.
+ */
+static void ncurses_backlog_resize(ncurses_window_t *n, int alloc)
+{
+	fstring_t **backlog = xmalloc(alloc * sizeof(fstring_t *));
+	int i;
+
+	for (i = 0; i < n->backlog_size; i++)
+		backlog[n->backlog_size - 1 - i] = ncurses_backlog_line(n, i);
+
+	xfree(n->backlog);
+	n->backlog = backlog;
+	n->backlog_alloc = alloc;
+	n->backlog_head = n->backlog_size - 1;
+}
+
+/*
+ * ncurses_lines_resize()
+ *
+ * jak wyzej, tylko dla linii ekranowych.
+ */
+static void ncurses_lines_resize(ncurses_window_t *n, int alloc)
+{
+	struct screen_line *lines = xmalloc(alloc * sizeof(struct screen_line));
+	int i;
+
+	for (i = 0; i < n->lines_count; i++)
+		lines[i] = *ncurses_screen_line(n, i);
+
+	xfree(n->lines);
+	n->lines = lines;
+	n->lines_alloc = alloc;
+	n->lines_first = 0;
+}
+
+/*
+ * ncurses_backlog_split_line()
+ *
+ * dzieli i-ta linie backloga na linie ekranowe, dopisywane na koncu.
+ * zwraca ich ilosc.
+ */
+static int ncurses_backlog_split_line(window_t *w, int i, const char *timestamp_format)
+{
+	ncurses_window_t *n = w->priv_data;
+	struct screen_line *l;
+	fstring_t *line = ncurses_backlog_line(n, i);
+	char *str; 
+	fstr_attr_t *attr;
+	int j, margin_left, wrapping = 0, count = 0;
+
+	time_t ts;			/* current ts */
+	time_t lastts = 0;		/* last cached ts */
+	char lasttsbuf[100];		/* last cached strftime() result */
+	int prompt_width;
+
+	str = line->str + line->prompt_len;
+	attr = line->attr + line->prompt_len;
+	ts = line->ts;
+	margin_left = (!w->floating) ? line->margin_left : -1;
+
+	prompt_width = xmbswidth(line->str, line->prompt_len);
+	
+	for (;;) {
+		int word, width;
+		int ts_width = 0;
+
+		count++;
+
+		if (n->lines_count == n->lines_alloc)
+			ncurses_lines_resize(n, n->lines_alloc ? n->lines_alloc * 2 : 16);
+
+		l = ncurses_screen_line(n, n->lines_count);
+		n->lines_count++;
+
+		l->str = (unsigned char *) str;
+		l->attr = attr;
+		l->len = xstrlen(str);
+		l->ts = NULL;
+		l->ts_attr = NULL;
+		l->backlog_seq = n->backlog_seq - 1 - i;
+		l->margin_left = (!wrapping || margin_left == -1) ? margin_left : 0;
+
+		l->prompt_len = line->prompt_len;
+		if (!line->prompt_empty) {
+			l->prompt_str = (unsigned char *) line->str;
+			l->prompt_attr = line->attr;
+		} else {
+			l->prompt_str = NULL;
+			l->prompt_attr = NULL;
+		}
+
+		if ((!w->floating || (w->id == WINDOW_LASTLOG_ID && ts)) && timestamp_format) {
+			fstring_t *s = NULL;
+
+			if (!ts || lastts != ts) {	/* generate new */
+				struct tm *tm = localtime(&ts);
+
+				strftime(lasttsbuf, sizeof(lasttsbuf)-1, timestamp_format, tm);
+				lastts = ts;
+			}
+
+			s = fstring_new(lasttsbuf);
+
+			l->ts = s->str;
+			ts_width = xmbswidth(l->ts, xstrlen(l->ts));
+			ts_width++;			/* for separator between timestamp and text */
+			l->ts_attr = s->attr;
+
+			xfree(s);
+		}
+
+		width = w->width - ts_width - prompt_width - n->margin_left - n->margin_right; 
+
+		if ((w->frames & WF_LEFT))
+			width -= 1;
+		if ((w->frames & WF_RIGHT))
+			width -= 1;
+#ifdef USE_UNICODE
+		{
+			int str_width = 0;
+
+			mbtowc(NULL, NULL, 0);
+
+			for (j = 0, word = 0; j < l->len;) {
+				wchar_t ch;
+				int ch_width;
+				int ch_len;
+
+				ch_len = mbtowc(&ch, &str[j], l->len - j);
+				if (ch_len == -1) {
+					ch = '?';
+					ch_len = 1;
+				}
+
+				if (ch == CHAR(' '))
+					word = j + 1;
+
+				if (str_width >= width) {
+					int old_len = l->len;
+
+					l->len = (!w->nowrap && word) ? word : 		/* XXX, (str_width > width) ? word-1 : word? */
+						(str_width > width && j) ? j /* - 1 */ : j;
+
+					/* avoid dead loop -- always move forward */
+					/* XXX, a co z bledami przy rysowaniu? moze lepiej str++; attr++; albo break? */
+					if (!l->len)
+						l->len = 1;
+
+					if ((ch_len = mbtowc(&ch, &str[l->len], old_len - l->len)) > 0 && ch == CHAR(' ')) {
+						l->len -= ch_len;
+						str += ch_len;
+						attr += ch_len;
+					}
+					break;
+				}
+
+				ch_width = wcwidth(ch);
+				if (ch_width == -1) /* not printable? */
+					ch_width = 1;		/* XXX: should be rendered as '?' with A_REVERSE. I hope wcwidth('?') is always 1. */
+				str_width += ch_width;
+				j += ch_len;
+			}
+			if (w->nowrap)
+				break;
+		}
+#else
+		if (l->len < width)
+			break;
+
+		if (w->nowrap) {
+			l->len = width;		/* XXX, what for? for not drawing outside screen-area? ncurses can handle with it */
+
+			if (str[width] == CHAR(' ')) {
+				l->len--;
+				/* str++; attr++; */
+			}
+			/* while (*str) { str++; attr++; } */
+			break;
+		}
+	
+		for (j = 0, word = 0; j < l->len; j++) {
+			if (str[j] == CHAR(' '))
+				word = j + 1;
+
+			if (j == width) {
+				l->len = (word) ? word : width;
+				if (str[j] == CHAR(' ')) {
+					l->len--;
+					str++;
+					attr++;
+				}
+				break;
+			}
+		}
+#endif
+		str += l->len;
+		attr += l->len;
+
+		if (! *str)
+			break;
+
+		wrapping = 1;
+	}
+	return count;
+}
+
 /*
  * ncurses_backlog_split()
  *
@@ -84,24 +294,29 @@ int ncurses_backlog_split(window_t *w, int full, int removed)
 		bottom = 1;
 	
 	/* mamy usun co z gry, bo wywalono lini z backloga. */
-	if (removed) {
-		for (i = 0; i < removed && i < n->lines_count; i++) {
-			xfree(n->lines[i].ts);
-			xfree(n->lines[i].ts_attr);
+	if (removed && n->lines_count) {
+		if (removed > n->lines_count)
+			removed = n->lines_count;
+
+		for (i = 0; i < removed; i++) {
+			xfree(ncurses_screen_line(n, i)->ts);
+			xfree(ncurses_screen_line(n, i)->ts_attr);
 		}
-		memmove(&n->lines[0], &n->lines[removed], sizeof(struct screen_line) * (n->lines_count - removed));
+		n->lines_first = (n->lines_first + removed) % n->lines_alloc;
 		n->lines_count -= removed;
 	}
 
 	/* jeli robimy pene przebudowanie backloga, czycimy wszystko */
 	if (full) {
 		for (i = 0; i < n->lines_count; i++) {
-			xfree(n->lines[i].ts);
-			xfree(n->lines[i].ts_attr);
+			xfree(ncurses_screen_line(n, i)->ts);
+			xfree(ncurses_screen_line(n, i)->ts_attr);
 		}
 		n->lines_count = 0;
 		xfree(n->lines);
 		n->lines = NULL;
+		n->lines_alloc = 0;
+		n->lines_first = 0;
 	}
 
 	if (config_timestamp_show)
@@ -109,163 +324,10 @@ int ncurses_backlog_split(window_t *w, int full, int removed)
 
 	/* jeli upgrade... jeli pene przebudowanie... */
 	for (i = (!full) ? 0 : (n->backlog_size - 1); i >= 0; i--) {
-		struct screen_line *l;
-		char *str; 
-		fstr_attr_t *attr;
-		int j, margin_left, wrapping = 0;
-
-		time_t ts;			/* current ts */
-		time_t lastts = 0;		/* last cached ts */
-		char lasttsbuf[100];		/* last cached strftime() result */
-		int prompt_width;
-
-		str = n->backlog[i]->str + n->backlog[i]->prompt_len;
-		attr = n->backlog[i]->attr + n->backlog[i]->prompt_len;
-		ts = n->backlog[i]->ts;
-		margin_left = (!w->floating) ? n->backlog[i]->margin_left : -1;
-
-		prompt_width = xmbswidth(n->backlog[i]->str, n->backlog[i]->prompt_len);
-		
-		for (;;) {
-			int word, width;
-			int ts_width = 0;
-
-			if (!i)
-				res++;
-
-			n->lines_count++;
-			n->lines = xrealloc(n->lines, n->lines_count * sizeof(struct screen_line));
-			l = &n->lines[n->lines_count - 1];
-
-			l->str = (unsigned char *) str;
-			l->attr = attr;
-			l->len = xstrlen(str);
-			l->ts = NULL;
-			l->ts_attr = NULL;
-			l->backlog = i;
-			l->margin_left = (!wrapping || margin_left == -1) ? margin_left : 0;
-
-			l->prompt_len = n->backlog[i]->prompt_len;
-			if (!n->backlog[i]->prompt_empty) {
-				l->prompt_str = (unsigned char *) n->backlog[i]->str;
-				l->prompt_attr = n->backlog[i]->attr;
-			} else {
-				l->prompt_str = NULL;
-				l->prompt_attr = NULL;
-			}
-
-			if ((!w->floating || (w->id == WINDOW_LASTLOG_ID && ts)) && timestamp_format) {
-				fstring_t *s = NULL;
-
-				if (!ts || lastts != ts) {	/* generate new */
-					struct tm *tm = localtime(&ts);
-
-					strftime(lasttsbuf, sizeof(lasttsbuf)-1, timestamp_format, tm);
-					lastts = ts;
-				}
-
-				s = fstring_new(lasttsbuf);
-
-				l->ts = s->str;
-				ts_width = xmbswidth(l->ts, xstrlen(l->ts));
-				ts_width++;			/* for separator between timestamp and text */
-				l->ts_attr = s->attr;
-
-				xfree(s);
-			}
-
-			width = w->width - ts_width - prompt_width - n->margin_left - n->margin_right; 
-
-			if ((w->frames & WF_LEFT))
-				width -= 1;
-			if ((w->frames & WF_RIGHT))
-				width -= 1;
-#ifdef USE_UNICODE
-			{
-				int str_width = 0;
-
-				mbtowc(NULL, NULL, 0);
-
-				for (j = 0, word = 0; j < l->len;) {
-					wchar_t ch;
-					int ch_width;
-					int ch_len;
-
-					ch_len = mbtowc(&ch, &str[j], l->len - j);
-					if (ch_len == -1) {
-						ch = '?';
-						ch_len = 1;
-					}
-
-					if (ch == CHAR(' '))
-						word = j + 1;
-
-					if (str_width >= width) {
-						int old_len = l->len;
-
-						l->len = (!w->nowrap && word) ? word : 		/* XXX, (str_width > width) ? word-1 : word? */
-							(str_width > width && j) ? j /* - 1 */ : j;
-
-						/* avoid dead loop -- always move forward */
-						/* XXX, a co z bledami przy rysowaniu? moze lepiej str++; attr++; albo break? */
-						if (!l->len)
-							l->len = 1;
-
-						if ((ch_len = mbtowc(&ch, &str[l->len], old_len - l->len)) > 0 && ch == CHAR(' ')) {
-							l->len -= ch_len;
-							str += ch_len;
-							attr += ch_len;
-						}
-						break;
-					}
-
-					ch_width = wcwidth(ch);
-					if (ch_width == -1) /* not printable? */
-						ch_width = 1;		/* XXX: should be rendered as '?' with A_REVERSE. I hope wcwidth('?') is always 1. */
-					str_width += ch_width;
-					j += ch_len;
-				}
-				if (w->nowrap)
-					break;
-			}
-#else
-			if (l->len < width)
-				break;
-
-			if (w->nowrap) {
-				l->len = width;		/* XXX, what for? for not drawing outside screen-area? ncurses can handle with it */
-
-				if (str[width] == CHAR(' ')) {
-					l->len--;
-					/* str++; attr++; */
-				}
-				/* while (*str) { str++; attr++; } */
-				break;
-			}
-		
-			for (j = 0, word = 0; j < l->len; j++) {
-				if (str[j] == CHAR(' '))
-					word = j + 1;
-
-				if (j == width) {
-					l->len = (word) ? word : width;
-					if (str[j] == CHAR(' ')) {
-						l->len--;
-						str++;
-						attr++;
-					}
-					break;
-				}
-			}
-#endif
-			str += l->len;
-			attr += l->len;
-
-			if (! *str)
-				break;
+		int count = ncurses_backlog_split_line(w, i, timestamp_format);
 
-			wrapping = 1;
-		}
+		if (!i)
+			res = count;
 	}
 
 	if (bottom) {
@@ -285,37 +347,45 @@ int ncurses_backlog_split(window_t *w, int full, int removed)
 }
 
 /*
+ * ncurses_backlog_add_real()
  *
+ * dodaje linie do backloga okna, w razie potrzeby wyrzucajac najstarsza.
+ * backlog i linie ekranowe sa buforami cyklicznymi, wiec nic nie jest
+ * przesuwane, a dzielona jest tylko nowa linia.
  */
 int ncurses_backlog_add_real(window_t *w, /*locale*/ fstring_t *str) {
-	int i, removed = 0;
-	ncurses_window_t *n = w->priv_data;
+	int removed = 0;
+	ncurses_window_t *n;
 	
-	if (!w)
+	if (!w || !(n = w->priv_data))
 		return 0;
 
-	if (n->backlog_size == config_backlog_size) {
-		fstring_t *line = n->backlog[n->backlog_size - 1];
-		int i;
+	if (n->backlog_size >= config_backlog_size && n->backlog_size) {
+		const unsigned int seq = n->backlog_seq - n->backlog_size;	/* najstarsza linia */
 
-		for (i = 0; i < n->lines_count; i++) {
-			if (n->lines[i].backlog == n->backlog_size - 1)
-				removed++;
-		}
+		/* linie ekranowe najstarszej linii sa zawsze na samej gorze */
+		while (removed < n->lines_count && ncurses_screen_line(n, removed)->backlog_seq == seq)
+			removed++;
 
-		fstring_free(line);
+		fstring_free(ncurses_backlog_line(n, n->backlog_size - 1));
 
 		n->backlog_size--;
-	} else 
-		n->backlog = xrealloc(n->backlog, (n->backlog_size + 1) * sizeof(fstring_t *));
+	} else if (n->backlog_size == n->backlog_alloc) {
+		int alloc = n->backlog_alloc ? n->backlog_alloc * 2 : 16;
 
-	memmove(&n->backlog[1], &n->backlog[0], n->backlog_size * sizeof(fstring_t *));
-	n->backlog[0] = str;
+		if (alloc > config_backlog_size)
+			alloc = config_backlog_size;
+		if (alloc <= n->backlog_size)
+			alloc = n->backlog_size + 1;
 
-	n->backlog_size++;
+		ncurses_backlog_resize(n, alloc);
+	}
 
-	for (i = 0; i < n->lines_count; i++)
-		n->lines[i].backlog++;
+	n->backlog_head = (n->backlog_head + 1) % n->backlog_alloc;
+	n->backlog[n->backlog_head] = str;
+
+	n->backlog_size++;
+	n->backlog_seq++;
 
 	return ncurses_backlog_split(w, 0, removed);
 }
@@ -338,6 +408,252 @@ int ncurses_backlog_add(window_t *w, const fstring_t *str) {
 }
 
 
+/*
+ * ncurses_lines_find()
+ *
+ * numer pierwszej linii ekranowej i-tej linii backloga (0 - najnowsza), albo
+ * miejsca, w ktorym by byla. linie ekranowe ida od najstarszej.
+ */
+static int ncurses_lines_find(ncurses_window_t *n, int i)
+{
+	int lo = 0, hi = n->lines_count;
+
+	while (lo < hi) {
+		int mid = lo + (hi - lo) / 2;
+
+		if (ncurses_screen_line_backlog(n, ncurses_screen_line(n, mid)) > i)
+			lo = mid + 1;
+		else
+			hi = mid;
+	}
+	return lo;
+}
+
+/*
+ * ncurses_lines_reseq()
+ *
+ * zmienia o delta backlog_seq linii ekranowych linii backloga od from do to-1.
+ */
+static void ncurses_lines_reseq(ncurses_window_t *n, int from, int to, int delta)
+{
+	int t, end = ncurses_lines_find(n, from - 1);
+
+	for (t = ncurses_lines_find(n, to - 1); t < end; t++)
+		ncurses_screen_line(n, t)->backlog_seq += delta;
+}
+
+/*
+ * ncurses_lines_open()
+ *
+ * robi miejsce na k linii ekranowych przed pos-ta, przesuwajac krotsza
+ * czesc bufora.
+ */
+static void ncurses_lines_open(ncurses_window_t *n, int pos, int k)
+{
+	int t;
+
+	if (!k)
+		return;
+
+	if (n->lines_count + k > n->lines_alloc) {
+		int alloc = n->lines_alloc ? n->lines_alloc * 2 : 16;
+
+		while (alloc < n->lines_count + k)
+			alloc *= 2;
+		ncurses_lines_resize(n, alloc);
+	}
+
+	if (pos >= n->lines_count - pos) {
+		for (t = n->lines_count - 1; t >= pos; t--)
+			*ncurses_screen_line(n, t + k) = *ncurses_screen_line(n, t);
+	} else {
+		n->lines_first = (n->lines_first + n->lines_alloc - k) % n->lines_alloc;
+		for (t = 0; t < pos; t++)
+			*ncurses_screen_line(n, t) = *ncurses_screen_line(n, t + k);
+	}
+	n->lines_count += k;
+}
+
+/*
+ * ncurses_lines_close()
+ *
+ * usuwa k linii ekranowych od pos-tej, przesuwajac krotsza czesc bufora.
+ */
+static void ncurses_lines_close(ncurses_window_t *n, int pos, int k)
+{
+	int t;
+
+	if (!k)
+		return;
+
+	for (t = pos; t < pos + k; t++) {
+		xfree(ncurses_screen_line(n, t)->ts);
+		xfree(ncurses_screen_line(n, t)->ts_attr);
+	}
+
+	if (pos >= n->lines_count - pos - k) {
+		for (t = pos; t < n->lines_count - k; t++)
+			*ncurses_screen_line(n, t) = *ncurses_screen_line(n, t + k);
+	} else {
+		for (t = pos - 1; t >= 0; t--)
+			*ncurses_screen_line(n, t + k) = *ncurses_screen_line(n, t);
+		n->lines_first = (n->lines_first + k) % n->lines_alloc;
+	}
+	n->lines_count -= k;
+}
+
+/*
+ * ncurses_lines_drop()
+ *
+ * usuwa linie ekranowe i-tej linii backloga, zwraca miejsce, w ktorym byly.
+ */
+static int ncurses_lines_drop(ncurses_window_t *n, int i)
+{
+	int pos = ncurses_lines_find(n, i);
+	int k = 0;
+
+	while (pos + k < n->lines_count && ncurses_screen_line_backlog(n, ncurses_screen_line(n, pos + k)) == i)
+		k++;
+
+	ncurses_lines_close(n, pos, k);
+	return pos;
+}
+
+/*
+ * ncurses_backlog_split_at()
+ *
+ * dzieli tylko i-ta linie backloga, jej linie ekranowe wstawia przed pos-ta.
+ */
+static void ncurses_backlog_split_at(window_t *w, int i, int pos)
+{
+	ncurses_window_t *n = w->priv_data;
+	struct screen_line tmp[8], *lines = tmp;
+	int k, t;
+
+	k = ncurses_backlog_split_line(w, i, config_timestamp_show ? formated_config_timestamp : NULL);
+
+	if (k > (int) G_N_ELEMENTS(tmp))
+		lines = g_new(struct screen_line, k);
+
+	for (t = 0; t < k; t++)
+		lines[t] = *ncurses_screen_line(n, n->lines_count - k + t);
+	n->lines_count -= k;
+
+	ncurses_lines_open(n, pos, k);
+	for (t = 0; t < k; t++)
+		*ncurses_screen_line(n, pos + t) = lines[t];
+
+	if (lines != tmp)
+		g_free(lines);
+
+	n->redraw = 1;
+}
+
+/*
+ * ncurses_backlog_set()
+ *
+ * podmienia i-ta linie backloga (0 - najnowsza) na kopie str, dzielac
+ * na nowo tylko ja.
+ */
+void ncurses_backlog_set(window_t *w, int i, const fstring_t *str) {
+	ncurses_window_t *n = w->priv_data;
+	int pos;
+
+	if (i < 0 || i >= n->backlog_size)
+		return;
+
+	pos = ncurses_lines_drop(n, i);
+
+	fstring_free(ncurses_backlog_line(n, i));
+	ncurses_backlog_line(n, i) = ekg_recode_fstr_to_locale(str);
+	n->backlog_gen++;
+
+	ncurses_backlog_split_at(w, i, pos);
+}
+
+/*
+ * ncurses_backlog_insert()
+ *
+ * wstawia kopie str tak, zeby byla i-ta linia backloga (0 - najnowsza),
+ * starsze linie sie przesuwaja. w buforze cyklicznym przesuwana jest
+ * krotsza czesc, dzielona jest tylko nowa linia.
+ *
+ * -1 jesli backlog jest pelny (nie wyrzucamy przy tym nic).
+ */
+int ncurses_backlog_insert(window_t *w, int i, const fstring_t *str) {
+	ncurses_window_t *n = w->priv_data;
+	int pos, t;
+
+	if (i < 0 || i > n->backlog_size || n->backlog_size >= config_backlog_size)
+		return -1;
+
+	if (n->backlog_size == n->backlog_alloc)
+		ncurses_backlog_resize(n, MIN(n->backlog_alloc ? n->backlog_alloc * 2 : 16, config_backlog_size));
+
+	/* nowa linia bedzie pod starszymi, a nad nowszymi */
+	pos = ncurses_lines_find(n, i - 1);
+
+	if (i < n->backlog_size - i) {
+		/* nowsze linie o slot do przodu, ich numery rosna */
+		ncurses_lines_reseq(n, 0, i, 1);
+
+		n->backlog_head = (n->backlog_head + 1) % n->backlog_alloc;
+		for (t = 0; t < i; t++)
+			ncurses_backlog_line(n, t) = ncurses_backlog_line(n, t + 1);
+		n->backlog_seq++;
+	} else {
+		/* starsze linie o slot do tylu */
+		ncurses_lines_reseq(n, i, n->backlog_size, -1);
+
+		for (t = n->backlog_size; t > i; t--)
+			ncurses_backlog_line(n, t) = ncurses_backlog_line(n, t - 1);
+	}
+
+	ncurses_backlog_line(n, i) = ekg_recode_fstr_to_locale(str);
+	n->backlog_size++;
+	n->backlog_gen++;
+
+	ncurses_backlog_split_at(w, i, pos);
+
+	return 0;
+}
+
+/*
+ * ncurses_backlog_remove()
+ *
+ * usuwa i-ta linie backloga (0 - najnowsza) razem z jej liniami ekranowymi.
+ */
+void ncurses_backlog_remove(window_t *w, int i) {
+	ncurses_window_t *n = w->priv_data;
+	int t;
+
+	if (i < 0 || i >= n->backlog_size)
+		return;
+
+	ncurses_lines_drop(n, i);
+	fstring_free(ncurses_backlog_line(n, i));
+
+	if (i < n->backlog_size - 1 - i) {
+		/* nowsze linie o slot do tylu */
+		ncurses_lines_reseq(n, 0, i, -1);
+
+		for (t = i; t > 0; t--)
+			ncurses_backlog_line(n, t) = ncurses_backlog_line(n, t - 1);
+		n->backlog_head = (n->backlog_head + n->backlog_alloc - 1) % n->backlog_alloc;
+		n->backlog_seq--;
+	} else {
+		/* starsze linie o slot do przodu */
+		ncurses_lines_reseq(n, i + 1, n->backlog_size, 1);
+
+		for (t = i; t < n->backlog_size - 1; t++)
+			ncurses_backlog_line(n, t) = ncurses_backlog_line(n, t + 1);
+	}
+
+	n->backlog_size--;
+	n->backlog_gen++;
+	n->redraw = 1;
+}
+
 /*
  * changed_backlog_size()
  *
@@ -358,10 +674,10 @@ void changed_backlog_size(const char *var)
 			continue;
 				
 		for (i = config_backlog_size; i < n->backlog_size; i++)
-			fstring_free(n->backlog[i]);
+			fstring_free(ncurses_backlog_line(n, i));
 
 		n->backlog_size = config_backlog_size;
-		n->backlog = xrealloc(n->backlog, n->backlog_size * sizeof(fstring_t *));
+		ncurses_backlog_resize(n, n->backlog_size);
 
 		ncurses_backlog_split(w, 1, 0);
 	}
@@ -4,5 +4,9 @@
 int ncurses_backlog_add(window_t *w, const fstring_t *str);
 int ncurses_backlog_split(window_t *w, int full, int removed);
 
+void ncurses_backlog_set(window_t *w, int i, const fstring_t *str);
+int ncurses_backlog_insert(window_t *w, int i, const fstring_t *str);
+void ncurses_backlog_remove(window_t *w, int i);
+
 #endif
 
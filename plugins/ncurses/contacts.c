@@ -23,6 +23,8 @@
 
 #include "ekg2.h"
 
+#include <string.h>
+
 #include "backlog.h"
 #include "bindings.h"
 #include "contacts.h"
@@ -78,6 +80,230 @@ static int contacts_compare(void *data1, void *data2)
 	return g_utf8_collate(a->nickname, b->nickname);
 }
 
+/*
+ * contacts model, lets ncurses_contacts_update_user() change rows of single
+ * contact instead of rebuilding whole window. It's kept only for simple view
+ * (one userlist, contacts ordered by state, no wrapping), where every backlog
+ * line is exactly one row. Rows are kept in GSequence, ordered like
+ * ncurses_contacts_update() shows them, so both position of row and place for
+ * new one are found in O(log n).
+ */
+typedef struct {
+	userlist_t	*u;		/* contact, NULL for headers and footers (only used as a key, never dereferenced) */
+	int		section;	/* offset in contacts_order, or CONTACTS_SECTION_* */
+	int		footer;		/* 1 for footers */
+	char		*uid;		/* copies, u might have been freed, and its address reused */
+	char		*nickname;
+} contacts_row_t;
+
+#define CONTACTS_SECTION_HEADER	-1		/* window header */
+#define CONTACTS_SECTION_FOOTER	G_MAXINT	/* window footer */
+
+static GSequence *contacts_rows = NULL;		/* contacts_row_t, from the top, n-th row is backlog line len-1-n */
+static GHashTable *contacts_rows_index = NULL;	/* userlist_t * -> GSequenceIter * */
+
+static int contacts_model_valid = 0;
+static userlist_t **contacts_model_list;	/* shown userlist */
+static session_t *contacts_model_session;
+static window_t *contacts_model_window;
+static int contacts_model_group_index;
+static char *contacts_model_group;
+
+static void contacts_row_free(gpointer data) {
+	contacts_row_t *row = data;
+
+	xfree(row->uid);
+	xfree(row->nickname);
+	xfree(row);
+}
+
+/* headers, then contacts (like in userlist, by nickname), then footers */
+static inline int contacts_row_kind(const contacts_row_t *row) {
+	return row->u ? 1 : row->footer ? 2 : 0;
+}
+
+static gint contacts_row_compare(gconstpointer a, gconstpointer b, gpointer data) {
+	const contacts_row_t *r1 = a, *r2 = b;
+
+	if (r1->section != r2->section)
+		return (r1->section < r2->section) ? -1 : 1;
+
+	if (contacts_row_kind(r1) != contacts_row_kind(r2))
+		return contacts_row_kind(r1) - contacts_row_kind(r2);
+
+	return r1->u ? xstrcoll(r1->nickname, r2->nickname) : 0;
+}
+
+static void contacts_model_reset(void) {
+	if (!contacts_rows_index)
+		contacts_rows_index	= g_hash_table_new(g_direct_hash, g_direct_equal);
+	else
+		g_hash_table_remove_all(contacts_rows_index);
+
+	if (contacts_rows)
+		g_sequence_free(contacts_rows);
+	contacts_rows = g_sequence_new(contacts_row_free);
+
+	xfree(contacts_model_group);
+	contacts_model_group = NULL;
+	contacts_model_valid = 0;
+}
+
+static inline contacts_row_t *contacts_row_get(GSequenceIter *iter) {
+	return (iter && !g_sequence_iter_is_end(iter)) ? g_sequence_get(iter) : NULL;
+}
+
+/* index of backlog line (0 - the newest) with row */
+static inline int contacts_row_line(GSequenceIter *iter) {
+	return g_sequence_get_length(contacts_rows) - 1 - g_sequence_iter_get_position(iter);
+}
+
+/*
+ * contacts_row_insert()
+ *
+ * inserts str to window as row before @a before, and remembers it in model.
+ * before == NULL means at the end.
+ */
+static int contacts_row_insert(window_t *w, GSequenceIter *before, const fstring_t *str, userlist_t *u, int section, int footer) {
+	contacts_row_t *row;
+	GSequenceIter *iter;
+
+	if (!before)
+		ncurses_backlog_add(w, str);
+	else if (ncurses_backlog_insert(w, contacts_row_line(before) + 1, str))
+		return -1;
+
+	row		= xmalloc(sizeof(contacts_row_t));
+	row->u		= u;
+	row->section	= section;
+	row->footer	= footer;
+
+	if (u) {
+		row->uid	= xstrdup(u->uid);
+		row->nickname	= xstrdup(u->nickname);
+	}
+
+	iter = before ? g_sequence_insert_before(before, row) : g_sequence_append(contacts_rows, row);
+
+	if (u)
+		g_hash_table_insert(contacts_rows_index, u, iter);
+	return 0;
+}
+
+static void contacts_row_delete(window_t *w, GSequenceIter *iter) {
+	contacts_row_t *row = g_sequence_get(iter);
+
+	ncurses_backlog_remove(w, contacts_row_line(iter));
+	if (row->u)
+		g_hash_table_remove(contacts_rows_index, row->u);
+	g_sequence_remove(iter);
+}
+
+/*
+ * contacts_group_hidden()
+ *
+ * checks if contact should be hidden, because of current group.
+ */
+static int contacts_group_hidden(userlist_t *u, const char *group) {
+	userlist_t *tmp;
+
+	if (!group || u->priv_data == (void *) 2)
+		return 0;
+
+	tmp = userlist_find(u->priv_data ? u->priv_data : session_current, u->uid);
+
+	return ((group[0]=='!' && ekg_group_member(tmp, group+1)) ||
+			(group[0]!='!' && !ekg_group_member(tmp, group)));
+}
+
+/*
+ * contacts_section()
+ *
+ * returns offset in contacts_order of status in which contact is shown, or -1
+ * if it's not shown. If !config_contacts_orderbystate all contacts are in 0.
+ */
+static int contacts_section(userlist_t *u, const char *group) {
+	const char *status_t;
+	int j;
+
+	if (!u->nickname || !u->status || contacts_group_hidden(u, group))
+		return -1;
+
+	status_t = ekg_status_string(u->status, 0);
+
+	/* when !config_contacts_orderbystate, we need to have got this status in contacts_order anywhere. */
+	if (!config_contacts_orderbystate)
+		return xstrstr(contacts_order, get_short_status(status_t)) ? 0 : -1;
+
+	for (j = 0; j < corderlen; j += 2) {
+		if (!xstrncmp(contacts_order + j, u->status == EKG_STATUS_NA && u->typing ? "ty" : status_t, 2))
+			return j;
+	}
+	return -1;
+}
+
+/*
+ * contacts_format()
+ *
+ * formats row of contact, string->priv_data is set to target used by mouse handler.
+ */
+static fstring_t *contacts_format(userlist_t *u, const char *status_t) {
+	fstring_t *string;
+	char tmp[100];
+
+	if (u->descr && config_contacts_descr)
+		snprintf(tmp, sizeof(tmp), "contacts_%s_descr_full", status_t);
+	else if (u->descr && !config_contacts_descr)
+		snprintf(tmp, sizeof(tmp), "contacts_%s_descr", status_t);
+	else
+		snprintf(tmp, sizeof(tmp), "contacts_%s", status_t);
+
+	if (u->blink)
+		xstrcat(tmp, "_blink");
+	if (u->typing)
+		xstrcat(tmp, "_typing");
+
+	string = fstring_new_format(format_find(tmp), u->nickname, u->descr);
+
+		/* used in mouse handler, do not recode */
+	if (u->priv_data == (void *) 2)
+		string->priv_data = g_strdup(u->nickname);
+	else
+		string->priv_data = g_strdup_printf("%s/%s", (u->priv_data) ? ((session_t *) u->priv_data)->uid : session_current->uid, u->nickname);
+
+	return string;
+}
+
+/*
+ * contacts_status_format()
+ *
+ * formats header or footer of status section, NULL if there's none.
+ */
+static fstring_t *contacts_status_format(const char *status_t, int footer) {
+	const char *format;
+	char tmp[100];
+
+	snprintf(tmp, sizeof(tmp), "contacts_%s_%s", status_t, footer ? "footer" : "header");
+	format = format_find(tmp);
+
+	return format_ok(format) ? fstring_new_format(format) : NULL;
+}
+
+static void contacts_restore_start(window_t *w, int old_start) {
+	ncurses_window_t *n = w->priv_data;
+
+	n->start = old_start;
+
+	if (n->start > n->lines_count - w->height + n->overflow)
+		n->start = n->lines_count - w->height + n->overflow;
+
+	if (n->start < 0)
+		n->start = 0;
+
+	n->redraw = 1;
+	ncurses_redraw(w);
+}
+
 /*
  * userlist_dup()
  *
@@ -132,6 +358,7 @@ int ncurses_contacts_update(window_t *w, int save_pos) {
 		old_start = 0;
 
 	ncurses_clear(w, 1);
+	contacts_model_reset();
 
 	if (!session_current)
 		goto kon;
@@ -182,7 +409,7 @@ int ncurses_contacts_update(window_t *w, int save_pos) {
 
 	if (format_ok(header)) {
 		fstring_t *fstr = fstring_new_format(header, group);
-		ncurses_backlog_add(w, fstr);
+		contacts_row_insert(w, NULL, fstr, NULL, CONTACTS_SECTION_HEADER, 0);
 		fstring_free(fstr);
 	}
 
@@ -272,12 +499,14 @@ int ncurses_contacts_update(window_t *w, int save_pos) {
 	}
 
 	if (!all) {
-		sorted_all = session_current->userlist;
+		contacts_model_list = &session_current->userlist;
 
 		if (c && c->participants)
-			sorted_all = c->participants;
+			contacts_model_list = &c->participants;
 		else if (window_current->userlist)
-			sorted_all = window_current->userlist;
+			contacts_model_list = &window_current->userlist;
+
+		sorted_all = *contacts_model_list;
 	}
 
 	if (!sorted_all)
@@ -286,65 +515,31 @@ int ncurses_contacts_update(window_t *w, int save_pos) {
 	for (j = 0; j < corderlen; /* xstrlen(contacts_order); */ j += 2) {
 		const char *footer_status = NULL;
 		int count = 0;
-		char tmp[100];
 		userlist_t *ul;
 
 		for (ul = sorted_all; ul; ul = ul->next) {
 			userlist_t *u = ul;
 
 			const char *status_t;
-			const char *format;
 			fstring_t *string;
 
-			if (!u->nickname || !u->status)
+			if (contacts_section(u, group) != j)
 				continue;
 
 			status_t = ekg_status_string(u->status, 0);
 
-			if (config_contacts_orderbystate ?
-				xstrncmp(contacts_order + j, u->status == EKG_STATUS_NA && u->typing ? "ty" : status_t, 2) :	/* when config_contacts_orderbystate, we need to have got this status in contacts_order now. */
-				!xstrstr(contacts_order, get_short_status(status_t)))	/* when !config_contacts_orderbystate, we need to have got this status in contacts_order anywhere. */
-					continue;
-
-			if (group && (!u->priv_data || (void *) 2 != u->priv_data)) {
-				userlist_t *tmp = userlist_find(u->priv_data ? u->priv_data : session_current, u->uid);
-				if ((group[0]=='!' && ekg_group_member(tmp, group+1)) ||
-						(group[0]!='!' && !ekg_group_member(tmp, group)))
-					continue;
-			}
-
 			if (!count) {
-				snprintf(tmp, sizeof(tmp), "contacts_%s_header", status_t);
-				format = format_find(tmp);
-				if (format_ok(format)) {
-					fstring_t *fstr = fstring_new_format(format);
-					ncurses_backlog_add(w, fstr);
+				fstring_t *fstr = contacts_status_format(status_t, 0);
+
+				if (fstr) {
+					contacts_row_insert(w, NULL, fstr, NULL, j, 0);
 					fstring_free(fstr);
 				}
 				footer_status = status_t;
 			}
 
-			if (u->descr && config_contacts_descr)
-				snprintf(tmp, sizeof(tmp), "contacts_%s_descr_full", status_t);
-			else if (u->descr && !config_contacts_descr)
-				snprintf(tmp, sizeof(tmp), "contacts_%s_descr", status_t);
-			else
-				snprintf(tmp, sizeof(tmp), "contacts_%s", status_t);
-
-			if (u->blink)
-				xstrcat(tmp, "_blink");
-			if (u->typing)
-				xstrcat(tmp, "_typing");
-
-			string = fstring_new_format(format_find(tmp), u->nickname, u->descr);
-
-				/* used in mouse handler, do not recode */
-			if (u->priv_data == (void *) 2)
-				string->priv_data = g_strdup(u->nickname);
-			else
-				string->priv_data = g_strdup_printf("%s/%s", (u->priv_data) ? ((session_t *) u->priv_data)->uid : session_current->uid, u->nickname);
-
-			ncurses_backlog_add(w, string);
+			string = contacts_format(u, status_t);
+			contacts_row_insert(w, NULL, string, all ? NULL : u, j, 0);
 			string->priv_data = NULL; /* XXX: stop freeing this in fstring_free()! */
 			fstring_free(string);
 
@@ -352,14 +547,10 @@ int ncurses_contacts_update(window_t *w, int save_pos) {
 		}
 
 		if (count) {
-			const char *format;
+			fstring_t *fstr = contacts_status_format(footer_status, 1);
 
-			snprintf(tmp, sizeof(tmp), "contacts_%s_footer", footer_status);
-			format = format_find(tmp);
-
-			if (format_ok(format)) {
-				fstring_t *fstr = fstring_new_format(format);
-				ncurses_backlog_add(w, fstr);
+			if (fstr) {
+				contacts_row_insert(w, NULL, fstr, NULL, j, 1);
 				fstring_free(fstr);
 			}
 		}
@@ -371,29 +562,195 @@ int ncurses_contacts_update(window_t *w, int save_pos) {
 after_loop:
 	if (format_ok(footer)) {
 		fstring_t *fstr = fstring_new_format(footer, group);
-		ncurses_backlog_add(w, fstr);
+		contacts_row_insert(w, NULL, fstr, NULL, CONTACTS_SECTION_FOOTER, 1);
 		fstring_free(fstr);
 	}
 	if (all)
 		LIST_DESTROY2(sorted_all, NULL);
 
+	/* model is usable only if every row is still in backlog and takes one line */
+	if (!all && w->nowrap && config_contacts_orderbystate && n->backlog_size == g_sequence_get_length(contacts_rows)) {
+		contacts_model_valid		= 1;
+		contacts_model_session		= session_current;
+		contacts_model_window		= window_current;
+		contacts_model_group_index	= contacts_group_index;
+		contacts_model_group		= group;
+		group = NULL;
+	}
+
 	xfree(group);
 
 kon:
-/* restore old index */
-	n->start = old_start;
+/* restore old index, and redraw */
+	contacts_restore_start(w, old_start);
 
-	if (n->start > n->lines_count - w->height + n->overflow)
-		n->start = n->lines_count - w->height + n->overflow;
+	return -1;
+}
 
-	if (n->start < 0)
-		n->start = 0;
+/*
+ * contacts_model_check()
+ *
+ * checks if model still describes what ncurses_contacts_update() would show.
+ */
+static int contacts_model_check(window_t *w) {
+	newconference_t *c;
+	userlist_t **list;
 
-/* redraw */
-	n->redraw = 1;
-	ncurses_redraw(w);
+	if (!contacts_model_valid || !w->nowrap || !config_contacts_orderbystate)
+		return 0;
 
-	return -1;
+	if (contacts_model_session != session_current || contacts_model_window != window_current || contacts_model_group_index != contacts_group_index)
+		return 0;
+
+	c = newconference_find(window_current->session, window_current->target);
+
+	if (c && c->participants)
+		list = &c->participants;
+	else if (window_current->userlist)
+		list = &window_current->userlist;
+	else
+		list = &session_current->userlist;
+
+	return (list == contacts_model_list);
+}
+
+/*
+ * contacts_user_remove()
+ *
+ * removes row of contact, and header and footer of its status if it was the last one.
+ */
+static void contacts_user_remove(window_t *w, GSequenceIter *iter) {
+	contacts_row_t *row = g_sequence_get(iter);
+	int section = row->section;
+	GSequenceIter *prev_iter, *next_iter;
+	contacts_row_t *prev, *next;
+
+	prev_iter = g_sequence_iter_is_begin(iter) ? NULL : g_sequence_iter_prev(iter);
+	next_iter = g_sequence_iter_next(iter);
+
+	contacts_row_delete(w, iter);
+
+	prev = contacts_row_get(prev_iter);
+	next = contacts_row_get(next_iter);
+
+	if ((prev && prev->u && prev->section == section) || (next && next->u && next->section == section))
+		return;
+
+	if (next && next->footer && next->section == section)
+		contacts_row_delete(w, next_iter);
+	if (prev && !prev->footer && prev->section == section)
+		contacts_row_delete(w, prev_iter);
+}
+
+/*
+ * contacts_user_insert()
+ *
+ * inserts contact to its status (creating header and footer if needed),
+ * in the same order as ncurses_contacts_update() would.
+ */
+static int contacts_user_insert(window_t *w, userlist_t *u, int section) {
+	const char *status_t = ekg_status_string(u->status, 0);
+	contacts_row_t key, *prev, *next;
+	GSequenceIter *iter;
+	fstring_t *string;
+	int res, new_section;
+
+	key.u		= u;
+	key.section	= section;
+	key.footer	= 0;
+	key.nickname	= u->nickname;
+
+	iter = g_sequence_search(contacts_rows, &key, contacts_row_compare, NULL);
+
+	prev = g_sequence_iter_is_begin(iter) ? NULL : g_sequence_get(g_sequence_iter_prev(iter));
+	next = contacts_row_get(iter);
+
+	new_section = !(prev && prev->section == section) && !(next && next->section == section);
+
+	if (new_section && (string = contacts_status_format(status_t, 0))) {
+		res = contacts_row_insert(w, iter, string, NULL, section, 0);
+		fstring_free(string);
+		if (res)
+			return -1;
+	}
+
+	string = contacts_format(u, status_t);
+	res = contacts_row_insert(w, iter, string, u, section, 0);
+	string->priv_data = NULL; /* XXX: stop freeing this in fstring_free()! */
+	fstring_free(string);
+	if (res)
+		return -1;
+
+	if (new_section && (string = contacts_status_format(status_t, 1))) {
+		res = contacts_row_insert(w, iter, string, NULL, section, 1);
+		fstring_free(string);
+	}
+	return res;
+}
+
+/*
+ * ncurses_contacts_update_user()
+ *
+ * updates only rows of contact uid from session suid, if it can, otherwise
+ * it does ncurses_contacts_update(w, 1).
+ */
+int ncurses_contacts_update_user(window_t *w, const char *suid, const char *uid) {
+	ncurses_window_t *n;
+	GSequenceIter *iter;
+	contacts_row_t *row;
+	userlist_t *u;
+	int old_start, section;
+
+	if (!w) w = window_exist(WINDOW_CONTACTS_ID);
+	if (!w)
+		return -1;
+
+	if (!contacts_model_check(w))
+		return ncurses_contacts_update(w, 1);
+
+	n = w->priv_data;
+
+	if (contacts_model_list == &session_current->userlist) {
+		if (xstrcmp(suid, session_current->uid))
+			return 0;	/* not shown */
+		u = userlist_find(session_current, uid);
+	} else
+		u = userlist_find_u(contacts_model_list, uid);
+
+	if (!u)
+		return 0;
+
+	section	= contacts_section(u, contacts_model_group);
+	iter	= g_hash_table_lookup(contacts_rows_index, u);
+	row	= iter ? g_sequence_get(iter) : NULL;
+
+	/* row of freed entry (refresh is deferred), which address was reused, or renamed one */
+	if (row && (xstrcmp(row->uid, u->uid) || xstrcmp(row->nickname, u->nickname)))
+		return ncurses_contacts_update(w, 1);
+
+	if (!row && section == -1)
+		return 0;
+
+	old_start = n->start;
+
+	if (row && row->section == section) {
+		fstring_t *string = contacts_format(u, ekg_status_string(u->status, 0));
+
+		ncurses_backlog_set(w, contacts_row_line(iter), string);
+		string->priv_data = NULL; /* XXX: stop freeing this in fstring_free()! */
+		fstring_free(string);
+	} else {
+		if (row)
+			contacts_user_remove(w, iter);
+
+		/* backlog full, let's do it the old way */
+		if (section != -1 && contacts_user_insert(w, u, section))
+			return ncurses_contacts_update(w, 1);
+	}
+
+	contacts_restore_start(w, old_start);
+
+	return 0;
 }
 
 /*
@@ -493,7 +850,7 @@ void ncurses_contacts_mouse_handler(int x, int y, int mouse_state)
 		if (y < 0 || y >= n->lines_count)
 			return;
 
-		y = n->lines[n->start + y].backlog;
+		y = ncurses_screen_line_backlog(n, ncurses_screen_line(n, n->start + y));
 	} else {
 		/* here old code */
 
@@ -509,7 +866,7 @@ void ncurses_contacts_mouse_handler(int x, int y, int mouse_state)
 	}
 
 		/* (we keep priv_data utf8-encoded) */
-	command_exec_format(NULL, NULL, 0, ("/query \"%s\""), n->backlog[y]->priv_data);
+	command_exec_format(NULL, NULL, 0, ("/query \"%s\""), ncurses_backlog_line(n, y)->priv_data);
 	return;
 }
 
@@ -18,6 +18,7 @@ extern int config_contacts_metacontacts_swallow;
 extern int contacts_group_index;
 
 int ncurses_contacts_update(window_t *w, int save_pos);
+int ncurses_contacts_update_user(window_t *w, const char *suid, const char *uid);
 void ncurses_contacts_changed(const char *name);
 void ncurses_contacts_set(window_t *w);
 
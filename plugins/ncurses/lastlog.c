@@ -30,16 +30,142 @@ int config_lastlog_display_all = 0;
 
 window_lastlog_t *lastlog_current = NULL;
 
+/*
+ * lastlog matches of one window, kept between updates so only lines
+ * added since last update are tested.
+ */
+typedef struct {
+	window_t *w;			/* searched window (key only) */
+	window_lastlog_t *lastlog;	/* lastlog used (key only) */
+	unsigned int lastlog_gen;	/* lastlog_gen when matches were computed */
+	int casense;			/* effective case sensitivity used */
+	unsigned int backlog_gen;	/* n->backlog_gen when matches were computed */
+	unsigned int seq;		/* backlog_seq of first line not tested yet */
+	GArray *matches;		/* backlog_seq of matching lines, ascending from index first */
+	guint first;
+	int used;
+} lastlog_state_t;
+
+static GSList *lastlog_states = NULL;
+static unsigned int lastlog_gen = 0;	/* bumped by /lastlog */
+static int lastlog_dirty = 1;		/* matches changed since __lastlog was filled */
+
+static void lastlog_state_free(lastlog_state_t *st) {
+	g_array_free(st->matches, TRUE);
+	xfree(st);
+}
+
+static gboolean ncurses_lastlog_match(window_lastlog_t *lastlog, int casense, const char *str) {
+	if (lastlog->isregex)		/* regexp */
+		return g_regex_match(lastlog->reg, str, 0, NULL);
+	if (casense)			/* substring */
+		return !!xstrstr(str, lastlog->expression);
+	return !!xstrcasestr(str, lastlog->expression);
+}
+
+/*
+ * ncurses_lastlog_state()
+ *
+ * returns matches of @a lastlog in window @a w, testing only lines
+ * added since previous call. dropped lines are forgotten, whole backlog
+ * is searched again only when lastlog or backlog was changed otherwise.
+ */
+static lastlog_state_t *ncurses_lastlog_state(window_lastlog_t *lastlog, window_t *w, ncurses_window_t *n) {
+	const int casense = (lastlog->casense == -1) ? config_lastlog_case : lastlog->casense;
+	const unsigned int oldest = n->backlog_seq - n->backlog_size;
+	lastlog_state_t *st = NULL;
+	GSList *l;
+	guint i;
+
+	for (l = lastlog_states; l; l = l->next) {
+		lastlog_state_t *tmp = l->data;
+
+		if (tmp->w == w && tmp->lastlog == lastlog) {
+			st = tmp;
+			break;
+		}
+	}
+
+	if (!st) {
+		st = xmalloc(sizeof(lastlog_state_t));
+		st->w		= w;
+		st->lastlog	= lastlog;
+		st->matches	= g_array_new(FALSE, FALSE, sizeof(unsigned int));
+		st->lastlog_gen	= lastlog_gen - 1;	/* force search */
+		lastlog_states = g_slist_prepend(lastlog_states, st);
+	}
+	st->used = 1;
+
+	if (st->lastlog_gen != lastlog_gen || st->casense != casense || st->backlog_gen != n->backlog_gen || st->seq > n->backlog_seq) {
+		g_array_set_size(st->matches, 0);
+		st->first	= 0;
+		st->seq		= oldest;
+		st->lastlog_gen	= lastlog_gen;
+		st->casense	= casense;
+		st->backlog_gen	= n->backlog_gen;
+		lastlog_dirty	= 1;
+	}
+
+	/* forget lines dropped from backlog */
+	for (i = st->first; i < st->matches->len && g_array_index(st->matches, unsigned int, i) < oldest; i++)
+		;
+	if (i != st->first) {
+		st->first = i;
+		lastlog_dirty = 1;
+	}
+	if (st->first > 64 && st->first * 2 > st->matches->len) {
+		g_array_remove_range(st->matches, 0, st->first);
+		st->first = 0;
+	}
+
+	if (st->seq < oldest)
+		st->seq = oldest;
+
+	for (; st->seq != n->backlog_seq; st->seq++) {
+		fstring_t *line = ncurses_backlog_line(n, n->backlog_seq - 1 - st->seq);
+
+		if (ncurses_lastlog_match(lastlog, casense, line->str)) {
+			g_array_append_val(st->matches, st->seq);
+			lastlog_dirty = 1;
+		}
+	}
+
+	return st;
+}
+
+/*
+ * ncurses_lastlog_forget()
+ *
+ * drops cached lastlog matches of window being destroyed.
+ */
+void ncurses_lastlog_forget(window_t *w) {
+	GSList *l;
+
+	for (l = lastlog_states; l; ) {
+		lastlog_state_t *st = l->data;
+
+		l = l->next;
+		if (st->w == w) {
+			lastlog_states = g_slist_remove(lastlog_states, st);
+			lastlog_state_free(st);
+			lastlog_dirty = 1;
+		}
+	}
+}
+
+/*
+ * if lastlog_w is NULL, only matches are updated and counted, otherwise
+ * they're added to lastlog_w.
+ */
 static int ncurses_ui_window_lastlog(window_t *lastlog_w, window_t *w) {
 	const char *header;
 
 	ncurses_window_t *n;
 	window_lastlog_t *lastlog;
-
-	int local_config_lastlog_case;
+	lastlog_state_t *st;
 
 	int items = 0;
-	int i;
+	guint i;
 
 	static int lock = 0;
 
@@ -63,14 +189,18 @@ static int ncurses_ui_window_lastlog(window_t *lastlog_w, window_t *w) {
 	if (!lastlog)
 		return items;
 
-	if (lastlog == lastlog_current)	header = format_find("lastlog_title_cur");
-	else				header = format_find("lastlog_title");
-
-
 	if (!w || !(n = w->priv_data))
 		return items;
 
-	if (config_lastlog_noitems) { /* always add header */
+	st = ncurses_lastlog_state(lastlog, w, n);
+
+	if (!lastlog_w)
+		return items + (st->matches->len - st->first);
+
+	if (lastlog == lastlog_current)	header = format_find("lastlog_title_cur");
+	else				header = format_find("lastlog_title");
+
+	if (config_lastlog_noitems || st->first != st->matches->len) { /* add header always or only when found */
 		gchar *titleexpr = ekg_recode_from_locale(lastlog->expression);
 		fstring_t *fstr = fstring_new_format(header, window_target(w), titleexpr);
 		ncurses_backlog_add(lastlog_w, fstr);
@@ -78,39 +208,23 @@ static int ncurses_ui_window_lastlog(window_t *lastlog_w, window_t *w) {
 		g_free(titleexpr);
 	}
 
-	local_config_lastlog_case = (lastlog->casense == -1) ? config_lastlog_case : lastlog->casense;
+	for (i = st->first; i < st->matches->len; i++) {
+		unsigned int seq = g_array_index(st->matches, unsigned int, i);
 
-	for (i = n->backlog_size-1; i >= 0; i--) {
-		gboolean found = FALSE;
-
-		if (lastlog->isregex) {		/* regexp */
-			found = g_regex_match(lastlog->reg, n->backlog[i]->str, 0, NULL);
-		} else {				/* substring */
-			if (local_config_lastlog_case)
-				found = !!xstrstr(n->backlog[i]->str, lastlog->expression);
-			else	
-				found = !!xstrcasestr(n->backlog[i]->str, lastlog->expression);
-		}
-
-		if (!config_lastlog_noitems && found && !items) { /* add header only when found */
-			gchar *titleexpr = ekg_recode_from_locale(lastlog->expression);
-			fstring_t *fstr = fstring_new_format(header, window_target(w), titleexpr);
-			ncurses_backlog_add(lastlog_w, fstr);
-			fstring_free(fstr);
-			g_free(titleexpr);
-		}
-
-		if (found) {
-			ncurses_backlog_add_real(lastlog_w, fstring_dup(n->backlog[i]));
-			items++;
-		}
+		ncurses_backlog_add_real(lastlog_w, fstring_dup(ncurses_backlog_line(n, n->backlog_seq - 1 - seq)));
+		items++;
 	}
 	return items;
 }
 
 int ncurses_lastlog_update(window_t *w) {
+	static window_t *last_current = NULL;
+	static int last_display_all = -1, last_noitems = -1;
+	static unsigned int last_seq, last_gen;
+
 	ncurses_window_t *n;
 	window_t *ww;
+	GSList *l;
 	int retval = 0;
 
 	int old_start;
@@ -121,14 +235,14 @@ int ncurses_lastlog_update(window_t *w) {
 	if (!w) return -1;
 
 	n = w->priv_data;
-	old_start = n->start;
 
-	ncurses_clear(w, 1);
+	for (l = lastlog_states; l; l = l->next)
+		((lastlog_state_t *) l->data)->used = 0;
 
 /* XXX, it's bad orded now, need fix */
 
 /* 1st, lookat current window.. */
-	retval += ncurses_ui_window_lastlog(w, window_current);
+	retval += ncurses_ui_window_lastlog(NULL, window_current);
 
 /* 2nd, display lastlog from floating windows? (XXX) */
 
@@ -138,7 +252,39 @@ int ncurses_lastlog_update(window_t *w) {
 			if (ww == window_current) continue;
 			if (ww == w) continue; /* ;p */
 
-			retval += ncurses_ui_window_lastlog(w, ww);
+			retval += ncurses_ui_window_lastlog(NULL, ww);
+		}
+	}
+
+	/* states not needed anymore */
+	for (l = lastlog_states; l; ) {
+		lastlog_state_t *st = l->data;
+
+		l = l->next;
+		if (!st->used) {
+			lastlog_states = g_slist_remove(lastlog_states, st);
+			lastlog_state_free(st);
+			lastlog_dirty = 1;
+		}
+	}
+
+	/* nothing new, and __lastlog still shows what we've put there */
+	if (!lastlog_dirty && last_current == window_current && last_display_all == config_lastlog_display_all &&
+			last_noitems == config_lastlog_noitems && last_seq == n->backlog_seq && last_gen == n->backlog_gen)
+		return retval;
+
+	old_start = n->start;
+
+	ncurses_clear(w, 1);
+
+	ncurses_ui_window_lastlog(w, window_current);
+
+	if (config_lastlog_display_all) {
+		for (ww = windows; ww; ww = ww->next) {
+			if (ww == window_current) continue;
+			if (ww == w) continue;
+
+			ncurses_ui_window_lastlog(w, ww);
 		}
 	}
 	{
@@ -157,6 +303,13 @@ int ncurses_lastlog_update(window_t *w) {
 	if (n->start < 0)
 		n->start = 0;
 
+	lastlog_dirty		= 0;
+	last_current		= window_current;
+	last_display_all	= config_lastlog_display_all;
+	last_noitems		= config_lastlog_noitems;
+	last_seq		= n->backlog_seq;
+	last_gen		= n->backlog_gen;
+
 	n->redraw = 1;
 	return retval;
 }
@@ -287,6 +440,7 @@ COMMAND(ncurses_cmd_lastlog) {
 	lastlog->lock		= islock;
 	lastlog->isregex	= isregex;
 	lastlog->expression	= ekg_recode_to_locale(str);
+	lastlog_gen++;
 
 	if (w)	window_current->lastlog	= lastlog;
 	else	lastlog_current		= lastlog;
@@ -342,6 +342,24 @@ static QUERY(ncurses_all_contacts_changed)
 	return 0;
 }
 
+/*
+ * ncurses_userlist_changed()
+ *
+ * zmiana jednego kontaktu (np. statusu), przerysowujemy tylko jego.
+ */
+static QUERY(ncurses_userlist_changed)
+{
+	const char *session	= *(va_arg(ap, const char **));
+	const char *uid		= *(va_arg(ap, const char **));
+	window_t *w;
+
+	if ((w = window_exist(WINDOW_CONTACTS_ID))) {
+		ncurses_contacts_update_user(w, session, uid);
+		ncurses_commit();
+	}
+	return 0;
+}
+
 
 static QUERY(ncurses_variable_changed)
 {
@@ -598,7 +616,7 @@ static COMMAND(ncurses_cmd_dump) {
 	n = w->priv_data;
 
 	for (i = n->backlog_size; i; i--) {
-		fstring_t *backlog = n->backlog[i-1];
+		fstring_t *backlog = ncurses_backlog_line(n, i-1);
 		/* XXX, kolorki gdy user chce */
 
 		fprintf(f, "%ld %s\n", backlog->ts, backlog->str);
@@ -699,7 +717,7 @@ EXPORT int ncurses_plugin_init(int prio)
 	query_connect(&ncurses_plugin, "metacontact-item-added", ncurses_all_contacts_changed, NULL);
 	query_connect(&ncurses_plugin, "metacontact-item-removed", ncurses_all_contacts_changed, NULL);
 
-	query_connect(&ncurses_plugin, "userlist-changed", ncurses_all_contacts_changed, NULL);
+	query_connect(&ncurses_plugin, "userlist-changed", ncurses_userlist_changed, NULL);
 	query_connect(&ncurses_plugin, "userlist-added", ncurses_all_contacts_changed, NULL);
 	query_connect(&ncurses_plugin, "userlist-removed", ncurses_all_contacts_changed, NULL);
 	query_connect(&ncurses_plugin, "userlist-renamed", ncurses_all_contacts_changed, NULL);
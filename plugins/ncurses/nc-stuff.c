@@ -572,16 +572,17 @@ void ncurses_redraw(window_t *w)
 
 	fix_trl=0;
 	for (y = 0; y < height && n->start + y < n->lines_count; y++) {
-		struct screen_line *l = &n->lines[n->start + y];
+		struct screen_line *l = ncurses_screen_line(n, n->start + y);
+		const time_t ts = ncurses_backlog_line(n, ncurses_screen_line_backlog(n, l))->ts;
 
 		int cur_y = (top + y + fix_trl);
 
 		int fixup = 0;
 
-		if (( y == 0 ) && n->last_red_line && (n->backlog[l->backlog]->ts < n->last_red_line))
+		if (( y == 0 ) && n->last_red_line && (ts < n->last_red_line))
 			dtrl = 1;	/* First line timestamp is less then mark. Mayby marker is on this page? */
 
-		if (dtrl && (n->backlog[l->backlog]->ts >= n->last_red_line)) {
+		if (dtrl && (ts >= n->last_red_line)) {
 			draw_thin_red_line(w, cur_y);
 			if ((n->lines_count-n->start == height - (top - n->margin_top)) ) {
 				/* we have stolen line for marker, so we scroll up */
@@ -688,26 +689,32 @@ void ncurses_clear(window_t *w, int full)
 		int i;
 
 		for (i = 0; i < n->backlog_size; i++)
-			fstring_free(n->backlog[i]);
+			fstring_free(ncurses_backlog_line(n, i));
 
 		xfree(n->backlog);
 
 		n->backlog = NULL;
 		n->backlog_size = 0;
+		n->backlog_alloc = 0;
+		n->backlog_head = 0;
+		n->backlog_seq = 0;
+		n->backlog_gen++;
 	}
 
 	if (n->lines) {
 		int i;
 
 		for (i = 0; i < n->lines_count; i++) {
-			xfree(n->lines[i].ts);
-			xfree(n->lines[i].ts_attr);
+			xfree(ncurses_screen_line(n, i)->ts);
+			xfree(ncurses_screen_line(n, i)->ts_attr);
 		}
 
 		xfree(n->lines);
 
 		n->lines = NULL;
 		n->lines_count = 0;
+		n->lines_alloc = 0;
+		n->lines_first = 0;
 	}
 
 	n->start = 0;
@@ -775,6 +782,7 @@ int ncurses_window_kill(window_t *w)
 	if (!n)
 		return -1;
 
+	ncurses_lastlog_forget(w);
 	ncurses_clear(w, 1);
 
 	g_free(n->prompt);
@@ -32,7 +32,7 @@ struct screen_line { /* everything locale-encoded */
 	char *ts;		/* timestamp */
 	fstr_attr_t *ts_attr;	/* attributes of the timestamp */
 
-	int backlog;		/* backlog line it comes from */
+	unsigned int backlog_seq;	/* sequence number of backlog line it comes from */
 	int margin_left;	/* where the margin should be setted */	
 };
 
@@ -54,15 +54,21 @@ typedef struct {
 	int margin_left, margin_right, margin_top, margin_bottom;
 				/* margins */
 
-	fstring_t **backlog;	/* buffer with lines */
+	fstring_t **backlog;	/* ring buffer with lines, see ncurses_backlog_line() */
 	int backlog_size;	/* backlog size */
+	int backlog_alloc;	/* number of slots in backlog */
+	int backlog_head;	/* slot of the newest line */
+	unsigned int backlog_seq;	/* number of lines added since last clear */
+	unsigned int backlog_gen;	/* bumped when lines are changed other way than by adding new ones */
 
 	int redraw;		/* does it have to be redrawn before display */
 
 	int start;		/* from which line displaying starts */
 	int lines_count;	/* number of screen lines in backlog */
+	int lines_alloc;	/* number of slots in lines */
+	int lines_first;	/* slot of the top screen line */
 	struct screen_line *lines;
-				/* screen lines */
+				/* screen lines ring buffer, see ncurses_screen_line() */
 
 	int overflow;		/* number of superfluous lines in a window */
 
@@ -74,6 +80,16 @@ typedef struct {
 	time_t last_red_line;	/* timestamp for red line marker */
 } ncurses_window_t;
 
+/* i-th line of backlog, 0 is the newest one */
+#define ncurses_backlog_line(n, i) \
+	((n)->backlog[((n)->backlog_head + (n)->backlog_alloc - (i)) % (n)->backlog_alloc])
+/* i-th screen line, 0 is the top one */
+#define ncurses_screen_line(n, i) \
+	(&(n)->lines[((n)->lines_first + (i)) % (n)->lines_alloc])
+/* index (for ncurses_backlog_line()) of backlog line which screen line l comes from */
+#define ncurses_screen_line_backlog(n, l) \
+	((int) ((n)->backlog_seq - 1 - (l)->backlog_seq))
+
 extern WINDOW *ncurses_contacts;
 extern WINDOW *ncurses_input;
 
@@ -117,6 +133,7 @@ extern int config_text_bottomalign;
 
 int ncurses_lastlog_update(window_t *w);
 void ncurses_lastlog_new(window_t *w);
+void ncurses_lastlog_forget(window_t *w);
 extern int config_lastlog_size;
 extern int config_lastlog_lock;
 extern int config_mark_on_window_change;
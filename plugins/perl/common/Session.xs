@@ -42,7 +42,7 @@ MODULE = Ekg2::Session	PACKAGE = Ekg2::Session  PREFIX = session_
 
 Ekg2::Userlist session_userlist(Ekg2::Session session)
 CODE:
-        RETVAL = (session->userlist);
+        RETVAL = &(session->userlist);
 OUTPUT:
         RETVAL
 	
@@ -34,7 +34,7 @@ typedef ekg_timer_t	Ekg2__Timer;
 
 typedef userlist_t	*Ekg2__User;
 
-typedef userlist_t	*Ekg2__Userlist;
+typedef userlist_t	**Ekg2__Userlist;	/* address of list head, so changes go to the real list */
 
 typedef session_param_t *Ekg2__Session__Param;
 typedef script_t	*Ekg2__Script;
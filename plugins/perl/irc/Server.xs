@@ -66,10 +66,12 @@ PPCODE:
 
 void server_people(Ekg2::Session s)
 PREINIT:
-        list_t l;
+        GHashTableIter iter;
+        gpointer value;
 PPCODE:
-        if (!xstrncasecmp( session_uid_get( (session_t *) s), IRC4, 4)) {
-                for (l = irc_private(s)->people; l; l = l->next) {
-                        XPUSHs(sv_2mortal(bless_person( (people_t *) l->data)));
+        if (!xstrncasecmp( session_uid_get( (session_t *) s), IRC4, 4) && irc_private(s)->people) {
+                g_hash_table_iter_init(&iter, irc_private(s)->people);
+                while (g_hash_table_iter_next(&iter, NULL, &value)) {
+                        XPUSHs(sv_2mortal(bless_person( (people_t *) value)));
                 }
         }
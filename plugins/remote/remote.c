@@ -50,23 +50,36 @@ typedef struct {
 	int mark;			/* do zaznaczania, wntrznoci */
 
 	int login_ok;
+
+	watch_t *send_watch;		/* WATCH_WRITE_LINE with output queue of client */
+	int seq_ok;			/* client sent REQBACKLOGS SEQ, and gets sequence numbers of lines */
+	int overflow;			/* queue was full with remote:queue_policy 1, client is being disconnected */
+	time_t started;			/* when client connected */
+	guint64 sent_msgs;		/* messages queued for client */
+	guint64 sent_bytes;		/* ...and their size */
+	guint64 dropped_msgs;		/* broadcasts dropped, because queue was full */
+	gsize queued_max;		/* max bytes waiting in queue */
 } rc_input_t;
 
 typedef struct {
 	char *str;
 	time_t ts;
+	guint64 seq;			/* sequence number, see rc_backlog_seq */
 } remote_backlog_t;
 
 typedef struct {
-	remote_backlog_t **backlog;	/* bufor z liniami */		/* XXX, przerobic na liste */
+	remote_backlog_t *backlog;	/* ring buffer with lines, see remote_backlog_line() */
 	int backlog_size;		/* rozmiar backloga */
+	int backlog_max;		/* number of allocated lines */
+	int backlog_start;		/* index of oldest line */
 
 	char *last_irctopic;
 	char *last_irctopicby;
 	char *last_ircmode;
 } remote_window_t;
 
-PLUGIN_DEFINE(remote, PLUGIN_UI, NULL);
+static int remote_theme_init();
+PLUGIN_DEFINE(remote, PLUGIN_UI, remote_theme_init);
 
 static void rc_input_close(rc_input_t *r);
 
@@ -75,6 +88,11 @@ static char *rc_paths = NULL;
 static char *rc_password = NULL;
 static int rc_first = 1;
 static int rc_detach = 0;
+static int rc_queue_limit = 1024;
+static int rc_backlog_size = 1000;
+static char *rc_instance = NULL;	/* identifies this run of ekg2, for sequences of backlog lines */
+static guint64 rc_backlog_seq = 0;	/* sequence number of next line in any window, it's never reset */
+static int rc_queue_policy = 1;
 
 static int rc_last_mail_count = -1;
 
@@ -266,43 +284,173 @@ static string_t remote_what_to_write(char *what, va_list ap) {
 	return str;
 }
 
-static int remote_broadcast(char *what, ...) {
-	string_t str;
-	va_list ap;
+static void rc_input_watermarks(rc_input_t *r) {
+	gsize limit = (rc_queue_limit > 0) ? (gsize) rc_queue_limit * 1024 : 0;
+
+	watch_set_watermarks(r->send_watch, limit / 2, limit);
+}
+
+/*
+ * rc_input_send()
+ *
+ * queues message on client output queue, never blocks.
+ * if @a limit is set, and there's more than remote:queue_limit KiB waiting for slow client,
+ * message is dropped (remote:queue_policy 0), or client is disconnected (remote:queue_policy 1).
+ */
+static int rc_input_send(rc_input_t *r, watch_chunk_t *c, int limit) {
+	gsize queued;
+
+	if (r->fd == -1 || r->overflow)
+		return -1;
+
+	if (!r->send_watch) {
+		r->send_watch = watch_add(&remote_plugin, r->fd, WATCH_WRITE_LINE, NULL, NULL);
+		rc_input_watermarks(r);
+	}
+
+	if (limit && !watch_writable(r->send_watch)) {
+		if (rc_queue_policy == 1) {
+			debug_error("[rc] client %s (fd: %d) too slow, %" G_GSIZE_FORMAT " bytes queued, disconnecting\n",
+					r->path, r->fd, watch_queued(r->send_watch));
+			r->overflow = 1;
+			/* rc_input_handler_line() gets EOF and closes it */
+			shutdown(r->fd, SHUT_RDWR);
+		} else
+			r->dropped_msgs++;
+		return -1;
+	}
+
+	watch_write_chunk(r->send_watch, c);
+
+	r->sent_msgs++;
+	r->sent_bytes += watch_chunk_len(c);
+	if ((queued = watch_queued(r->send_watch)) > r->queued_max)
+		r->queued_max = queued;
+	return 0;
+}
+
+static rc_input_t *rc_input_find_fd(int fd) {
 	list_t l;
 
+	for (l = rc_inputs; l; l = l->next) {
+		rc_input_t *r = l->data;
+
+		if (r->fd == fd && (r->type == RC_INPUT_TCP_CLIENT || r->type == RC_INPUT_UNIX_CLIENT))
+			return r;
+	}
+	return NULL;
+}
+
+static watch_chunk_t *remote_what_to_chunk(char *what, va_list ap) {
+	string_t str = remote_what_to_write(what, ap);
+	watch_chunk_t *c = watch_chunk_new(str->str, str->len);
+
+	string_free(str, 1);
+	return c;
+}
+
+static watch_chunk_t *remote_chunk(char *what, ...) {
+	watch_chunk_t *c;
+	va_list ap;
+
 	va_start(ap, what);
-	str = remote_what_to_write(what, ap);
+	c = remote_what_to_chunk(what, ap);
 	va_end(ap);
+	return c;
+}
+
+/* message is formatted once, and the same chunk is queued on every client.
+ * clients with seq_ok get @a cseq instead, if it's given. */
+static void remote_broadcast_chunk(watch_chunk_t *c, watch_chunk_t *cseq) {
+	list_t l;
 
 	for (l = rc_inputs; l; l = l->next) {
 		rc_input_t *r = l->data;
 
 		if (r->type == RC_INPUT_TCP_CLIENT || r->type == RC_INPUT_UNIX_CLIENT) {
-			/* XXX, discarding ret value */
 			if (r->login_ok)
-				ekg_write(r->fd, str->str, str->len);
+				rc_input_send(r, (cseq && r->seq_ok) ? cseq : c, 1);
 		}
 	}
+}
 
-	string_free(str, 1);
+static int remote_broadcast(char *what, ...) {
+	watch_chunk_t *c;
+	va_list ap;
+
+	va_start(ap, what);
+	c = remote_what_to_chunk(what, ap);
+	va_end(ap);
+
+	remote_broadcast_chunk(c, NULL);
+
+	watch_chunk_unref(c);
 	return 0;
 }
 
+/* replies to client requests aren't limited, they're bounded by backlog & userlists size anyway */
 static int remote_writefd(int fd, char *what, ...) {
-	string_t str;
+	watch_chunk_t *c;
+	rc_input_t *r;
 	va_list ap;
 
+	if (!(r = rc_input_find_fd(fd)))
+		return -1;
+
 	va_start(ap, what);
-	str = remote_what_to_write(what, ap);
+	c = remote_what_to_chunk(what, ap);
 	va_end(ap);
 
-	ekg_write(fd, str->str, str->len);
+	rc_input_send(r, c, 0);
 
-	string_free(str, 1);
+	watch_chunk_unref(c);
 	return 0;
 }
 
+/*
+ * Window backlog is a ring of at most remote:backlog_size lines, n->backlog_start is index of
+ * the oldest one. Lines are numbered by one counter shared by all windows (rc_backlog_seq), so
+ * window which was closed and opened again with the same id never repeats numbers client knows.
+ * Client which knows sequence number of its last line can ask only for newer lines after reconnecting.
+ */
+
+static remote_backlog_t *remote_backlog_line(remote_window_t *n, int i) {
+	return &n->backlog[(n->backlog_start + i) % n->backlog_max];
+}
+
+/* index of the oldest line with sequence number >= @a seq, n->backlog_size if there's none */
+static int remote_backlog_find(remote_window_t *n, guint64 seq) {
+	int lo = 0, hi = n->backlog_size;
+
+	while (lo < hi) {
+		int mid = (lo + hi) / 2;
+
+		if (remote_backlog_line(n, mid)->seq < seq)
+			lo = mid + 1;
+		else
+			hi = mid;
+	}
+	return lo;
+}
+
+static void remote_backlog_send(int fd, window_t *w, int from, int with_seq) {
+	remote_window_t *n = w->priv_data;
+	int i;
+
+	for (i = from; i < n->backlog_size; i++) {
+		remote_backlog_t *line = remote_backlog_line(n, i);
+		char seqbuf[24];
+
+		if (!with_seq) {
+			remote_writefd(fd, "BACKLOG", ekg_itoa(w->id), ekg_itoa(line->ts), line->str, NULL);
+			continue;
+		}
+
+		g_snprintf(seqbuf, sizeof(seqbuf), "%" G_GINT64_MODIFIER "u", line->seq);
+		remote_writefd(fd, "BACKLOG", ekg_itoa(w->id), ekg_itoa(line->ts), line->str, seqbuf, NULL);
+	}
+}
+
 static int rc_theme_enumerate_fd = -1;
 
 int rc_theme_enumerate(const char *name, const char *value) {
@@ -378,7 +526,8 @@ static WATCHER_LINE(rc_input_handler_line) {
 				return -1;
 			}
 
-			remote_writefd(fd, "+LOGIN", NULL);
+			/* instance goes first, so client can drop sequences of other ekg2 before it gets any line */
+			remote_writefd(fd, "+LOGIN", rc_instance, NULL);
 			if (rc_last_mail_count > 0)
 				remote_writefd(fd, "MAILCOUNT", ekg_itoa(rc_last_mail_count), NULL);		/* nie najszczesliwsze miejsce, ale nie mam pomyslu gdzie indziej */
 
@@ -480,7 +629,47 @@ static WATCHER_LINE(rc_input_handler_line) {
 			window_t *w;
 			int req_ok = 0;
 
-			/* XXX, uniknac duplikowania kodu... */
+			if ((arrcnt == 4 || arrcnt == 5) && !xstrcmp(arr[1], "SEQ")) {
+				/* REQBACKLOGS SEQ <last> <instance> ["<window>:<seq> <window>:<seq> ..."]
+				 *	client has got lines up to <seq> in listed windows, we send only newer ones,
+				 *	and <last> lines of other windows. Sequences from other ekg2 instance are ignored. */
+				int only = atoi(arr[2]);
+				char **seqs = NULL;
+
+				if (arrcnt == 5 && !xstrcmp(arr[3], rc_instance))
+					seqs = g_strsplit(arr[4], " ", 0);
+
+				for (w = windows; w; w = w->next) {
+					remote_window_t *n = w->priv_data;
+					int from = -1;
+					int i;
+
+					if (!n)
+						continue;
+
+					for (i = 0; seqs && seqs[i]; i++) {
+						char *sep = xstrchr(seqs[i], ':');
+
+						if (sep && atoi(seqs[i]) == w->id) {
+							guint64 seq = g_ascii_strtoull(sep + 1, NULL, 10);
+
+							if (seq < rc_backlog_seq)
+								from = remote_backlog_find(n, seq + 1);
+							break;
+						}
+					}
+
+					if (from == -1)
+						from = (n->backlog_size > only) ? n->backlog_size - only : 0;
+
+					remote_backlog_send(fd, w, from, 1);
+				}
+				g_strfreev(seqs);
+
+				r->seq_ok = 1;
+				remote_writefd(fd, "+BACKLOG", rc_instance, NULL);
+				goto backlogs_done;
+			}
 
 			if (arrcnt == 3) {
 				if (!xstrcmp(arr[1], "LAST")) {
@@ -490,22 +679,9 @@ static WATCHER_LINE(rc_input_handler_line) {
 
 					for (w = windows; w; w = w->next) {
 						remote_window_t *n = w->priv_data;
-						int from;
-						int i;
-
-						if (!n)
-							continue;
-
-						if (n->backlog_size > only)
-							from = only;
-						else
-							from = n->backlog_size;
 
-						/* XXX, zakladamy ze backlog jest posortowany w/g czasu */
-
-						for (i = from; i; i--) {
-							remote_writefd(fd, "BACKLOG", ekg_itoa(w->id), ekg_itoa(n->backlog[i-1]->ts), n->backlog[i-1]->str, NULL);
-						}
+						if (n)
+							remote_backlog_send(fd, w, (n->backlog_size > only) ? n->backlog_size - only : 0, 0);
 					}
 				} else if (!xstrcmp(arr[1], "FROMTIME")) {
 					time_t ts = atoi(arr[2]);
@@ -519,28 +695,25 @@ static WATCHER_LINE(rc_input_handler_line) {
 						if (!n)
 							continue;
 
-						for (i = n->backlog_size; i; i--) {
-							if (n->backlog[i-1]->ts >= ts)
-								remote_writefd(fd, "BACKLOG", ekg_itoa(w->id), ekg_itoa(n->backlog[i-1]->ts), n->backlog[i-1]->str, NULL);
+						/* XXX, zakladamy ze backlog jest posortowany w/g czasu */
+						for (i = 0; i < n->backlog_size; i++) {
+							if (remote_backlog_line(n, i)->ts >= ts)
+								break;
 						}
+						remote_backlog_send(fd, w, i, 0);
 					}
 				}
 			}
 			if (req_ok == 0) {	/* jesli requet nie byl przetwarzany, to wysylamy caly backlog */
 				for (w = windows; w; w = w->next) {
-					remote_window_t *n = w->priv_data;
-					int i;
-
-					if (!n)
-						continue;
-
-					for (i = n->backlog_size; i; i--) {
-						remote_writefd(fd, "BACKLOG", ekg_itoa(w->id), ekg_itoa(n->backlog[i-1]->ts), n->backlog[i-1]->str, NULL);
-					}
+					if (w->priv_data)
+						remote_backlog_send(fd, w, 0, 0);
 				}
 			}
 
 			remote_writefd(fd, "+BACKLOG", NULL);
+backlogs_done:
+			;
 
 		} else if (!xstrcmp(cmd, "REQSESSIONS")) {
 			session_t *s;
@@ -680,7 +853,11 @@ static WATCHER(rc_input_handler_accept) {
 	rn->fd		= cfd;
 	rn->path	= saprintf("%sc", r->path);	/* maybe ip:port of client or smth? */
 	rn->type	= (r->type == RC_INPUT_TCP) ? RC_INPUT_TCP_CLIENT : RC_INPUT_UNIX_CLIENT;
+	rn->started	= time(NULL);
 	list_add(&rc_inputs, rn);
+
+	/* one slow client can't block us, data waits in rn->send_watch */
+	fcntl(cfd, F_SETFL, O_NONBLOCK);
 	watch_add_line(&remote_plugin, cfd, WATCH_READ_LINE, rc_input_handler_line, rn);
 	return 0;
 }
@@ -731,6 +908,14 @@ static void rc_input_close(rc_input_t *r) {
 	if (r->type == RC_INPUT_PIPE)
 		unlink(r->path);
 
+	if (r->send_watch) {
+		if (watch_queued(r->send_watch))
+			debug_function("[rc] rc_input_close() dropping %" G_GSIZE_FORMAT " bytes of output\n", watch_queued(r->send_watch));
+		r->send_watch->type = WATCH_NONE;
+		watch_free(r->send_watch);
+		r->send_watch = NULL;
+	}
+
 	if (r->fd != -1) {
 		watch_t *w = rc_watch_find(r->fd);
 
@@ -1030,28 +1215,50 @@ static int remote_window_new(window_t *w) {
 	return 0;
 }
 
-static void remote_backlog_add(window_t *w, remote_backlog_t *str) {
-	remote_window_t *n = w->priv_data;
-	
-	if (!w)
-		return;
-#define config_backlog_size -1
+/* move lines to new ring of @a max lines, the oldest ones are dropped if needed */
+static void remote_backlog_resize(remote_window_t *n, int max) {
+	remote_backlog_t *tmp = xmalloc(max * sizeof(remote_backlog_t));
+	int drop = (n->backlog_size > max) ? n->backlog_size - max : 0;
+	int i;
 
-	if (n->backlog_size == config_backlog_size) {
-		remote_backlog_t *line = n->backlog[n->backlog_size - 1];
+	for (i = 0; i < drop; i++)
+		xfree(remote_backlog_line(n, i)->str);
 
-		xfree(line->str);
-		xfree(line);
+	for (i = drop; i < n->backlog_size; i++)
+		tmp[i - drop] = *remote_backlog_line(n, i);
 
-		n->backlog_size--;
-	} else 
-		n->backlog = xrealloc(n->backlog, (n->backlog_size + 1) * sizeof(char *));
+	xfree(n->backlog);
+	n->backlog		= tmp;
+	n->backlog_max		= max;
+	n->backlog_size		-= drop;
+	n->backlog_start	= 0;
+}
 
-	memmove(&n->backlog[1], &n->backlog[0], n->backlog_size * sizeof(char *));
+/* returns sequence number of added line */
+static guint64 remote_backlog_add(window_t *w, char *str, time_t ts) {
+	remote_window_t *n = w->priv_data;
+	remote_backlog_t *line;
+	int max = (rc_backlog_size > 0) ? rc_backlog_size : 1;
+
+	/* ring grows when needed, up to remote:backlog_size (it could be also changed meanwhile) */
+	if (n->backlog_size == n->backlog_max && n->backlog_max < max)
+		remote_backlog_resize(n, MIN(max, MAX(16, n->backlog_max * 2)));
+	else if (n->backlog_max > max)
+		remote_backlog_resize(n, max);
+
+	if (n->backlog_size == n->backlog_max) {
+		/* full, overwrite the oldest one */
+		line = remote_backlog_line(n, 0);
+		xfree(line->str);
+		n->backlog_start = (n->backlog_start + 1) % n->backlog_max;
+	} else
+		line = remote_backlog_line(n, n->backlog_size++);
 
-	n->backlog[0] = str;
+	line->str	= str;
+	line->ts	= ts;
+	line->seq	= rc_backlog_seq++;
 
-	n->backlog_size++;
+	return line->seq;
 }
 
 static void remote_window_kill(window_t *w) {
@@ -1066,7 +1273,7 @@ static void remote_window_kill(window_t *w) {
 		int i;
 
 		for (i = 0; i < n->backlog_size; i++)
-			xfree(n->backlog[i]);
+			xfree(remote_backlog_line(n, i)->str);
 
 		xfree(n->backlog);
 
@@ -1182,6 +1389,7 @@ static QUERY(remote_ui_window_print) {
 	window_t *w	= *(va_arg(ap, window_t **));
 	const fstring_t *line = *(va_arg(ap, const fstring_t **));
 	char *fstr;
+	guint64 seq;
 
 	remote_window_t *n;
 
@@ -1196,16 +1404,22 @@ static QUERY(remote_ui_window_print) {
 	}
 
 	fstr = rc_fstring_reverse(line);
+	seq = remote_backlog_add(w, fstr, line->ts);
+
 	{
-		remote_backlog_t *ln = xmalloc(sizeof(remote_backlog_t));
+		watch_chunk_t *c, *cseq;
+		char seqbuf[24];
 
-		ln->ts = line->ts;
-		ln->str = fstr;
+		g_snprintf(seqbuf, sizeof(seqbuf), "%" G_GINT64_MODIFIER "u", seq);
 
-		remote_backlog_add(w, ln);
-	}
+		c = remote_chunk("WINDOW_PRINT", ekg_itoa(w->id), ekg_itoa(line->ts), fstr, NULL);		/* XXX, using id is ok? */
+		cseq = remote_chunk("WINDOW_PRINT", ekg_itoa(w->id), ekg_itoa(line->ts), fstr, seqbuf, NULL);
+
+		remote_broadcast_chunk(c, cseq);
 
-	remote_broadcast("WINDOW_PRINT", ekg_itoa(w->id), ekg_itoa(line->ts), fstr, NULL);		/* XXX, using id is ok? */
+		watch_chunk_unref(c);
+		watch_chunk_unref(cseq);
+	}
 
 	return -1;
 }
@@ -1503,6 +1717,61 @@ static int rc_config_read(const char *plugin) {		/* alike config_read() */
 	return 0;
 }
 
+static void rc_queue_limit_changed(const char *name) {
+	list_t l;
+
+	for (l = rc_inputs; l; l = l->next) {
+		rc_input_t *r = l->data;
+
+		if (r->send_watch)
+			rc_input_watermarks(r);
+	}
+}
+
+/*
+ * rc_command_clients()
+ *
+ * /remote:clients - shows output queues of connected clients.
+ */
+static COMMAND(rc_command_clients) {
+	list_t l;
+	int count = 0;
+
+	for (l = rc_inputs; l; l = l->next) {
+		rc_input_t *r = l->data;
+		char fd[16], queued[32], queued_max[32], msgs[32], bytes[32], dropped[32], online[32];
+
+		if (r->type != RC_INPUT_TCP_CLIENT && r->type != RC_INPUT_UNIX_CLIENT)
+			continue;
+
+		snprintf(fd, sizeof(fd), "%d", r->fd);
+		snprintf(queued, sizeof(queued), "%" G_GSIZE_FORMAT, watch_queued(r->send_watch));
+		snprintf(queued_max, sizeof(queued_max), "%" G_GSIZE_FORMAT, r->queued_max);
+		snprintf(msgs, sizeof(msgs), "%" G_GINT64_MODIFIER "u", r->sent_msgs);
+		snprintf(bytes, sizeof(bytes), "%" G_GINT64_MODIFIER "u", r->sent_bytes);
+		snprintf(dropped, sizeof(dropped), "%" G_GINT64_MODIFIER "u", r->dropped_msgs);
+		snprintf(online, sizeof(online), "%ld", (long) (time(NULL) - r->started));
+
+		printq((r->login_ok ? "remote_client" : "remote_client_nologin"),
+			r->path, fd, queued, queued_max, msgs, bytes, dropped, online);
+		count++;
+	}
+
+	if (!count)
+		printq("remote_clients_none");
+	return 0;
+}
+
+static int remote_theme_init() {
+#ifndef NO_DEFAULT_THEME
+	/* path, fd, queued bytes, max queued bytes, sent messages, sent bytes, dropped messages, seconds online */
+	format_add("remote_client",		"%> %W%1%n fd: %2 queued: %3 (max: %4) sent: %5 msgs/%6 bytes dropped: %7 online: %8s", 1);
+	format_add("remote_client_nologin",	"%> %W%1%n fd: %2 %r[not logged in]%n queued: %3 (max: %4) sent: %5 msgs/%6 bytes dropped: %7 online: %8s", 1);
+	format_add("remote_clients_none",	"%! No remote clients connected", 1);
+#endif
+	return 0;
+}
+
 EXPORT int remote_plugin_init(int prio) {
 	int is_UI = 0;
 
@@ -1515,10 +1784,17 @@ EXPORT int remote_plugin_init(int prio) {
 
 	plugin_register(&remote_plugin, prio);
 
+	rc_instance = saprintf("%ld.%d", (long) time(NULL), (int) getpid());
+
 	variable_add(&remote_plugin, ("detach"), VAR_BOOL, 1, &rc_detach, rc_detach_changed, NULL, NULL);
 	variable_add(&remote_plugin, ("first_run"), VAR_INT, 2, &rc_first, NULL, NULL, NULL);
 	variable_add(&remote_plugin, ("remote_control"), VAR_STR, 1, &rc_paths, rc_paths_changed, NULL, NULL);
 	variable_add(&remote_plugin, ("password"), VAR_STR, 0, &rc_password, NULL, NULL, NULL);
+	variable_add(&remote_plugin, ("backlog_size"), VAR_INT, 1, &rc_backlog_size, NULL, NULL, NULL);
+	variable_add(&remote_plugin, ("queue_limit"), VAR_INT, 1, &rc_queue_limit, rc_queue_limit_changed, NULL, NULL);
+	variable_add(&remote_plugin, ("queue_policy"), VAR_MAP, 1, &rc_queue_policy, NULL, variable_map(2, 0, 0, "drop", 1, 0, "disconnect"), NULL);
+
+	command_add(&remote_plugin, ("remote:clients"), NULL, rc_command_clients, 0, NULL);
 
 	query_connect(&remote_plugin, "ui-is-initialized", remote_ui_is_initialized, NULL);
 	query_connect(&remote_plugin, "config-postinit", remote_postinit, NULL);
@@ -1612,6 +1888,9 @@ static int remote_plugin_destroy() {
 	for (w = windows; w; w = w->next)
 		remote_window_kill(w);
 
+	xfree(rc_instance);
+	rc_instance = NULL;
+
 	plugin_unregister(&remote_plugin);
 	return 0;
 }
@@ -73,6 +73,10 @@ static int commands_OK, variables_OK, formats_OK, plugins_OK, sessions_OK, windo
 static int ui_config_OK, backlog_OK;
 
 static int remote_fd;
+static char *remote_path;		/* to reattach, when connection was lost */
+static char *remote_password;
+static char *remote_instance;		/* ekg2 instance which sent backlog sequences */
+static int remote_reattaching;
 
 static unsigned int read_total, write_total;
 int remote_mail_count;
@@ -323,6 +327,11 @@ int remote_connect(const char *path) {
 		return -1;
 	}
 
+	if (path != remote_path) {
+		xfree(remote_path);
+		remote_path = xstrdup(path);
+	}
+
 	if (!strncmp(path, "tcp:", 4)) {
 		path = path + 4;
 		return rc_input_new_inet(path, SOCK_STREAM);
@@ -475,6 +484,106 @@ static void plugin_params_array_add(plugins_params_t **array, plugins_params_t *
  *	Ale oczywiscie wszystko da sie zrobic, wystarczy tylko przemyslec
  */
 
+/*
+ * remote_print_window_seq()
+ *
+ * lines with sequence number (@a seqstr) which we've already got are skipped,
+ * as WINDOW_PRINT and BACKLOG can overlap.
+ */
+static void remote_print_window_seq(int id, time_t ts, char *data, const char *seqstr) {
+	window_t *w;
+
+	if (seqstr && (w = window_exist(id))) {
+		unsigned long long seq = strtoull(seqstr, NULL, 10);
+
+		if (seq < w->backlog_seq)
+			return;
+		w->backlog_seq = seq + 1;
+	}
+
+	remote_print_window(id, ts, data);
+}
+
+/*
+ * remote_instance_set()
+ *
+ * remembers which ekg2 instance we're attached to. If it's not the one which
+ * numbered lines we've got (ekg2 was restarted), our sequences are worthless:
+ * forget them and clear windows, backlog will be sent again from scratch.
+ */
+static void remote_instance_set(const char *instance) {
+	window_t *w;
+
+	if (!xstrcmp(remote_instance, instance))
+		return;
+
+	if (remote_instance)
+		debug_error("remote: ekg2 instance changed (%s -> %s), lines not in its backlog are lost\n", remote_instance, instance);
+
+	for (w = windows; w; w = w->next) {
+		if (!w->backlog_seq)
+			continue;
+
+		w->backlog_seq = 0;
+		query_emit(NULL, "ui-window-clear", &w);
+	}
+
+	xfree(remote_instance);
+	remote_instance = xstrdup(instance);
+}
+
+/*
+ * remote_request_backlogs()
+ *
+ * asks for last 1000 lines of each window, or only for lines we haven't got yet
+ * if we've been connected to the same ekg2 before.
+ */
+static void remote_request_backlogs(int fd) {
+	string_t seqs = string_init(NULL);
+	window_t *w;
+
+	for (w = windows; w; w = w->next) {
+		char buf[40];
+
+		if (!w->backlog_seq)
+			continue;
+
+		snprintf(buf, sizeof(buf), "%s%d:%llu", (seqs->len ? " " : ""), w->id, w->backlog_seq - 1);
+		string_append(seqs, buf);
+	}
+
+	if (remote_instance && seqs->len)
+		remote_writefd(fd, "REQBACKLOGS", "SEQ", "1000", remote_instance, seqs->str, NULL);
+	else
+		remote_writefd(fd, "REQBACKLOGS", "SEQ", "1000", "-", NULL);
+
+	string_free(seqs, 1);
+}
+
+static void remote_watches_add(int fd);
+
+static TIMER(remote_reattach) {
+	int fd;
+
+	if (type)
+		return 0;
+
+	if ((fd = remote_connect(remote_path)) == -1) {
+		debug_error("remote_reattach() %s: %s\n", remote_path, strerror(errno));
+		return 0;
+	}
+
+	debug_ok("remote_reattach() connected to %s, fd: %d\n", remote_path, fd);
+
+	remote_fd		= fd;
+	remote_reattaching	= 1;
+	login_OK		= 0;
+
+	remote_watches_add(fd);
+	remote_writefd(fd, "REQLOGIN", remote_password, NULL);
+	return -1;
+}
+
 static WATCHER_LINE(remote_read_line) {
 	char **arr;
 	int arrcnt;
@@ -483,8 +592,14 @@ static WATCHER_LINE(remote_read_line) {
 
 	if (type) {
 		remote_fd = -1;
+		watch_remove(NULL, fd, WATCH_WRITE);
 		close(fd);
 		/* XXX, wyswietlic jakis madry komunikat */
+
+		/* we were attached, try to get back, and fetch only lines we've missed */
+		if (backlog_OK && remote_path && !remote_reattaching)
+			timer_add(NULL, "remote:reattach", 2, 1, remote_reattach, NULL);
+		remote_reattaching = 0;
 		return 0;
 	}
 
@@ -510,6 +625,18 @@ static WATCHER_LINE(remote_read_line) {
 		if (done) {
 			login_OK = done;
 			/* debug_ok("LOGIN: DONE\n"); */
+
+			/* +LOGIN <instance>, before any line with sequence number */
+			if (done == 1 && arrcnt == 2)
+				remote_instance_set(arr[1]);
+
+			if (remote_reattaching && done == 1) {
+				remote_writefd(remote_fd, "REQWINDOWS", NULL);
+				remote_request_backlogs(remote_fd);
+			} else if (remote_reattaching) {
+				debug_error("remote_reattach() login failed\n");
+				remote_reattaching = 0;
+			}
 		}
 
 	} else if (!strcmp(cmd, "CONFIG")) {
@@ -615,14 +742,19 @@ static WATCHER_LINE(remote_read_line) {
 		}
 
 	} else if (!strcmp(cmd, "BACKLOG")) {
-		if (done == 0 && arrcnt == 4) {
+		if (done == 0 && (arrcnt == 4 || arrcnt == 5)) {
 			int id = atoi(arr[1]);
 			time_t ts = atoi(arr[2]);	/* XXX? atoi() */
 
-			remote_print_window(id, ts, arr[3]);
+			remote_print_window_seq(id, ts, arr[3], (arrcnt == 5) ? arr[4] : NULL);
 		}
 
 		if (done == 1) {
+			if (arrcnt == 2)
+				remote_instance_set(arr[1]);
+			if (remote_reattaching)
+				debug_ok("remote_reattach() DONE\n");
+			remote_reattaching = 0;
 			backlog_OK = 1;
 			debug_ok("BACKLOG: DONE\n");
 		}
@@ -743,12 +875,12 @@ static WATCHER_LINE(remote_read_line) {
 		}
 
 	} else if (!strcmp(cmd, "WINDOW_PRINT")) {
-		if (arrcnt == 4) {
+		if (arrcnt == 4 || arrcnt == 5) {
 			int id = atoi(arr[1]);
 			time_t ts = atoi(arr[2]);	/* XXX? atoi() */
 			char *val = arr[3];
 
-			remote_print_window(id, ts, val);
+			remote_print_window_seq(id, ts, val, (arrcnt == 5) ? arr[4] : NULL);
 		}
 
 
@@ -959,7 +1091,7 @@ static WATCHER_LINE(remote_write) {
 	return res;
 }
 
-int remote_connect2(int fd, const char *password) {
+static void remote_watches_add(int fd) {
 #ifdef HAVE_SSL
 	if (ssl_session) {
 		watch_t *w;
@@ -976,6 +1108,13 @@ int remote_connect2(int fd, const char *password) {
 		w = watch_add_line(NULL, fd, WATCH_WRITE_LINE, remote_write, NULL);
 		w->data = w->buf;
 	}
+}
+
+int remote_connect2(int fd, const char *password) {
+	remote_watches_add(fd);
+
+	xfree(remote_password);
+	remote_password = xstrdup(password);
 
 	/* XXX, na poczatku polaczenia powinnismy dostac kodowanie serwera? */
 
@@ -1026,7 +1165,7 @@ int remote_connect3() {
 	windows_lock_all();
 	/* remote_writefd(remote_fd, "REQBACKLOGS", NULL); */
 	/* remote_writefd(remote_fd, "REQBACKLOGS", "FROMTIME", "1221747609", NULL); */
-	remote_writefd(remote_fd, "REQBACKLOGS", "LAST", "1000", NULL);
+	remote_request_backlogs(remote_fd);
 
 	while (!backlog_OK)
 		ekg_loop();
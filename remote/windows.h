@@ -83,6 +83,7 @@ typedef struct window {
 	char *irctopic;
 	char *irctopicby;
 	char *ircmode;
+	unsigned long long backlog_seq;	/* sequence number of next line from ekg2, 0 if we don't know any */
 } window_t;
 
 typedef enum {